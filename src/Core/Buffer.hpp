@@ -41,6 +41,8 @@ namespace vrg {
 		inline vk::SharingMode SharingMode() const { return _sharingMode; }
 		inline vk::DeviceSize Size() const { return _size; }
 		inline std::byte* Data() const { return reinterpret_cast<std::byte*>(_device.AllocationInfo(_allocation).pMappedData); }
+		//makes device writes visible to the host for non-coherent memory, no-op otherwise
+		inline void Invalidate(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const { vmaInvalidateAllocation(_device.Allocator(), _allocation, offset, size); }
 
 		template<typename T>
 		class View {
@@ -106,6 +108,32 @@ namespace vrg {
 			inline vk::DeviceSize Stride() const { return _stride; }
 		};
 
+		//formatted view for uniform and storage texel buffers
+		class TexelView : public View<std::byte> {
+		private:
+			std::shared_ptr<vk::BufferView> _view;
+			vk::Format _format = vk::Format::eUndefined;
+
+		public:
+			TexelView() = default;
+			TexelView(const TexelView&) = default;
+			TexelView(TexelView&&) = default;
+
+			inline TexelView(const View<std::byte>& view, vk::Format format) : View<std::byte>(view), _format(format) {
+				vrg::Device& device = view.Buffer()._device;
+				_view = std::shared_ptr<vk::BufferView>(
+					new vk::BufferView(device->createBufferView(vk::BufferViewCreateInfo({}, *view.Buffer(), _format, view.Offset(), view.ByteSize()))),
+					[&device](vk::BufferView* v) { device->destroyBufferView(*v); delete v; });
+			}
+
+			TexelView& operator=(const TexelView&) = default;
+			TexelView& operator=(TexelView&&) = default;
+			bool operator==(const TexelView& rhs) const = default;
+
+			inline const vk::BufferView& operator*() const { return *_view; }
+			inline vk::Format Format() const { return _format; }
+		};
+
 	};
 
 	template<class T>
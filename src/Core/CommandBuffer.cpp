@@ -1,4 +1,5 @@
 #include "CommandBuffer.hpp"
+#include "PipelineRecorder.hpp"
 
 using namespace vrg;
 
@@ -40,10 +41,16 @@ void CommandBuffer::Clear() {
 	_heldResources.clear();
 	_signalSemaphores.clear();
 	_waitSemaphores.clear();
+	_pendingBarriers.Clear();
+	_computeWritesPending = false;
+	_computeWritesVisibleTo = {};
 	//_primitiveCount = 0;
 	_currentFramebuffer.reset();
 	_currentRenderPass.reset();
 	_boundPipeline.reset();
+	_skipDraws = false;
+	_boundGraphicsPipeline = nullptr;
+	_dynamicState = {};
 	//_boundVertexBuffers.clear();
 	//_boundIndexBuffer = {};
 	//_boundDescriptorSets.clear();
@@ -59,10 +66,61 @@ void CommandBuffer::Reset(const std::string& name) {
 	_state = CommandBufferState::Recording;
 }
 
+void CommandBuffer::ApplyDynamicState() {
+	const GraphicsPipeline& pipeline = *_boundGraphicsPipeline;
+	//state the pipeline bakes overwrites whatever was set before, the next set can't be filtered against it
+	if (pipeline.IsDynamic(vk::DynamicState::eCullModeEXT)) SetCullMode(pipeline.CullMode());
+	else _dynamicState.cullMode.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::ePolygonModeEXT)) SetPolygonMode(pipeline.PolygonMode());
+	else _dynamicState.polygonMode.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::ePrimitiveTopologyEXT)) SetPrimitiveTopology(pipeline.Topology());
+	else _dynamicState.topology.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::ePrimitiveRestartEnableEXT)) SetPrimitiveRestart(pipeline.PrimitiveRestart());
+	else _dynamicState.primitiveRestart.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::eDepthTestEnableEXT)) SetDepthTest(pipeline.DepthStencilState().depthTestEnable);
+	else _dynamicState.depthTest.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::eDepthWriteEnableEXT)) SetDepthWrite(pipeline.DepthStencilState().depthWriteEnable);
+	else _dynamicState.depthWrite.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::eDepthCompareOpEXT)) SetDepthCompareOp(pipeline.DepthStencilState().depthCompareOp);
+	else _dynamicState.depthCompareOp.reset();
+	if (pipeline.IsDynamic(vk::DynamicState::eVertexInputEXT)) {
+		pipeline.VertexInput(_vertexInputBindings, _vertexInputAttributes);
+		SetVertexInput(_vertexInputBindings, _vertexInputAttributes);
+	}
+	else _dynamicState.vertexInput.reset();
+}
+
+void CommandBuffer::SetVertexInput(const Geometry& geometry) {
+	SetPrimitiveTopology(geometry.primitiveTopology);
+	if (!HasDynamicState(vk::DynamicState::eVertexInputEXT)) return;
+	_boundGraphicsPipeline->VertexInput(geometry, _vertexInputBindings, _vertexInputAttributes);
+	SetVertexInput(_vertexInputBindings, _vertexInputAttributes);
+}
+
+void CommandBuffer::SetVertexInput(const std::vector<vk::VertexInputBindingDescription2EXT>& bindings, const std::vector<vk::VertexInputAttributeDescription2EXT>& attributes) {
+	size_t hash = hash_combine(bindings.size(), attributes.size());
+	for (const auto& binding : bindings) {
+		hash = hash_combine(hash, binding.binding, binding.stride, binding.inputRate, binding.divisor);
+	}
+	for (const auto& attribute : attributes) {
+		hash = hash_combine(hash, attribute.location, attribute.binding, attribute.format, attribute.offset);
+	}
+	if (_dynamicState.vertexInput == hash) return;
+	_dynamicState.vertexInput = hash;
+	_device.vkCmdSetVertexInputEXT(_commandBuffer, (uint32_t)bindings.size(), reinterpret_cast<const VkVertexInputBindingDescription2EXT*>(bindings.data()),
+		(uint32_t)attributes.size(), reinterpret_cast<const VkVertexInputAttributeDescription2EXT*>(attributes.data()));
+}
+
 void CommandBuffer::BeginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shared_ptr<Framebuffer> framebuffer, const std::vector<vk::ClearValue>& clearValues, vk::SubpassContents contents) {
 	for (uint32_t i = 0; i < renderPass->AttachmentDescriptions().size(); ++i) {
-		(*framebuffer)[i].Texture().TransitionBarrier(*this, std::get<vk::AttachmentDescription>(renderPass->AttachmentDescriptions()[i]).initialLayout);
+		const Texture::View& attachment = (*framebuffer)[i];
+		attachment.Texture().TransitionBarrier(*this, attachment.SubresourceRange(), std::get<vk::AttachmentDescription>(renderPass->AttachmentDescriptions()[i]).initialLayout);
 	}
+	//barriers can't be recorded inside the render pass, make compute output visible to everything the draws might read it with
+	ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eDrawIndirect | vk::PipelineStageFlagBits2KHR::eVertexInput | vk::PipelineStageFlagBits2KHR::eVertexShader | vk::PipelineStageFlagBits2KHR::eFragmentShader,
+		vk::AccessFlagBits2KHR::eIndirectCommandRead | vk::AccessFlagBits2KHR::eVertexAttributeRead | vk::AccessFlagBits2KHR::eIndexRead | vk::AccessFlagBits2KHR::eShaderRead);
+
+	FlushBarriers();
 
 	vk::RenderPassBeginInfo passInfo = {};
 	passInfo.renderPass = **renderPass;
@@ -89,12 +147,14 @@ void CommandBuffer::EndRenderPass() {
 	for (uint32_t i = 0; i < _currentRenderPass->AttachmentDescriptions().size(); ++i) {
 		auto layout = std::get<vk::AttachmentDescription>(_currentRenderPass->AttachmentDescriptions()[i]).finalLayout;
 		auto& attachment = (*_currentFramebuffer)[i];
-		attachment.Texture()._trackedLayout = layout;
-		attachment.Texture()._trackedStages = GuessStage(layout);
-		attachment.Texture()._trackedAccessFlags = GuessAccessMask(layout);
+		attachment.Texture().SetTrackedState(attachment.SubresourceRange(), { layout, GuessStage(layout), GuessAccessMask(layout) });
 	}
 
 	_currentRenderPass = nullptr;
 	_currentFramebuffer = nullptr;
 	_currentSubpassIndex = -1;
-}
\ No newline at end of file
+}
+
+void CommandBuffer::RecordUse(const Pipeline& pipeline) {
+	_device._pipelineRecorder->Record(pipeline);
+}
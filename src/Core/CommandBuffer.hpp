@@ -2,6 +2,7 @@
 
 #include "Framebuffer.hpp"
 #include "Pipeline.hpp"
+#include "PipelineCompiler.hpp"
 
 namespace vrg {
 
@@ -36,11 +37,13 @@ namespace vrg {
 
 		void Reset(const std::string& name = "Command Buffer");
 
-		inline void WaitOn(vk::PipelineStageFlags stage, Semaphore& waitSemaphore) {
+		// stage is the first stage of this command buffer that has to wait for the semaphore
+		inline void WaitOn(vk::PipelineStageFlags2KHR stage, Semaphore& waitSemaphore) {
 			_waitSemaphores.emplace_back(stage, std::forward<Semaphore&>(waitSemaphore));
 		}
-		inline void SignalOnComplete(vk::PipelineStageFlags flags, std::shared_ptr<Semaphore> semaphore) {
-			_signalSemaphores.push_back(semaphore);
+		// stage is the last stage of this command buffer that the semaphore signal waits for
+		inline void SignalOnComplete(vk::PipelineStageFlags2KHR stage, std::shared_ptr<Semaphore> semaphore) {
+			_signalSemaphores.emplace_back(stage, semaphore);
 		}
 
 		template<std::derived_from<DeviceResource> T>
@@ -52,31 +55,59 @@ namespace vrg {
 		void BeginLabel(const std::string& label, const glm::vec4& color = { 1, 1, 1, 0 });
 		void EndLabel();
 
-		inline void Barrier(vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, const vk::MemoryBarrier& barrier) {
-			_commandBuffer.pipelineBarrier(srcStage, dstStage, {}, { barrier }, {}, {});
+		// Barriers are accumulated and recorded as a single vkCmdPipelineBarrier2 by FlushBarriers,
+		// which runs before every draw, dispatch, copy, blit and render pass begin recorded through this class.
+		// Call FlushBarriers manually before recording other commands through operator->
+		inline void Barrier(const vk::MemoryBarrier2KHR& barrier) {
+			//global barriers with the same stages collapse into one
+			auto it = std::ranges::find_if(_pendingBarriers.memoryBarriers, [&](const auto& b) { return b.srcStageMask == barrier.srcStageMask && b.dstStageMask == barrier.dstStageMask; });
+			if (it != _pendingBarriers.memoryBarriers.end()) {
+				it->srcAccessMask |= barrier.srcAccessMask;
+				it->dstAccessMask |= barrier.dstAccessMask;
+			}
+			else {
+				_pendingBarriers.memoryBarriers.push_back(barrier);
+			}
 		}
-		inline void Barrier(vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, const vk::BufferMemoryBarrier& barrier) {
-			_commandBuffer.pipelineBarrier(srcStage, dstStage, {}, {}, { barrier }, {});
+		inline void Barrier(const vk::BufferMemoryBarrier2KHR& barrier) {
+			//a barrier on a range that already has one pending must execute after it
+			if (std::ranges::any_of(_pendingBarriers.bufferBarriers, [&](const auto& b) { return b.buffer == barrier.buffer && Overlaps(b.offset, b.size, barrier.offset, barrier.size); })) {
+				FlushBarriers();
+			}
+			_pendingBarriers.bufferBarriers.push_back(barrier);
 		}
-		inline void Barrier(vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, const vk::ImageMemoryBarrier& barrier) {
-			_commandBuffer.pipelineBarrier(srcStage, dstStage, {}, {}, {}, { barrier });
+		inline void Barrier(const vk::ImageMemoryBarrier2KHR& barrier) {
+			//layout transitions of the same subresource can't share a vkCmdPipelineBarrier2
+			if (std::ranges::any_of(_pendingBarriers.imageBarriers, [&](const auto& b) { return b.image == barrier.image && Overlaps(b.subresourceRange, barrier.subresourceRange); })) {
+				FlushBarriers();
+			}
+			_pendingBarriers.imageBarriers.push_back(barrier);
+		}
+
+		inline void FlushBarriers() {
+			if (_pendingBarriers.memoryBarriers.empty() && _pendingBarriers.bufferBarriers.empty() && _pendingBarriers.imageBarriers.empty()) return;
+			vk::DependencyInfoKHR dependencyInfo({}, _pendingBarriers.memoryBarriers, _pendingBarriers.bufferBarriers, _pendingBarriers.imageBarriers);
+			_device.vkCmdPipelineBarrier2KHR(_commandBuffer, reinterpret_cast<const VkDependencyInfoKHR*>(&dependencyInfo));
+			_pendingBarriers.Clear();
 		}
 
 		inline void TransitionBarrier(vk::Image image, const vk::ImageSubresourceRange& subresourceRange, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
 			TransitionBarrier(image, subresourceRange, GuessStage(oldLayout), GuessStage(newLayout), oldLayout, newLayout);
 		}
-		inline void TransitionBarrier(vk::Image image, const vk::ImageSubresourceRange& subresourceRange, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+		inline void TransitionBarrier(vk::Image image, const vk::ImageSubresourceRange& subresourceRange, vk::PipelineStageFlags2KHR srcStage, vk::PipelineStageFlags2KHR dstStage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
 			if (oldLayout == newLayout) return;
-			vk::ImageMemoryBarrier barrier = {};
+			vk::ImageMemoryBarrier2KHR barrier = {};
+			barrier.srcStageMask = srcStage;
+			barrier.srcAccessMask = GuessAccessMask(oldLayout);
+			barrier.dstStageMask = dstStage;
+			barrier.dstAccessMask = GuessAccessMask(newLayout);
 			barrier.oldLayout = oldLayout;
 			barrier.newLayout = newLayout;
 			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 			barrier.image = image;
 			barrier.subresourceRange = subresourceRange;
-			barrier.srcAccessMask = GuessAccessMask(oldLayout);
-			barrier.dstAccessMask = GuessAccessMask(newLayout);
-			Barrier(srcStage, dstStage, barrier);
+			Barrier(barrier);
 		}
 
 		void BeginRenderPass(std::shared_ptr<RenderPass> renderPass, std::shared_ptr<Framebuffer> frameBuffer, const std::vector<vk::ClearValue>& clearValues, vk::SubpassContents contents = vk::SubpassContents::eInline);
@@ -84,15 +115,74 @@ namespace vrg {
 		void EndRenderPass();
 
 		inline void BindPipeline(std::shared_ptr<Pipeline> pipeline) {
+			_skipDraws = false;
+			GraphicsPipeline* graphics = dynamic_cast<GraphicsPipeline*>(pipeline.get());
+			//read through UpgradeLink, another thread may be swapping in the optimized link
+			vk::Pipeline handle = graphics ? graphics->UpgradeLink() : **pipeline;
 			if (_boundPipeline == pipeline) return;
-			_commandBuffer.bindPipeline(pipeline->BindPoint(), **pipeline);
+			_commandBuffer.bindPipeline(pipeline->BindPoint(), handle);
 			_boundPipeline = pipeline;
 			_boundDescriptorSets.clear();
 			_boundVertexBuffers.clear();
 			_boundIndexBuffer = {};
+			_boundGraphicsPipeline = graphics;
 			HoldResource(pipeline);
+			if (_device._pipelineRecorder && pipeline->MarkUsed()) RecordUse(*pipeline);
+			if (_boundGraphicsPipeline) ApplyDynamicState();
+		}
+		// Binds the compiled pipeline or its fallback. Returns false if neither exists yet,
+		// draws and dispatches are then skipped until the next pipeline is bound
+		inline bool BindPipeline(const AsyncPipeline& pipeline) {
+			std::shared_ptr<Pipeline> usable = pipeline.Get();
+			if (!usable) {
+				_skipDraws = true;
+				return false;
+			}
+			BindPipeline(usable);
+			return true;
 		}
 
+		// Extended dynamic state. Only recorded when the bound pipeline has the state dynamic, pipelines that bake it ignore the call,
+		// so the same code path works with and without the extensions. Binding a pipeline sets its dynamic states to the values
+		// it was created with, call these afterwards to override them. Setting the current value again records nothing
+		inline void SetCullMode(vk::CullModeFlags cullMode) {
+			if (!HasDynamicState(vk::DynamicState::eCullModeEXT) || _dynamicState.cullMode == cullMode) return;
+			_dynamicState.cullMode = cullMode;
+			_device.vkCmdSetCullModeEXT(_commandBuffer, (VkCullModeFlags)cullMode);
+		}
+		inline void SetPolygonMode(vk::PolygonMode polygonMode) {
+			if (!HasDynamicState(vk::DynamicState::ePolygonModeEXT) || _dynamicState.polygonMode == polygonMode) return;
+			_dynamicState.polygonMode = polygonMode;
+			_device.vkCmdSetPolygonModeEXT(_commandBuffer, (VkPolygonMode)polygonMode);
+		}
+		inline void SetPrimitiveTopology(vk::PrimitiveTopology topology) {
+			if (!HasDynamicState(vk::DynamicState::ePrimitiveTopologyEXT) || _dynamicState.topology == topology) return;
+			_dynamicState.topology = topology;
+			_device.vkCmdSetPrimitiveTopologyEXT(_commandBuffer, (VkPrimitiveTopology)topology);
+		}
+		inline void SetPrimitiveRestart(bool enable) {
+			if (!HasDynamicState(vk::DynamicState::ePrimitiveRestartEnableEXT) || _dynamicState.primitiveRestart == enable) return;
+			_dynamicState.primitiveRestart = enable;
+			_device.vkCmdSetPrimitiveRestartEnableEXT(_commandBuffer, enable);
+		}
+		inline void SetDepthTest(bool enable) {
+			if (!HasDynamicState(vk::DynamicState::eDepthTestEnableEXT) || _dynamicState.depthTest == enable) return;
+			_dynamicState.depthTest = enable;
+			_device.vkCmdSetDepthTestEnableEXT(_commandBuffer, enable);
+		}
+		inline void SetDepthWrite(bool enable) {
+			if (!HasDynamicState(vk::DynamicState::eDepthWriteEnableEXT) || _dynamicState.depthWrite == enable) return;
+			_dynamicState.depthWrite = enable;
+			_device.vkCmdSetDepthWriteEnableEXT(_commandBuffer, enable);
+		}
+		inline void SetDepthCompareOp(vk::CompareOp compareOp) {
+			if (!HasDynamicState(vk::DynamicState::eDepthCompareOpEXT) || _dynamicState.depthCompareOp == compareOp) return;
+			_dynamicState.depthCompareOp = compareOp;
+			_device.vkCmdSetDepthCompareOpEXT(_commandBuffer, (VkCompareOp)compareOp);
+		}
+		// Topology and vertex bindings, strides and attributes of geometry, matched against the bound pipeline's vertex shader
+		void SetVertexInput(const Geometry& geometry);
+
 		template<typename T> 
 		inline void BindVertexBuffer(uint32_t index, const Buffer::View<T>& view) {
 			if (_boundVertexBuffers[index] != view) {
@@ -125,22 +215,145 @@ namespace vrg {
 		template<typename T, typename S>
 		inline const Buffer::View<S>& CopyBuffer(const Buffer::View<T>& src, const Buffer::View<S>& dst) {
 			if (src.ByteSize() != dst.ByteSize()) throw std::invalid_argument("src and dst must be the same size");
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferRead | vk::AccessFlagBits2KHR::eTransferWrite);
+			FlushBarriers();
 			_commandBuffer.copyBuffer(*HoldResource(src.BufferPtr()), *HoldResource(dst.BufferPtr()), { vk::BufferCopy(src.Offset(), dst.Offset(), src.ByteSize()) });
+			return dst;
 		}
 
 		template<typename T>
 		inline Buffer::View<T> CopyBuffer(const Buffer::View<T>& src, vk::BufferUsageFlagBits bufferUsage, VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY) {
 			auto dst = std::make_shared<Buffer>(_device, src.Buffer().Name(), src.ByteSize(), bufferUsage | vk::BufferUsageFlagBits::eTransferDst, memoryUsage);
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferRead);
+			FlushBarriers();
 			_commandBuffer.copyBuffer(*HoldResource(src.BufferPtr()), *HoldResource(dst), { vk::BufferCopy(src.Offset(), 0, src.ByteSize()) });
 			return dst;
 		}
 
+		inline void FillBuffer(const Buffer::View<std::byte>& dst, uint32_t data) {
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferWrite);
+			FlushBarriers();
+			_commandBuffer.fillBuffer(*HoldResource(dst.BufferPtr()), dst.Offset(), dst.ByteSize(), data);
+		}
+
+		//copies one mip of the given layers into dst, tightly packed. src is transitioned to TransferSrcOptimal
+		inline void CopyImageToBuffer(Texture& src, const vk::ImageSubresourceLayers& subresource, const Buffer::View<std::byte>& dst, vk::Offset3D offset = {}, vk::Extent3D extent = {}) {
+			if (extent == vk::Extent3D()) {
+				extent = vk::Extent3D(std::max(1u, src.Extent().width >> subresource.mipLevel), std::max(1u, src.Extent().height >> subresource.mipLevel), std::max(1u, src.Extent().depth >> subresource.mipLevel));
+			}
+			src.TransitionBarrier(*this, vk::ImageSubresourceRange(subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount),
+				vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2KHR::eCopy, vk::AccessFlagBits2KHR::eTransferRead);
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferRead | vk::AccessFlagBits2KHR::eTransferWrite);
+			FlushBarriers();
+			HoldResource(src.shared_from_this());
+			_commandBuffer.copyImageToBuffer(*src, vk::ImageLayout::eTransferSrcOptimal, *HoldResource(dst.BufferPtr()), { vk::BufferImageCopy(dst.Offset(), 0, 0, subresource, offset, extent) });
+		}
+
+		inline void BlitImage(Texture& src, Texture& dst, const vk::ArrayProxy<const vk::ImageBlit>& regions, vk::Filter filter) {
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferRead | vk::AccessFlagBits2KHR::eTransferWrite);
+			FlushBarriers();
+			_commandBuffer.blitImage(*src, vk::ImageLayout::eTransferSrcOptimal, *dst, vk::ImageLayout::eTransferDstOptimal, regions, filter);
+		}
+
+		inline void Draw(uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0) {
+			if (_skipDraws) return;
+			FlushBarriers();
+			_commandBuffer.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+		}
+		inline void DrawIndexed(uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0) {
+			if (_skipDraws) return;
+			FlushBarriers();
+			_commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		}
+
+		// Dispatches the bound compute pipeline. Storage buffers and images written by earlier dispatches are made visible first,
+		// the same happens before render passes and transfers, so chained compute passes need no manual barriers
+		inline void Dispatch(uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1) {
+			if (_skipDraws) return;
+			BeginDispatch();
+			_commandBuffer.dispatch(groupCountX, groupCountY, groupCountZ);
+			EndDispatch();
+		}
+		inline void Dispatch(const vk::Extent3D& groupCount) {
+			Dispatch(groupCount.width, groupCount.height, groupCount.depth);
+		}
+		// Enough workgroups of the bound pipeline's reflected size to cover threads invocations
+		inline void DispatchThreads(const vk::Extent3D& threads) {
+			if (_skipDraws) return;
+			auto pipeline = std::dynamic_pointer_cast<ComputePipeline>(_boundPipeline);
+			if (!pipeline) throw std::runtime_error("DispatchThreads requires a compute pipeline to be bound");
+			Dispatch(pipeline->GroupCount(threads));
+		}
+		inline void DispatchIndirect(const Buffer::View<vk::DispatchIndirectCommand>& arguments) {
+			if (_skipDraws) return;
+			//the arguments may have been written by an earlier dispatch too
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eDrawIndirect, vk::AccessFlagBits2KHR::eIndirectCommandRead);
+			BeginDispatch();
+			_commandBuffer.dispatchIndirect(*HoldResource(arguments.BufferPtr()), arguments.Offset());
+			EndDispatch();
+		}
+
 	private:
 		friend class Device;
 
+		void RecordUse(const Pipeline& pipeline);
+
+		inline void BeginDispatch() {
+			if (!_boundPipeline || _boundPipeline->BindPoint() != vk::PipelineBindPoint::eCompute) {
+				throw std::runtime_error("Dispatch requires a compute pipeline to be bound");
+			}
+			ResolveComputeWrites(vk::PipelineStageFlagBits2KHR::eComputeShader,
+				vk::AccessFlagBits2KHR::eShaderStorageRead | vk::AccessFlagBits2KHR::eShaderStorageWrite | vk::AccessFlagBits2KHR::eShaderSampledRead | vk::AccessFlagBits2KHR::eUniformRead);
+			FlushBarriers();
+		}
+		inline void EndDispatch() {
+			//read only storage bindings aren't told apart, any storage binding counts as a write
+			bool writes = std::ranges::any_of(_boundPipeline->DescriptorBindings() | std::views::values, [](const DescriptorBinding& b) {
+				return b.descriptorType == vk::DescriptorType::eStorageBuffer || b.descriptorType == vk::DescriptorType::eStorageBufferDynamic ||
+					b.descriptorType == vk::DescriptorType::eStorageImage || b.descriptorType == vk::DescriptorType::eStorageTexelBuffer;
+			});
+			if (writes) {
+				_computeWritesPending = true;
+				_computeWritesVisibleTo = {};
+			}
+		}
+		inline bool HasDynamicState(vk::DynamicState state) const { return _boundGraphicsPipeline && _boundGraphicsPipeline->IsDynamic(state); }
+		void ApplyDynamicState();
+		void SetVertexInput(const std::vector<vk::VertexInputBindingDescription2EXT>& bindings, const std::vector<vk::VertexInputAttributeDescription2EXT>& attributes);
+
+		// Barrier from outstanding compute storage writes to dstStage, once per stage until the next dispatch writes again
+		inline void ResolveComputeWrites(vk::PipelineStageFlags2KHR dstStage, vk::AccessFlags2KHR dstAccess) {
+			if (!_computeWritesPending || !(dstStage & ~_computeWritesVisibleTo)) return;
+			Barrier(vk::MemoryBarrier2KHR(vk::PipelineStageFlagBits2KHR::eComputeShader, vk::AccessFlagBits2KHR::eShaderStorageWrite, dstStage, dstAccess));
+			_computeWritesVisibleTo |= dstStage;
+		}
+
 		PFN_vkCmdBeginDebugUtilsLabelEXT vkCmdBeginDebugUtilsLabelEXT = 0;
 		PFN_vkCmdEndDebugUtilsLabelEXT vkCmdEndDebugUtilsLabelEXT = 0;
 
+		struct PendingBarriers {
+			std::vector<vk::MemoryBarrier2KHR> memoryBarriers;
+			std::vector<vk::BufferMemoryBarrier2KHR> bufferBarriers;
+			std::vector<vk::ImageMemoryBarrier2KHR> imageBarriers;
+
+			inline void Clear() {
+				memoryBarriers.clear();
+				bufferBarriers.clear();
+				imageBarriers.clear();
+			}
+		};
+
+		static inline bool Overlaps(vk::DeviceSize offsetA, vk::DeviceSize sizeA, vk::DeviceSize offsetB, vk::DeviceSize sizeB) {
+			vk::DeviceSize endA = sizeA == VK_WHOLE_SIZE ? VK_WHOLE_SIZE : offsetA + sizeA;
+			vk::DeviceSize endB = sizeB == VK_WHOLE_SIZE ? VK_WHOLE_SIZE : offsetB + sizeB;
+			return offsetA < endB && offsetB < endA;
+		}
+		static inline bool Overlaps(const vk::ImageSubresourceRange& a, const vk::ImageSubresourceRange& b) {
+			return (a.aspectMask & b.aspectMask) &&
+				Overlaps(a.baseMipLevel, a.levelCount == VK_REMAINING_MIP_LEVELS ? VK_WHOLE_SIZE : a.levelCount, b.baseMipLevel, b.levelCount == VK_REMAINING_MIP_LEVELS ? VK_WHOLE_SIZE : b.levelCount) &&
+				Overlaps(a.baseArrayLayer, a.layerCount == VK_REMAINING_ARRAY_LAYERS ? VK_WHOLE_SIZE : a.layerCount, b.baseArrayLayer, b.layerCount == VK_REMAINING_ARRAY_LAYERS ? VK_WHOLE_SIZE : b.layerCount);
+		}
+
 		void Clear();
 		inline bool CheckDone() {
 			if (_state == CommandBufferState::InFlight) {
@@ -158,18 +371,41 @@ namespace vrg {
 		Device::QueueFamily* _queueFamily;
 		vk::CommandPool _commandPool;
 		CommandBufferState _state;
+		//position in the device's submission order, set by Device::Execute
+		uint64_t _submitIndex = 0;
 
 		std::unique_ptr<Fence> _completionFence;
 
-		std::vector<std::shared_ptr<Semaphore>> _signalSemaphores;
-		std::vector<std::pair<vk::PipelineStageFlags, Semaphore&>> _waitSemaphores;
+		std::vector<std::pair<vk::PipelineStageFlags2KHR, std::shared_ptr<Semaphore>>> _signalSemaphores;
+		std::vector<std::pair<vk::PipelineStageFlags2KHR, Semaphore&>> _waitSemaphores;
 
 		std::unordered_set<std::shared_ptr<DeviceResource>> _heldResources;
+		PendingBarriers _pendingBarriers;
+		bool _computeWritesPending = false;
+		vk::PipelineStageFlags2KHR _computeWritesVisibleTo;
 
 		std::shared_ptr<Framebuffer> _currentFramebuffer;
 		std::shared_ptr<RenderPass> _currentRenderPass;
 		uint32_t _currentSubpassIndex = 0;
 		std::shared_ptr<Pipeline> _boundPipeline = nullptr;
+		//set when an AsyncPipeline without a usable pipeline was bound
+		bool _skipDraws = false;
+		//null when the bound pipeline isn't a graphics pipeline
+		GraphicsPipeline* _boundGraphicsPipeline = nullptr;
+		//last recorded extended dynamic state, empty when unknown
+		struct DynamicState {
+			std::optional<vk::CullModeFlags> cullMode;
+			std::optional<vk::PolygonMode> polygonMode;
+			std::optional<vk::PrimitiveTopology> topology;
+			std::optional<bool> primitiveRestart;
+			std::optional<bool> depthTest;
+			std::optional<bool> depthWrite;
+			std::optional<vk::CompareOp> depthCompareOp;
+			std::optional<size_t> vertexInput;
+		} _dynamicState;
+		//scratch for SetVertexInput
+		std::vector<vk::VertexInputBindingDescription2EXT> _vertexInputBindings;
+		std::vector<vk::VertexInputAttributeDescription2EXT> _vertexInputAttributes;
 		std::unordered_map<uint32_t, Buffer::View<std::byte>> _boundVertexBuffers;
 		Buffer::StrideView _boundIndexBuffer;
 		std::vector<std::shared_ptr<DescriptorSet>> _boundDescriptorSets;
@@ -3,11 +3,15 @@
 #include "SpirvModule.hpp"
 #include "Texture.hpp"
 #include "Buffer.hpp"
+#include "Sampler.hpp"
 
 namespace vrg {
 
 	using Descriptor = std::variant<
+		std::tuple<Texture::View, vk::ImageLayout, std::shared_ptr<Sampler>>, //sampled and storage images, combined image samplers, input attachments
 		Buffer::View<std::byte>, //storage and uniform buffers
+		Buffer::TexelView, //storage and uniform texel buffers
+		std::shared_ptr<Sampler>, //separate samplers
 		vk::AccelerationStructureKHR // acceleration structure
 	>;
 
@@ -118,6 +122,7 @@ namespace vrg {
 			struct WriteInfo {
 				vk::DescriptorImageInfo imageInfo;
 				vk::DescriptorBufferInfo bufferInfo;
+				vk::BufferView texelBufferView;
 				vk::WriteDescriptorSetInlineUniformBlockEXT inlineInfo;
 				vk::WriteDescriptorSetAccelerationStructureKHR accelerationStructureInfo;
 			};
@@ -134,12 +139,33 @@ namespace vrg {
 				auto& info = infos.emplace_back(WriteInfo{});
 				auto& write = writes.emplace_back(vk::WriteDescriptorSet(_descriptorSet, binding, index, 1, descBinding.descriptorType));
 				switch (write.descriptorType) {
+					case vk::DescriptorType::eSampler: {
+						//sampler, either on its own or taken from an image tuple
+						if (const auto* separate = std::get_if<std::shared_ptr<Sampler>>(&desc)) {
+							info.imageInfo.sampler = **separate;
+						}
+						else {
+							const auto& [view, layout, sampler] = std::get<0>(desc);
+							if (!sampler) throw std::invalid_argument("Sampler descriptor at binding " + std::to_string(binding) + " has no sampler");
+							info.imageInfo.sampler = **sampler;
+						}
+						write.pImageInfo = &info.imageInfo;
+						break;
+					}
 					case vk::DescriptorType::eInputAttachment:
 					case vk::DescriptorType::eSampledImage:
 					case vk::DescriptorType::eStorageImage:
-					case vk::DescriptorType::eCombinedImageSampler:
-					case vk::DescriptorType::eSampler: {
-						//sampler / image / sampler + image
+					case vk::DescriptorType::eCombinedImageSampler: {
+						//image / sampler + image
+						const auto& [view, layout, sampler] = std::get<0>(desc);
+
+						info.imageInfo.imageView = *view;
+						info.imageInfo.imageLayout = layout;
+						if (write.descriptorType == vk::DescriptorType::eCombinedImageSampler) {
+							if (!sampler) throw std::invalid_argument("Combined image sampler at binding " + std::to_string(binding) + " has no sampler");
+							info.imageInfo.sampler = **sampler;
+						}
+						write.pImageInfo = &info.imageInfo;
 						break;
 					}
 					case vk::DescriptorType::eUniformBuffer:
@@ -158,13 +184,19 @@ namespace vrg {
 					case vk::DescriptorType::eUniformTexelBuffer:
 					case vk::DescriptorType::eStorageTexelBuffer: {
 						//texel buffer
+						info.texelBufferView = *get<Buffer::TexelView>(desc);
+						write.pTexelBufferView = &info.texelBufferView;
 						break;
 					}
 					case vk::DescriptorType::eInlineUniformBlockEXT: {
 						//inline
+						break;
 					}
 					case vk::DescriptorType::eAccelerationStructureKHR: {
 						//acceleration structure
+						info.accelerationStructureInfo = vk::WriteDescriptorSetAccelerationStructureKHR(get<vk::AccelerationStructureKHR>(desc));
+						write.pNext = &info.accelerationStructureInfo;
+						break;
 					}
 				}
 			}
@@ -1,6 +1,9 @@
 #include "Device.hpp"
 #include "Window.hpp"
 #include "CommandBuffer.hpp"
+#include "Sampler.hpp"
+#include "PipelineLibrary.hpp"
+#include "PipelineTelemetry.hpp"
 
 using namespace vrg;
 
@@ -53,8 +56,110 @@ Device::Device(vrg::Instance& instance, uint32_t deviceIndex, std::vector<std::s
 #pragma region Logical Device
 	printf("Creating logical device...");
 	vk::PhysicalDeviceFeatures deviceFeatures{};
+	//used by the compute downsampler to read and write arbitrary mip formats
+	deviceFeatures.shaderStorageImageReadWithoutFormat = _features.shaderStorageImageReadWithoutFormat;
+	deviceFeatures.shaderStorageImageWriteWithoutFormat = _features.shaderStorageImageWriteWithoutFormat;
+	deviceFeatures.shaderStorageImageArrayDynamicIndexing = _features.shaderStorageImageArrayDynamicIndexing;
+	_enabledFeatures = deviceFeatures;
+
+	//all barriers and submits go through synchronization2
+	vk::PhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+	vk::PhysicalDeviceFeatures2 features2 = {};
+	features2.pNext = &synchronization2Features;
+
+	//dynamic state extensions are optional, pipelines bake the state when they are missing
+	vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+	vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT extendedDynamicState2Features = {};
+	vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT extendedDynamicState3Features = {};
+	vk::PhysicalDeviceVertexInputDynamicStateFeaturesEXT vertexInputDynamicStateFeatures = {};
+	vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures = {};
+	vk::PhysicalDevicePipelineExecutablePropertiesFeaturesKHR executablePropertiesFeatures = {};
+	vk::PhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8Features = {};
+	std::unordered_set<std::string> availableExtensions;
+	for (const vk::ExtensionProperties& extension : _physicalDevice.enumerateDeviceExtensionProperties()) {
+		availableExtensions.insert(extension.extensionName.data());
+	}
+	auto chainOptional = [&](const char* extension, auto& features) {
+		if (!availableExtensions.count(extension)) return;
+		features.pNext = features2.pNext;
+		features2.pNext = &features;
+	};
+	chainOptional(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME, extendedDynamicStateFeatures);
+	chainOptional(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME, extendedDynamicState2Features);
+	chainOptional(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME, extendedDynamicState3Features);
+	chainOptional(VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME, vertexInputDynamicStateFeatures);
+	chainOptional(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME, executablePropertiesFeatures);
+	chainOptional(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME, indexTypeUint8Features);
+	if (availableExtensions.count(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+		chainOptional(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME, graphicsPipelineLibraryFeatures);
+	}
+
+	_physicalDevice.getFeatures2(&features2);
+	if (!synchronization2Features.synchronization2) {
+		errf_color(ConsoleColor::Red, "Device does not support synchronization2\n");
+		throw std::runtime_error("Device does not support synchronization2");
+	}
+
+	_dynamicStates.extendedDynamicState = extendedDynamicStateFeatures.extendedDynamicState;
+	_dynamicStates.extendedDynamicState2 = extendedDynamicState2Features.extendedDynamicState2;
+	_dynamicStates.polygonMode = extendedDynamicState3Features.extendedDynamicState3PolygonMode;
+	_dynamicStates.vertexInput = vertexInputDynamicStateFeatures.vertexInputDynamicState;
+	auto enableExtension = [&](bool supported, const char* extension) {
+		if (supported && std::ranges::find(extensions, extension) == extensions.end()) {
+			extensions.emplace_back(extension);
+		}
+	};
+	enableExtension(_dynamicStates.extendedDynamicState, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+	enableExtension(_dynamicStates.extendedDynamicState2, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+	enableExtension(_dynamicStates.polygonMode, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+	enableExtension(_dynamicStates.vertexInput, VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
+	bool pipelineLibrary = graphicsPipelineLibraryFeatures.graphicsPipelineLibrary;
+	enableExtension(pipelineLibrary, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+	enableExtension(pipelineLibrary, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+	//telemetry, creation feedback has no feature bit
+	bool creationFeedback = availableExtensions.count(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+	bool executableProperties = executablePropertiesFeatures.pipelineExecutableInfo;
+	enableExtension(creationFeedback, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+	enableExtension(executableProperties, VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+	//meshes with at most 256 vertices per submesh use 1 byte indices when it's there
+	_indexTypeUint8 = indexTypeUint8Features.indexTypeUint8;
+	enableExtension(_indexTypeUint8, VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+
+	//device creation gets a chain of its own, the queried one names extensions that may not be enabled and every feature they report.
+	//Only structs of enabled extensions go in, with just the features something uses
+	void* enabledFeatures = nullptr;
+	auto enableFeatures = [&](bool enabled, auto& features) {
+		if (!enabled) return;
+		features.pNext = enabledFeatures;
+		enabledFeatures = &features;
+	};
+	vk::PhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2 = {};
+	enabledSynchronization2.synchronization2 = true;
+	enableFeatures(true, enabledSynchronization2);
+	vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT enabledExtendedDynamicState = {};
+	enabledExtendedDynamicState.extendedDynamicState = true;
+	enableFeatures(_dynamicStates.extendedDynamicState, enabledExtendedDynamicState);
+	vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT enabledExtendedDynamicState2 = {};
+	enabledExtendedDynamicState2.extendedDynamicState2 = true;
+	enableFeatures(_dynamicStates.extendedDynamicState2, enabledExtendedDynamicState2);
+	vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT enabledExtendedDynamicState3 = {};
+	enabledExtendedDynamicState3.extendedDynamicState3PolygonMode = true;
+	enableFeatures(_dynamicStates.polygonMode, enabledExtendedDynamicState3);
+	vk::PhysicalDeviceVertexInputDynamicStateFeaturesEXT enabledVertexInputDynamicState = {};
+	enabledVertexInputDynamicState.vertexInputDynamicState = true;
+	enableFeatures(_dynamicStates.vertexInput, enabledVertexInputDynamicState);
+	vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT enabledGraphicsPipelineLibrary = {};
+	enabledGraphicsPipelineLibrary.graphicsPipelineLibrary = true;
+	enableFeatures(pipelineLibrary, enabledGraphicsPipelineLibrary);
+	vk::PhysicalDevicePipelineExecutablePropertiesFeaturesKHR enabledExecutableProperties = {};
+	enabledExecutableProperties.pipelineExecutableInfo = true;
+	enableFeatures(executableProperties, enabledExecutableProperties);
+	vk::PhysicalDeviceIndexTypeUint8FeaturesEXT enabledIndexTypeUint8 = {};
+	enabledIndexTypeUint8.indexTypeUint8 = true;
+	enableFeatures(_indexTypeUint8, enabledIndexTypeUint8);
 
 	vk::DeviceCreateInfo deviceInfo = {};
+	deviceInfo.pNext = enabledFeatures;
 	deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceInfo.queueCreateInfoCount = queueCreateInfos.size();
 	deviceInfo.pEnabledFeatures = &deviceFeatures;
@@ -78,7 +183,37 @@ Device::Device(vrg::Instance& instance, uint32_t deviceIndex, std::vector<std::s
 		errf_color(ConsoleColor::Red, "Could not create logical device\n");
 		throw std::runtime_error("Could not create logical device");
 	}
+	vkCmdPipelineBarrier2KHR = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(_device.getProcAddr("vkCmdPipelineBarrier2KHR"));
+	vkQueueSubmit2KHR = reinterpret_cast<PFN_vkQueueSubmit2KHR>(_device.getProcAddr("vkQueueSubmit2KHR"));
+	if (!vkCmdPipelineBarrier2KHR || !vkQueueSubmit2KHR) {
+		errf_color(ConsoleColor::Red, "Could not load synchronization2 functions\n");
+		throw std::runtime_error("Could not load synchronization2 functions");
+	}
+	if (_dynamicStates.extendedDynamicState) {
+		vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(_device.getProcAddr("vkCmdSetCullModeEXT"));
+		vkCmdSetPrimitiveTopologyEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(_device.getProcAddr("vkCmdSetPrimitiveTopologyEXT"));
+		vkCmdSetDepthTestEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(_device.getProcAddr("vkCmdSetDepthTestEnableEXT"));
+		vkCmdSetDepthWriteEnableEXT = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(_device.getProcAddr("vkCmdSetDepthWriteEnableEXT"));
+		vkCmdSetDepthCompareOpEXT = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(_device.getProcAddr("vkCmdSetDepthCompareOpEXT"));
+	}
+	if (_dynamicStates.extendedDynamicState2) {
+		vkCmdSetPrimitiveRestartEnableEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(_device.getProcAddr("vkCmdSetPrimitiveRestartEnableEXT"));
+	}
+	if (_dynamicStates.polygonMode) {
+		vkCmdSetPolygonModeEXT = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(_device.getProcAddr("vkCmdSetPolygonModeEXT"));
+	}
+	if (_dynamicStates.vertexInput) {
+		vkCmdSetVertexInputEXT = reinterpret_cast<PFN_vkCmdSetVertexInputEXT>(_device.getProcAddr("vkCmdSetVertexInputEXT"));
+	}
+	if (executableProperties) {
+		vkGetPipelineExecutablePropertiesKHR = reinterpret_cast<PFN_vkGetPipelineExecutablePropertiesKHR>(_device.getProcAddr("vkGetPipelineExecutablePropertiesKHR"));
+		vkGetPipelineExecutableStatisticsKHR = reinterpret_cast<PFN_vkGetPipelineExecutableStatisticsKHR>(_device.getProcAddr("vkGetPipelineExecutableStatisticsKHR"));
+		executableProperties = vkGetPipelineExecutablePropertiesKHR && vkGetPipelineExecutableStatisticsKHR;
+	}
 	PrintSuccessMessage();
+	printf_color(ConsoleColor::Cyan, "Extended dynamic state: %s, 2: %s, polygon mode: %s, vertex input: %s\n",
+		_dynamicStates.extendedDynamicState ? "yes" : "no", _dynamicStates.extendedDynamicState2 ? "yes" : "no",
+		_dynamicStates.polygonMode ? "yes" : "no", _dynamicStates.vertexInput ? "yes" : "no");
 #pragma endregion
 
 #pragma region Descriptor Pool
@@ -91,12 +226,27 @@ Device::Device(vrg::Instance& instance, uint32_t deviceIndex, std::vector<std::s
 	vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 				std::min(1024u, _limits.maxDescriptorSetUniformBuffers)),
 	vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 		std::min(1024u, _limits.maxDescriptorSetUniformBuffersDynamic)),
 	vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 				std::min(1024u, _limits.maxDescriptorSetStorageBuffers)),
-	vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic, 		std::min(1024u, _limits.maxDescriptorSetStorageBuffersDynamic))
+	vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic, 		std::min(1024u, _limits.maxDescriptorSetStorageBuffersDynamic)),
+	vk::DescriptorPoolSize(vk::DescriptorType::eUniformTexelBuffer, 		std::min(1024u, _limits.maxDescriptorSetSampledImages)),
+	vk::DescriptorPoolSize(vk::DescriptorType::eStorageTexelBuffer, 		std::min(1024u, _limits.maxDescriptorSetStorageImages))
 	};
 
 	_descriptorPool = _device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 8192, poolSizes));
 #pragma endregion
 
+#pragma region Pipeline Cache
+	_pipelineCache = _device.createPipelineCache(vk::PipelineCacheCreateInfo());
+	_pipelineTelemetry = std::make_unique<PipelineTelemetry>(*this, creationFeedback, executableProperties);
+	if (pipelineLibrary) {
+		vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties = {};
+		vk::PhysicalDeviceProperties2 properties2 = {};
+		properties2.pNext = &libraryProperties;
+		_physicalDevice.getProperties2(&properties2);
+		_pipelineLibrary = std::make_unique<PipelineLibrary>(*this, libraryProperties.graphicsPipelineLibraryFastLinking);
+		printf_color(ConsoleColor::Cyan, "Graphics pipeline libraries enabled, fast linking: %s\n", libraryProperties.graphicsPipelineLibraryFastLinking ? "yes" : "no");
+	}
+#pragma endregion
+
 #pragma region Create Queues
 	for (const auto& info : queueCreateInfos) {
 		QueueFamily q = {};
@@ -134,8 +284,12 @@ Device::~Device() {
 		}
 	}
 	_queueFamilies.clear();
+	_samplers.clear();
 
 	_device.destroyDescriptorPool(_descriptorPool);
+	_pipelineLibrary.reset();
+	_pipelineTelemetry.reset();
+	_device.destroyPipelineCache(_pipelineCache);
 	_allocationInfo.clear();
 
 	vmaDestroyAllocator(_memoryAllocator);
@@ -215,6 +369,51 @@ Device::QueueFamily* Device::FindQueueFamily(vk::SurfaceKHR surface) {
 	return nullptr;
 }
 
+vk::FormatFeatureFlags Device::FormatFeatures(vk::Format format, vk::ImageTiling tiling) const {
+	vk::FormatProperties properties = _physicalDevice.getFormatProperties(format);
+	return tiling == vk::ImageTiling::eLinear ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+}
+
+std::shared_ptr<Sampler> Device::GetSampler(const vk::SamplerCreateInfo& createInfo, const std::string& name) {
+	if (createInfo.pNext) {
+		return std::make_shared<Sampler>(*this, name, createInfo);
+	}
+
+	std::scoped_lock lock(_samplerMutex);
+	size_t key = HashSamplerInfo(createInfo);
+	auto it = _samplers.find(key);
+	if (it != _samplers.end()) {
+		if (it->second->CreateInfo() == createInfo) {
+			return it->second;
+		}
+		//hash collision, keep the cached one and hand out a private sampler
+		return std::make_shared<Sampler>(*this, name, createInfo);
+	}
+
+	if (_samplers.size() >= _limits.maxSamplerAllocationCount) {
+		errf_color(ConsoleColor::Yellow, "Sampler cache exceeds maxSamplerAllocationCount (%u)\n", _limits.maxSamplerAllocationCount);
+	}
+	return _samplers.emplace(key, std::make_shared<Sampler>(*this, name, createInfo)).first->second;
+}
+
+std::shared_ptr<SharedPipeline> Device::GetPipeline(size_t key, const std::function<std::shared_ptr<SharedPipeline>()>& create) {
+	{
+		std::scoped_lock lock(_pipelineMutex);
+		auto it = _pipelines.find(key);
+		if (it != _pipelines.end()) {
+			if (std::shared_ptr<SharedPipeline> pipeline = it->second.lock()) return pipeline;
+		}
+	}
+
+	//created outside the lock so pipelines compile in parallel, two threads missing on the same key both create and the first one is kept
+	std::shared_ptr<SharedPipeline> created = create();
+	std::scoped_lock lock(_pipelineMutex);
+	std::weak_ptr<SharedPipeline>& entry = _pipelines[key];
+	if (std::shared_ptr<SharedPipeline> pipeline = entry.lock()) return pipeline;
+	entry = created;
+	return created;
+}
+
 std::shared_ptr<CommandBuffer> Device::GetCommandBuffer(const std::string& name, vk::QueueFlags queueFlags, vk::CommandBufferLevel level) {
 	QueueFamily* queueFamily = nullptr;
 	for (auto& [queueFamilyIndex, family] : _queueFamilies)
@@ -256,22 +455,59 @@ std::shared_ptr<CommandBuffer> Device::GetCommandBuffer(const std::string& name,
 }
 
 void Device::Execute(std::shared_ptr<CommandBuffer> commandBuffer) {
-	std::vector<vk::PipelineStageFlags> waitStages;
-	std::vector<vk::Semaphore> waitSemaphores;
-	std::vector<vk::Semaphore> signalSemaphores;
-	std::vector<vk::CommandBuffer> commandBuffers = { **commandBuffer };
+	std::vector<vk::SemaphoreSubmitInfoKHR> waitSemaphores;
+	std::vector<vk::SemaphoreSubmitInfoKHR> signalSemaphores;
 	for (auto& [stage, semaphore] : commandBuffer->_waitSemaphores) {
-		waitStages.push_back(stage);
-		waitSemaphores.push_back(*semaphore);
+		waitSemaphores.push_back(vk::SemaphoreSubmitInfoKHR(*semaphore, 0, stage));
 	}
-	for (auto& semaphore : commandBuffer->_signalSemaphores) {
-		signalSemaphores.push_back(**semaphore);
+	for (auto& [stage, semaphore] : commandBuffer->_signalSemaphores) {
+		signalSemaphores.push_back(vk::SemaphoreSubmitInfoKHR(**semaphore, 0, stage));
 	}
+	vk::CommandBufferSubmitInfoKHR commandBufferInfo(**commandBuffer);
+
+	commandBuffer->FlushBarriers();
 	(*commandBuffer)->end();
-	commandBuffer->_queueFamily->queues[0].submit({ vk::SubmitInfo(waitSemaphores, waitStages, commandBuffers, signalSemaphores) }, **commandBuffer->_completionFence);
+	vk::SubmitInfo2KHR submitInfo({}, waitSemaphores, commandBufferInfo, signalSemaphores);
+	vk::Result result = (vk::Result)vkQueueSubmit2KHR(commandBuffer->_queueFamily->queues[0], 1, reinterpret_cast<const VkSubmitInfo2KHR*>(&submitInfo), **commandBuffer->_completionFence);
+	if (result != vk::Result::eSuccess) {
+		throw std::runtime_error("Queue submit failed: " + vk::to_string(result));
+	}
 	commandBuffer->_state = CommandBuffer::CommandBufferState::InFlight;
+	commandBuffer->_submitIndex = _submitCount++;
 
 	commandBuffer->_queueFamily->commandBuffers.at(std::this_thread::get_id()).second.emplace_back(commandBuffer);
+	CollectDeferred();
+}
+
+void Device::DeferDestroy(std::shared_ptr<DeviceResource> resource) {
+	std::scoped_lock lock(_deferredMutex);
+	_deferredDestroy.emplace_back(_submitCount, std::move(resource));
+}
+
+void Device::CollectDeferred() {
+	{
+		std::scoped_lock lock(_pipelineMutex);
+		std::erase_if(_pipelines, [](const auto& entry) { return entry.second.expired(); });
+	}
+	if (_pipelineLibrary) _pipelineLibrary->Collect();
+
+	std::scoped_lock lock(_deferredMutex);
+	if (_deferredDestroy.empty()) return;
+
+	uint64_t oldestInFlight = _submitCount;
+	for (auto& [index, queueFamily] : _queueFamilies) {
+		for (auto& [threadid, cmdpair] : queueFamily.commandBuffers) {
+			for (auto& commandBuffer : cmdpair.second) {
+				if (!commandBuffer->CheckDone()) {
+					oldestInFlight = std::min(oldestInFlight, commandBuffer->_submitIndex);
+				}
+			}
+		}
+	}
+	//an entry only waits on submissions made before it was deferred
+	while (!_deferredDestroy.empty() && _deferredDestroy.front().first <= oldestInFlight) {
+		_deferredDestroy.pop_front();
+	}
 }
 
 void Device::Flush() {
@@ -283,4 +519,6 @@ void Device::Flush() {
 			}
 		}
 	}
+	std::scoped_lock lock(_deferredMutex);
+	_deferredDestroy.clear();
 }
\ No newline at end of file
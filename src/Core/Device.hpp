@@ -5,6 +5,11 @@
 namespace vrg {
 
 	class CommandBuffer;
+	class Sampler;
+	class PipelineLibrary;
+	class PipelineTelemetry;
+	class PipelineRecorder;
+	struct SharedPipeline;
 
 	class DeviceResource {
 	private:
@@ -35,17 +40,53 @@ namespace vrg {
 
 		inline vk::PhysicalDevice PhysicalDevice() const { return _physicalDevice; }
 		inline const vk::PhysicalDeviceLimits& Limits() const { return _limits; }
-		//inline vk::PipelineCache PipelineCache() const { return _pipelineCache; }
+		inline const vk::PhysicalDeviceFeatures& EnabledFeatures() const { return _enabledFeatures; }
+		// Integrated gpus share memory with the host, uploads can write straight into the buffers the gpu reads
+		inline bool UnifiedMemory() const { return _properties.deviceType == vk::PhysicalDeviceType::eIntegratedGpu; }
+
+		// Optional dynamic state extensions that were found and enabled. Graphics pipelines can only make these states dynamic
+		struct DynamicStateSupport {
+			//cull mode, primitive topology, depth test, depth write and depth compare op
+			bool extendedDynamicState = false;
+			//primitive restart
+			bool extendedDynamicState2 = false;
+			//polygon mode from VK_EXT_extended_dynamic_state3
+			bool polygonMode = false;
+			//vertex bindings, strides and attributes
+			bool vertexInput = false;
+		};
+		inline const DynamicStateSupport& DynamicStates() const { return _dynamicStates; }
+		// VK_EXT_index_type_uint8 was found and enabled, index buffers may have a stride of 1
+		inline bool IndexTypeUint8() const { return _indexTypeUint8; }
+		// Shared by every pipeline created on this device, safe to use from several threads at once
+		inline vk::PipelineCache PipelineCache() const { return _pipelineCache; }
+		// Shared graphics pipeline parts, null without VK_EXT_graphics_pipeline_library
+		inline PipelineLibrary* PipelineLibraries() const { return _pipelineLibrary.get(); }
+		// Creation time and cache hits of every pipeline created on this device
+		inline PipelineTelemetry& Telemetry() const { return *_pipelineTelemetry; }
 		inline const std::vector<uint32_t>& QueueFamilies(uint32_t index) const { return _queueFamilyIndices; }
 
 		inline vrg::Instance& Instance() const { return _instance; }
 
 		QueueFamily* FindQueueFamily(vk::SurfaceKHR surface);
 
+		//format features supported for images created with the given tiling
+		vk::FormatFeatureFlags FormatFeatures(vk::Format format, vk::ImageTiling tiling = vk::ImageTiling::eOptimal) const;
+
+		//returns a shared sampler for identical create infos, drivers only allow a few thousand sampler objects
+		std::shared_ptr<Sampler> GetSampler(const vk::SamplerCreateInfo& createInfo, const std::string& name = "Sampler");
+		// The live pipeline handle for a graphics pipeline content hash, made by create on a miss. Pipelines that only differ in
+		// dynamic state share one handle. Entries go away with the last pipeline using them
+		std::shared_ptr<SharedPipeline> GetPipeline(size_t key, const std::function<std::shared_ptr<SharedPipeline>()>& create);
+
 		std::shared_ptr<CommandBuffer> GetCommandBuffer(const std::string& name, vk::QueueFlags queueFlags = vk::QueueFlagBits::eGraphics, vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 		void Execute(std::shared_ptr<CommandBuffer> commandBuffer);
 		void Flush();
 
+		// Keeps the resource alive until every command buffer submitted so far has finished.
+		// For objects whose handles may still be referenced by in-flight work, like pipelines replaced during hot reload
+		void DeferDestroy(std::shared_ptr<DeviceResource> resource);
+
 
 		inline const VmaAllocator& Allocator() const { return _memoryAllocator; }
 		VmaAllocation AllocateMemory(vk::MemoryRequirements requirements, vk::MemoryPropertyFlags properties, VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_UNKNOWN);
@@ -62,6 +103,8 @@ namespace vrg {
 		friend class DescriptorSet;
 		friend class Instance;
 		friend class CommandBuffer;
+		friend class PipelineTelemetry;
+		friend class PipelineRecorder;
 
 		vrg::Instance& _instance;
 		vk::Device _device;
@@ -70,13 +113,49 @@ namespace vrg {
 		vk::PhysicalDeviceLimits _limits;
 		vk::PhysicalDeviceProperties _properties;
 		vk::PhysicalDeviceFeatures _features;
+		vk::PhysicalDeviceFeatures _enabledFeatures;
+		DynamicStateSupport _dynamicStates;
+		bool _indexTypeUint8 = false;
 
 		std::vector<uint32_t> _queueFamilyIndices;
 		std::unordered_map<uint32_t, QueueFamily> _queueFamilies;
 		vk::DescriptorPool _descriptorPool;
+		vk::PipelineCache _pipelineCache;
+		std::unique_ptr<PipelineLibrary> _pipelineLibrary;
+		std::unique_ptr<PipelineTelemetry> _pipelineTelemetry;
+		//set while a PipelineRecorder exists, told about every pipeline the first time it is bound
+		PipelineRecorder* _pipelineRecorder = nullptr;
+
+		uint64_t _submitCount = 0;
+		std::mutex _deferredMutex;
+		std::deque<std::pair<uint64_t, std::shared_ptr<DeviceResource>>> _deferredDestroy;
+		void CollectDeferred();
+
+		std::mutex _samplerMutex;
+		std::unordered_map<size_t, std::shared_ptr<Sampler>> _samplers;
+
+		std::mutex _pipelineMutex;
+		//expired entries are dropped by CollectDeferred
+		std::unordered_map<size_t, std::weak_ptr<SharedPipeline>> _pipelines;
 
 		VmaAllocator _memoryAllocator;
 		std::unordered_map<VmaAllocation, VmaAllocationInfo> _allocationInfo;
+
+		//VK_KHR_synchronization2 entry points, not exported by the loader
+		PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR = nullptr;
+		PFN_vkQueueSubmit2KHR vkQueueSubmit2KHR = nullptr;
+		//extended dynamic state entry points, null unless the extension is enabled
+		PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+		PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+		PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+		PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+		PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+		PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT = nullptr;
+		PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT = nullptr;
+		PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT = nullptr;
+		//VK_KHR_pipeline_executable_properties, null unless statistics can be captured
+		PFN_vkGetPipelineExecutablePropertiesKHR vkGetPipelineExecutablePropertiesKHR = nullptr;
+		PFN_vkGetPipelineExecutableStatisticsKHR vkGetPipelineExecutableStatisticsKHR = nullptr;
 	};
 
 	class Fence : public DeviceResource {
@@ -0,0 +1,59 @@
+#include "Downsampler.hpp"
+
+using namespace vrg;
+
+Downsampler::Downsampler(Device& device, const std::shared_ptr<SpirvModule>& module)
+	: _device(device) {
+	_pipeline = std::make_shared<ComputePipeline>(device, "Downsampler", module);
+}
+
+bool Downsampler::Supports(const Texture& texture) const {
+	const vk::PhysicalDeviceFeatures& features = _device.EnabledFeatures();
+	if (!features.shaderStorageImageReadWithoutFormat || !features.shaderStorageImageWriteWithoutFormat || !features.shaderStorageImageArrayDynamicIndexing) {
+		return false;
+	}
+	if (texture.Extent().depth > 1 || texture.MipLevels() > MaxMips || texture.SampleCount() != vk::SampleCountFlagBits::e1) {
+		return false;
+	}
+	if (!(texture.AspectFlags() & vk::ImageAspectFlagBits::eColor) || !(texture.Usage() & vk::ImageUsageFlagBits::eStorage)) {
+		return false;
+	}
+	return (bool)(_device.FormatFeatures(texture.Format(), texture.Tiling()) & vk::FormatFeatureFlagBits::eStorageImage);
+}
+
+void Downsampler::Generate(CommandBuffer& commandBuffer, const std::shared_ptr<Texture>& texture) {
+	const uint32_t mipCount = texture->MipLevels() - 1;
+	const uint32_t groupsX = (texture->Extent().width + 63) / 64;
+	const uint32_t groupsY = (texture->Extent().height + 63) / 64;
+
+	//mip 0 is read and every other mip written as storage images
+	texture->TransitionBarrier(commandBuffer, vk::ImageLayout::eGeneral);
+
+	//one counter per call so command buffers in flight on different queues never share one
+	auto counter = std::make_shared<Buffer>(_device, "Downsampler counter", sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
+	commandBuffer.FillBuffer(Buffer::View<std::byte>(counter), 0);
+	commandBuffer.Barrier(vk::BufferMemoryBarrier2KHR(vk::PipelineStageFlagBits2KHR::eClear, vk::AccessFlagBits2KHR::eTransferWrite,
+		vk::PipelineStageFlagBits2KHR::eComputeShader, vk::AccessFlagBits2KHR::eShaderStorageRead | vk::AccessFlagBits2KHR::eShaderStorageWrite,
+		VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, **counter, 0, VK_WHOLE_SIZE));
+
+	commandBuffer.BindPipeline(_pipeline);
+	struct {
+		uint32_t mipCount;
+		uint32_t workGroupCount;
+	} pushConstants = { mipCount, groupsX * groupsY };
+	commandBuffer->pushConstants(_pipeline->Layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+
+	//the counter is reset by the last workgroup of each layer, Dispatch orders the layers with a storage barrier
+	for (uint32_t layer = 0; layer < texture->ArrayLayers(); ++layer) {
+		auto descriptorSet = std::make_shared<DescriptorSet>(_pipeline->DescriptorSetLayouts()[0], "Downsampler");
+		for (uint32_t mip = 0; mip < MaxMips; ++mip) {
+			//array elements past the last mip are never accessed but must still hold a valid image
+			Texture::View view(texture, std::min(mip, mipCount), 1, layer, 1);
+			descriptorSet->InsertOrAssign(MipsBinding, mip, std::make_tuple(view, vk::ImageLayout::eGeneral, std::shared_ptr<Sampler>()));
+		}
+		descriptorSet->InsertOrAssign(CounterBinding, Buffer::View<std::byte>(counter));
+
+		commandBuffer.BindDescriptorSet(0, descriptorSet);
+		commandBuffer.Dispatch(groupsX, groupsY, 1);
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CommandBuffer.hpp"
+
+namespace vrg {
+
+	// Generates a texture's whole mip chain with a single compute dispatch per array layer (see Shaders/downsample.hlsl)
+	class Downsampler {
+	public:
+		static constexpr uint32_t MaxMips = 13;
+		static constexpr uint32_t MipsBinding = 0;
+		static constexpr uint32_t CounterBinding = 1;
+
+		Downsampler(Device& device, const std::shared_ptr<SpirvModule>& module);
+
+		bool Supports(const Texture& texture) const;
+
+		// Leaves every mip of the texture in vk::ImageLayout::eGeneral
+		void Generate(CommandBuffer& commandBuffer, const std::shared_ptr<Texture>& texture);
+
+		inline std::shared_ptr<ComputePipeline> Pipeline() const { return _pipeline; }
+
+	private:
+		Device& _device;
+		std::shared_ptr<ComputePipeline> _pipeline;
+	};
+}
@@ -5,14 +5,36 @@
 #include "RenderPass.hpp"
 #include "Mesh.hpp"
 #include "ShaderManager.hpp"
+#include "PipelineCompiler.hpp"
+#include "PipelineTelemetry.hpp"
+#include "PipelineRecorder.hpp"
+#include "FrameCapture.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
 using namespace vrg;
 
+static const std::string vertexShaderFile = "E:/Desktop/VulkanEngineTry1/VulkanEngineTry1/testvert.hlsl";
+static const std::string fragmentShaderFile = "E:/Desktop/VulkanEngineTry1/VulkanEngineTry1/testfrag.hlsl";
+
+struct EngineOptions {
+    //renders into an offscreen target behind a hidden window, nothing is presented
+    bool headless = false;
+    //writes every frame into this directory when set
+    std::string captureDirectory;
+    //stops after this many frames, 0 runs until the window is closed
+    uint32_t frameCount = 0;
+    //precompiled shaders used instead of compiling the HLSL sources
+    std::string shaderBundle;
+    //pipeline creation times, cache hits and shader statistics are written here on exit
+    std::string pipelineTelemetry;
+    //pipelines bound in earlier runs are read from here and prewarmed on startup, this run's are added on exit
+    std::string pipelineUsage;
+};
+
 class Engine {
 public:
-    inline Engine() {
+    inline Engine(const EngineOptions& options = {}) : _options(options) {
         init();
     }
     inline ~Engine() {
@@ -29,18 +51,41 @@ private:
 
 
 
+    EngineOptions _options;
     std::unique_ptr<Instance> _instance;
     std::unique_ptr<ShaderManager> _sm;
+    std::unique_ptr<PipelineCompiler> _pipelineCompiler;
+    std::unique_ptr<PipelineRecorder> _pipelineRecorder;
+    std::unique_ptr<FrameCapture> _capture;
 
     inline void init() {
         glfwInit();
+        if (_options.headless) {
+            //the device still picks its queues against the window surface
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        }
         std::vector<std::string> extensions = {};
         std::vector<std::string> layers = {};
         _instance = std::make_unique<Instance>();
+        if (!_options.pipelineTelemetry.empty()) {
+            _instance->Device().Telemetry().SetCaptureStatistics(true);
+        }
 
         _sm = std::make_unique<ShaderManager>(*_instance->Device());
-        _sm->FetchFile("E:/Desktop/VulkanEngineTry1/VulkanEngineTry1/testvert.hlsl", vk::ShaderStageFlagBits::eVertex, { "testvert" });
-        _sm->FetchFile("E:/Desktop/VulkanEngineTry1/VulkanEngineTry1/testfrag.hlsl", vk::ShaderStageFlagBits::eFragment, { "testfrag" });
+        _pipelineCompiler = std::make_unique<PipelineCompiler>();
+        if (!_options.pipelineUsage.empty()) {
+            _pipelineRecorder = std::make_unique<PipelineRecorder>(_instance->Device(), *_sm);
+        }
+        if (!_options.shaderBundle.empty()) {
+            _sm->LoadBundle(_options.shaderBundle);
+        }
+        //the vertex shader variant depends on the mesh's formats, it is fetched once the mesh exists
+        auto shaders = _sm->FetchFiles({
+            { fragmentShaderFile, vk::ShaderStageFlagBits::eFragment, { "testfrag" } }
+        });
+        for (auto& shader : shaders) {
+            shader.wait();
+        }
     }
 
     inline void loop() {
@@ -51,7 +96,7 @@ private:
         auto resolveAttachment = vk::AttachmentDescription({}, vk::Format::eR8G8B8A8Unorm, vk::SampleCountFlagBits::e1,
             vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
             vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-            vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+            vk::ImageLayout::eColorAttachmentOptimal, _options.headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR);
 
         auto depthAttachment = vk::AttachmentDescription({}, vk::Format::eD32Sfloat, vk::SampleCountFlagBits::e1,
             vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
@@ -71,15 +116,35 @@ private:
         auto triangle = Mesh::Cube(*initCommandBuffer);
 
         BufferVector<glm::mat4> camera(_instance->Device(), 2);
-        const glm::mat4 model = glm::mat4(1.0f);
+        //quantized positions are decoded by the model matrix
+        const glm::mat4 positionTransform = triangle->PositionTransform();
         glm::mat4 view = glm::lookAt(glm::vec3(2.0f, -2.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f);
         proj[1][1] *= -1;
-        const std::vector<glm::mat4> cam = { model, proj * view };
+        const std::vector<glm::mat4> cam = { positionTransform, proj * view };
         memcpy(camera.Data(), cam.data(), cam.size() * sizeof(glm::mat4));
         Buffer::StrideView cambuffer = initCommandBuffer->CopyBuffer<glm::mat4>(camera, vk::BufferUsageFlagBits::eUniformBuffer);
 
-        std::vector<std::shared_ptr<SpirvModule>> mainshaders = { _sm->Get({ "testvert" }), _sm->Get({ "testfrag" }) };
+        bool prewarming = false;
+        if (_pipelineRecorder) {
+            prewarming = _pipelineRecorder->Prewarm(_options.pipelineUsage, *_pipelineCompiler, { renderPass }) > 0;
+        }
+
+        ShaderCompileOptions vertexOptions = { "testvert" };
+        vertexOptions.defines = triangle->Geometry().DecodeDefines();
+        std::vector<std::shared_ptr<SpirvModule>> mainshaders = { _sm->FetchFile(vertexShaderFile, vk::ShaderStageFlagBits::eVertex, vertexOptions), _sm->Get({ "testfrag" }) };
+        //compiled on a worker, frames are recorded without the cube until it is ready
+        auto pipeline = _pipelineCompiler->Compile("test", [this, renderPass, mainshaders, triangle, blendOpaque]() mutable {
+            return std::shared_ptr<Pipeline>(new GraphicsPipeline(_instance->Device(), "test", *renderPass, mainshaders, triangle->Geometry(), 0, vk::CullModeFlagBits::eBack, vk::PolygonMode::eFill, { {}, true, true, vk::CompareOp::eLessOrEqual, 0U, 0U, {}, {}, 0, 1 }, { blendOpaque }, { vk::DynamicState::eViewport, vk::DynamicState::eScissor, vk::DynamicState::eLineWidth }));
+        }, nullptr, [this](const std::shared_ptr<AsyncPipeline>& compiled) {
+            //shader edits are recompiled in the background and swapped into the pipeline between frames
+            if (compiled->Ready()) _sm->TrackPipeline(compiled->Get());
+        });
+        _sm->EnableHotReload();
+        if (!_options.captureDirectory.empty()) {
+            //captured frames should all show the scene, treat startup as a loading screen
+            _pipelineCompiler->WaitIdle();
+        }
 
         _instance->Device().Execute(initCommandBuffer);
 
@@ -88,16 +153,38 @@ private:
 
         float totalTime = 0;
 
+        if (!_options.captureDirectory.empty()) {
+            _capture = std::make_unique<FrameCapture>(_instance->Device(), _options.captureDirectory);
+        }
+        std::shared_ptr<Texture> offscreen;
+        if (_options.headless) {
+            offscreen = std::make_shared<Texture>(_instance->Device(), "offscreen", vk::Extent3D(800, 600, 1), resolveAttachment, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc);
+        }
+        uint32_t frameIndex = 0;
+
         while (!glfwWindowShouldClose(*_instance->Window())) {
+            if (_options.frameCount && frameIndex >= _options.frameCount) break;
             glfwPollEvents();
+            _sm->Update();
+            _pipelineCompiler->Poll();
+            //prewarmed pipelines only fill the driver cache, drop them once the batch is built
+            if (prewarming && _pipelineCompiler->Idle()) {
+                _pipelineRecorder->ReleasePrewarmed();
+                prewarming = false;
+            }
 
             auto commandBuffer = _instance->Device().GetCommandBuffer("Frame");
 
-            std::shared_ptr<Semaphore> renderSemaphore = std::make_shared<Semaphore>(_instance->Device(), "RenderSemaphore");
-            commandBuffer->SignalOnComplete(vk::PipelineStageFlagBits::eAllCommands, renderSemaphore);
+            std::shared_ptr<Semaphore> renderSemaphore;
+            if (!_options.headless) {
+                renderSemaphore = std::make_shared<Semaphore>(_instance->Device(), "RenderSemaphore");
+                //present reads the image after every command in the frame, so the signal can't be narrowed
+                commandBuffer->SignalOnComplete(vk::PipelineStageFlagBits2KHR::eAllCommands, renderSemaphore);
 
-            _instance->Window().AcquireNextImage(*commandBuffer);
-            commandBuffer->WaitOn(vk::PipelineStageFlagBits::eAllCommands, _instance->Window().ImageAvailableSemaphore());
+                _instance->Window().AcquireNextImage(*commandBuffer);
+                //only writing the backbuffer has to wait for the presentation engine, anything before it can overlap the acquire
+                commandBuffer->WaitOn(vk::PipelineStageFlagBits2KHR::eColorAttachmentOutput, _instance->Window().ImageAvailableSemaphore());
+            }
 
 
 
@@ -106,62 +193,114 @@ private:
             totalTime += frameTime;
             t0 = t1;
 
-            if (_instance->Window().Swapchain()) {
+            if (_options.headless || _instance->Window().Swapchain()) {
                 //main render
-                auto primary_depth = std::make_shared<Texture>(_instance->Device(), "primary_depth", vk::Extent3D(_instance->Window().Extent(), 1), depthAttachment, vk::ImageUsageFlagBits::eDepthStencilAttachment);
+                vrg::Texture::View backbuffer = _options.headless ? Texture::View(offscreen) : _instance->Window().BackBuffer();
+                auto primary_depth = std::make_shared<Texture>(_instance->Device(), "primary_depth", backbuffer.Texture().Extent(), depthAttachment, vk::ImageUsageFlagBits::eDepthStencilAttachment);
 
-                vrg::Texture::View backbuffer = _instance->Window().BackBuffer();
                 std::shared_ptr<Framebuffer> framebuffer = std::make_shared<Framebuffer>("framebuffer", *renderPass, backbuffer, Texture::View(primary_depth) );
 
                 std::vector<vk::ClearValue> clearValues(framebuffer->size());
                 clearValues[renderPass->AttachmentIndex("swapchain_image")].setColor(std::array<float, 4>{1.0f, 0.0f, 1.0f, 0.0f});
                 clearValues[renderPass->AttachmentIndex("primary_depth")].setDepthStencil({ 1, 0 });
 
-                std::vector<glm::mat4> cam = { glm::rotate(glm::mat4(1.0f), totalTime * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), proj * view };
+                std::vector<glm::mat4> cam = { glm::rotate(glm::mat4(1.0f), totalTime * glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * positionTransform, proj * view };
                 memcpy(camera.Data(), cam.data(), cam.size() * sizeof(glm::mat4));
                 commandBuffer->CopyBuffer((Buffer::View<std::byte>)camera, cambuffer);
 
                 commandBuffer->BeginRenderPass(renderPass, framebuffer, clearValues);
                 (*commandBuffer)->setViewport(0, { vk::Viewport(0, (float)framebuffer->Extent().height, (float)framebuffer->Extent().width, -(float)framebuffer->Extent().height, 0, 1) });
                 (*commandBuffer)->setScissor(0, { vk::Rect2D(vk::Offset2D(0,0), framebuffer->Extent()) });
-                
-                auto pipeline = std::shared_ptr<GraphicsPipeline>(new GraphicsPipeline(_instance->Device(), "test", *renderPass, mainshaders, triangle->Geometry(), 0, vk::CullModeFlagBits::eBack, vk::PolygonMode::eFill, { {}, true, true, vk::CompareOp::eLessOrEqual, 0U, 0U, {}, {}, 0, 1 }, { blendOpaque }, { vk::DynamicState::eViewport, vk::DynamicState::eScissor, vk::DynamicState::eLineWidth }));
-                commandBuffer->BindPipeline(pipeline);
-                commandBuffer->BindDescriptorSet(0, std::make_shared<DescriptorSet>(
-                    pipeline->DescriptorSetLayouts()[0], "main", std::unordered_map<uint32_t, Descriptor> {
-                        { pipeline->Binding("ubo").binding, cambuffer }
-                    })
-                );
-
-
 
-                triangle->Draw(*commandBuffer);
+                if (commandBuffer->BindPipeline(*pipeline)) {
+                    auto bound = commandBuffer->BoundPipeline();
+                    commandBuffer->BindDescriptorSet(0, std::make_shared<DescriptorSet>(
+                        bound->DescriptorSetLayouts()[0], "main", std::unordered_map<uint32_t, Descriptor> {
+                            { bound->Binding("ubo").binding, cambuffer }
+                        })
+                    );
+                    triangle->Draw(*commandBuffer);
+                }
 
                 //(*commandBuffer)->draw(3, 1, 0, 0);
                 commandBuffer->EndRenderPass();
+
+                if (_capture) {
+                    _capture->Capture(commandBuffer, backbuffer);
+                    if (!_options.headless) {
+                        backbuffer.Texture().TransitionBarrier(*commandBuffer, vk::ImageLayout::ePresentSrcKHR);
+                    }
+                }
             }
 
             _instance->Device().Execute(commandBuffer);
 
-            if (_instance->Window().Swapchain()) {
+            if (!_options.headless && _instance->Window().Swapchain()) {
                 _instance->Window().Present({ **renderSemaphore });
             }
 
+            if (_capture) {
+                _capture->Poll();
+            }
+            ++frameIndex;
+        }
+
+        if (_capture) {
+            _capture->Finish();
+            _capture.reset();
         }
     }
     
     inline void cleanup() {
 
         glfwTerminate();
+        _pipelineCompiler.reset();
+        if (_pipelineRecorder) {
+            _pipelineRecorder->Save(_options.pipelineUsage);
+            _pipelineRecorder.reset();
+        }
         _sm.reset();
         _instance->Device().Flush();
+        if (!_options.pipelineTelemetry.empty()) {
+            _instance->Device().Telemetry().PrintSummary();
+            _instance->Device().Telemetry().Dump(_options.pipelineTelemetry);
+        }
         _instance.reset();
     }
 
 };
 
-int main() {
-    Engine app;
+int main(int argc, char** argv) {
+    EngineOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--capture" && i + 1 < argc) {
+            options.captureDirectory = argv[++i];
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            options.frameCount = (uint32_t)std::atoi(argv[++i]);
+        }
+        else if (arg == "--shaders" && i + 1 < argc) {
+            options.shaderBundle = argv[++i];
+        }
+        else if (arg == "--pipeline-telemetry" && i + 1 < argc) {
+            options.pipelineTelemetry = argv[++i];
+        }
+        else if (arg == "--pipeline-usage" && i + 1 < argc) {
+            options.pipelineUsage = argv[++i];
+        }
+        else {
+            errf_color(ConsoleColor::Yellow, "Unknown argument %s\n", arg.c_str());
+        }
+    }
+    if (options.headless && options.frameCount == 0 && options.captureDirectory.empty()) {
+        errf_color(ConsoleColor::Yellow, "Headless without --frames or --capture renders until killed\n");
+    }
+
+    Engine app(options);
     app.Run();
     //try {
     //    app.Run();
@@ -2,8 +2,6 @@
 #include "StringPiece.hpp"
 
 #include <iostream>
-#include <io.h>
-#define R_OK 4
 
 using namespace vrg;
 
@@ -14,52 +12,73 @@ std::string MaybeSlash(const string_piece& path) {
 	return (path.empty() || path.back() == '/') ? "" : "/";
 }
 
-void OutputFileErrorMessage(int errno_value) {
-#ifdef _MSC_VER
-	// If the error message is more than 1023 bytes it will be truncated.
-	char buffer[1024];
-	strerror_s(buffer, errno_value);
-	std::cerr << ": " << buffer << std::endl;
-#else
-	std::cerr << ": " << strerror(errno_value) << std::endl;
-#endif
-}
+namespace vrg {
 
-bool ReadFile(const std::string& input_file_name,
-	std::vector<char>* input_data) {
-	std::istream* stream = &std::cin;
-	std::ifstream input_file;
-	if (input_file_name != "-") {
-		input_file.open(input_file_name, std::ios_base::binary);
-		stream = &input_file;
-		if (input_file.fail()) {
-			std::cerr << "glslc: error: cannot open input file: '" << input_file_name
-				<< "'";
-			if (_access(input_file_name.c_str(), R_OK) != 0) {
-				OutputFileErrorMessage(errno);
-				return false;
+	IncludeCache& IncludeCache::Shared() {
+		static IncludeCache cache;
+		return cache;
+	}
+
+	std::shared_ptr<const IncludeCache::File> IncludeCache::Get(const std::string& path) {
+		{
+			std::scoped_lock lock(_mutex);
+			auto missing = _missing.find(path);
+			if (missing != _missing.end()) {
+				if (std::chrono::steady_clock::now() - missing->second < MissingLifetime) return nullptr;
+				_missing.erase(missing);
 			}
-			std::cerr << std::endl;
-			return false;
 		}
-	}
-	*input_data = std::vector<char>((std::istreambuf_iterator<char>(*stream)),
-		std::istreambuf_iterator<char>());
-	return true;
-}
 
+		std::error_code error;
+		std::filesystem::file_time_type writeTime;
+		uintmax_t size = 0;
+		if (std::filesystem::is_regular_file(path, error)) {
+			writeTime = std::filesystem::last_write_time(path, error);
+			if (!error) size = std::filesystem::file_size(path, error);
+		}
+		else {
+			error = std::make_error_code(std::errc::no_such_file_or_directory);
+		}
+		if (error) {
+			std::scoped_lock lock(_mutex);
+			_missing[path] = std::chrono::steady_clock::now();
+			_files.erase(path);
+			return nullptr;
+		}
 
-namespace vrg {
+		{
+			std::scoped_lock lock(_mutex);
+			auto it = _files.find(path);
+			if (it != _files.end() && it->second->writeTime == writeTime && it->second->contents.size() == size) {
+				return it->second;
+			}
+		}
+
+		//read outside the lock, another thread loading the same file at the same time only costs a second read
+		auto file = std::make_shared<File>();
+		file->path = path;
+		file->writeTime = writeTime;
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream) return nullptr;
+		file->contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+		std::scoped_lock lock(_mutex);
+		_files[path] = file;
+		return file;
+	}
+
+	void IncludeCache::ClearMissing() {
+		std::scoped_lock lock(_mutex);
+		_missing.clear();
+	}
 
 	std::string FileFinder::FindReadableFilepath(
 		const std::string& filename) const {
 		assert(!filename.empty());
-		static const auto for_reading = std::ios_base::in;
-		std::filebuf opener;
 		for (const auto& prefix : _searchPath) {
 			const std::string prefixed_filename =
 				prefix + MaybeSlash(prefix) + filename;
-			if (opener.open(prefixed_filename, for_reading)) return prefixed_filename;
+			if (IncludeCache::Shared().Get(prefixed_filename)) return prefixed_filename;
 		}
 		return "";
 	}
@@ -80,11 +99,9 @@ namespace vrg {
 			dir_name.clear();
 		}
 
-		static const auto for_reading = std::ios_base::in;
-		std::filebuf opener;
 		const std::string relative_filename =
 			dir_name.str() + MaybeSlash(dir_name) + filename;
-		if (opener.open(relative_filename, for_reading)) return relative_filename;
+		if (IncludeCache::Shared().Get(relative_filename)) return relative_filename;
 
 		return FindReadableFilepath(filename);
 	}
@@ -108,26 +125,23 @@ namespace vrg {
 		if (full_path.empty())
 			return MakeErrorIncludeResult("Cannot find or open include file.");
 
-		// In principle, several threads could be resolving includes at the same
-		// time.  Protect the included_files.
-
-		// Read the file and save its full path and contents into stable addresses.
-		FileInfo* new_file_info = new FileInfo{ full_path, {} };
-		if (!ReadFile(full_path, &(new_file_info->contents))) {
+		//shaderc reads straight out of the cached contents, user_data keeps them alive until ReleaseInclude
+		auto file = IncludeCache::Shared().Get(full_path);
+		if (!file) {
 			return MakeErrorIncludeResult("Cannot read file");
 		}
 
 		_includedFiles.insert(full_path);
 
+		auto* holder = new std::shared_ptr<const IncludeCache::File>(std::move(file));
 		return new shaderc_include_result{
-			new_file_info->fullPath.data(), new_file_info->fullPath.length(),
-			new_file_info->contents.data(), new_file_info->contents.size(),
-			new_file_info };
+			(*holder)->path.data(), (*holder)->path.length(),
+			(*holder)->contents.data(), (*holder)->contents.size(),
+			holder };
 	}
 
 	void FileIncluder::ReleaseInclude(shaderc_include_result* include_result) {
-		FileInfo* info = static_cast<FileInfo*>(include_result->user_data);
-		delete info;
+		delete static_cast<std::shared_ptr<const IncludeCache::File>*>(include_result->user_data);
 		delete include_result;
 	}
 
@@ -3,10 +3,37 @@
 #include <shaderc/shaderc.hpp>
 #include "Util.hpp"
 
+#include <filesystem>
+
 //cpp implementation of FileIncluder from shaderc_util
 
 namespace vrg {
 
+	// Contents of included files shared by every compile on every thread. Entries are checked against the file's
+	// size and modification time on each lookup, files that weren't found are remembered for a moment so probing the search path stays cheap
+	class IncludeCache {
+	public:
+		struct File {
+			std::string path;
+			std::string contents;
+			std::filesystem::file_time_type writeTime;
+		};
+
+		static IncludeCache& Shared();
+
+		// nullptr if the file doesn't exist or can't be read
+		std::shared_ptr<const File> Get(const std::string& path);
+		// Forget files that weren't found, so ones created since are picked up
+		void ClearMissing();
+
+	private:
+		static constexpr std::chrono::seconds MissingLifetime = std::chrono::seconds(2);
+
+		std::mutex _mutex;
+		std::unordered_map<std::string, std::shared_ptr<const File>> _files;
+		std::unordered_map<std::string, std::chrono::steady_clock::time_point> _missing;
+	};
+
 	class FileFinder {
 	public:
 		std::string FindReadableFilepath(const std::string& filename) const;
@@ -36,10 +63,6 @@ namespace vrg {
 
 	private:
 		const FileFinder& _fileFinder;
-		struct FileInfo {
-			const std::string fullPath;
-			std::vector<char> contents;
-		};
 
 		std::unordered_set<std::string> _includedFiles;
 	};
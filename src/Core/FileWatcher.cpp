@@ -0,0 +1,108 @@
+#include "FileWatcher.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace vrg;
+
+static std::filesystem::file_time_type LastWriteTime(const std::filesystem::path& path) {
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+FileWatcher::FileWatcher(std::chrono::milliseconds pollInterval) : _pollInterval(pollInterval) {
+#ifdef __linux__
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify < 0) {
+		errf_color(ConsoleColor::Yellow, "inotify unavailable, polling shader files instead\n");
+	}
+#endif
+	_thread = std::thread(&FileWatcher::WatchThread, this);
+}
+
+FileWatcher::~FileWatcher() {
+	_stop = true;
+	_thread.join();
+#ifdef __linux__
+	if (_inotify >= 0) close(_inotify);
+#endif
+}
+
+void FileWatcher::Watch(const std::filesystem::path& file) {
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::weakly_canonical(file, error);
+	if (error) path = file;
+
+	std::scoped_lock lock(_mutex);
+	if (!_files.emplace(path.string(), LastWriteTime(path)).second) return;
+
+#ifdef __linux__
+	if (_inotify >= 0) {
+		std::filesystem::path directory = path.parent_path();
+		if (std::ranges::none_of(_directories, [&](const auto& d) { return d.second == directory; })) {
+			int wd = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (wd >= 0) {
+				_directories.emplace(wd, directory);
+			}
+			else {
+				errf_color(ConsoleColor::Yellow, "Could not watch %s\n", directory.c_str());
+			}
+		}
+	}
+#endif
+}
+
+std::vector<std::filesystem::path> FileWatcher::PollChanges() {
+	std::scoped_lock lock(_mutex);
+	std::vector<std::filesystem::path> changed(_changed.begin(), _changed.end());
+	_changed.clear();
+	return changed;
+}
+
+void FileWatcher::WatchThread() {
+	while (!_stop) {
+#ifdef __linux__
+		if (_inotify >= 0) {
+			pollfd fd = { _inotify, POLLIN, 0 };
+			if (poll(&fd, 1, (int)_pollInterval.count()) <= 0) continue;
+
+			alignas(inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(_inotify, buffer, sizeof(buffer))) > 0) {
+				std::scoped_lock lock(_mutex);
+				for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(p)->len) {
+					const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+					auto directory = _directories.find(event->wd);
+					if (directory == _directories.end() || event->len == 0) continue;
+					std::string path = (directory->second / event->name).string();
+					//events arrive for every file in the directory, only report the watched ones
+					if (_files.count(path)) {
+						_changed.insert(path);
+					}
+				}
+			}
+			continue;
+		}
+#endif
+		std::this_thread::sleep_for(_pollInterval);
+
+		//snapshot so the file system isn't touched under the lock
+		std::vector<std::pair<std::string, std::filesystem::file_time_type>> files;
+		{
+			std::scoped_lock lock(_mutex);
+			files.assign(_files.begin(), _files.end());
+		}
+		for (auto& [path, time] : files) {
+			auto current = LastWriteTime(path);
+			if (current != time) {
+				std::scoped_lock lock(_mutex);
+				_files[path] = current;
+				_changed.insert(path);
+			}
+		}
+	}
+}
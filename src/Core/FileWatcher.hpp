@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Util.hpp"
+
+#include <atomic>
+#include <filesystem>
+
+namespace vrg {
+
+	// Reports files that changed on disk. Uses inotify on Linux and falls back to polling modification times elsewhere.
+	// Directories are watched rather than files, so editors that save by writing a new file and renaming it over the old one are still seen
+	class FileWatcher {
+	public:
+		FileWatcher(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		void Watch(const std::filesystem::path& file);
+		// Files changed since the last call, each reported once. Never blocks on the file system
+		std::vector<std::filesystem::path> PollChanges();
+
+	private:
+		void WatchThread();
+
+		std::chrono::milliseconds _pollInterval;
+		std::thread _thread;
+		std::atomic<bool> _stop = false;
+
+		std::mutex _mutex;
+		std::unordered_map<std::string, std::filesystem::file_time_type> _files;
+		std::unordered_set<std::string> _changed;
+
+#ifdef __linux__
+		int _inotify = -1;
+		std::unordered_map<int, std::filesystem::path> _directories;
+#endif
+	};
+
+}
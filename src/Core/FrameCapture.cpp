@@ -0,0 +1,119 @@
+#include "FrameCapture.hpp"
+
+using namespace vrg;
+
+FrameCapture::FrameCapture(Device& device, const std::filesystem::path& directory, size_t maxQueuedFrames)
+	: _readback(device, (uint32_t)maxQueuedFrames + 2), _directory(directory), _maxQueuedFrames(maxQueuedFrames) {
+	std::filesystem::create_directories(_directory);
+	_writer = std::thread(&FrameCapture::WriterThread, this);
+}
+
+FrameCapture::~FrameCapture() {
+	{
+		std::scoped_lock lock(_mutex);
+		_stop = true;
+	}
+	_queueCondition.notify_all();
+	_writer.join();
+	printf("Frame capture: %zu frames written, %zu dropped\n", _framesWritten.load(), _framesDropped.load());
+}
+
+void FrameCapture::Capture(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view) {
+	//the disk can't keep up, skip the frame instead of stalling the render loop
+	if (_readback.PendingCount() >= _maxQueuedFrames) {
+		++_frameIndex;
+		++_framesDropped;
+		return;
+	}
+	size_t index = _frameIndex++;
+	_readback.Read(commandBuffer, view, [this, index](std::shared_ptr<const ReadbackData> data) {
+		{
+			std::scoped_lock lock(_mutex);
+			if (_queue.size() >= _maxQueuedFrames) {
+				++_framesDropped;
+				return;
+			}
+			_queue.push_back(Frame{ index, std::move(data) });
+		}
+		_queueCondition.notify_one();
+	});
+}
+
+void FrameCapture::Poll() {
+	_readback.Poll();
+}
+
+void FrameCapture::Finish() {
+	while (_readback.PendingCount()) {
+		_readback.Poll();
+		std::this_thread::yield();
+	}
+	std::unique_lock lock(_mutex);
+	_idleCondition.wait(lock, [&]() { return _queue.empty() && !_writing; });
+}
+
+void FrameCapture::WriterThread() {
+	while (true) {
+		Frame frame;
+		{
+			std::unique_lock lock(_mutex);
+			_queueCondition.wait(lock, [&]() { return _stop || !_queue.empty(); });
+			if (_queue.empty()) {
+				break;
+			}
+			frame = std::move(_queue.front());
+			_queue.pop_front();
+			_writing = true;
+		}
+
+		WriteFrame(frame);
+		//release the staging buffer before waking Finish
+		frame.data.reset();
+
+		{
+			std::scoped_lock lock(_mutex);
+			_writing = false;
+		}
+		_idleCondition.notify_all();
+	}
+}
+
+void FrameCapture::WriteFrame(const Frame& frame) {
+	const ReadbackData& data = *frame.data;
+	vk::Extent3D extent = data.Extent();
+	std::span<const std::byte> bytes = data.Data();
+
+	char name[32];
+	snprintf(name, sizeof(name), "frame_%06zu", frame.index);
+
+	bool bgra = data.Format() == vk::Format::eB8G8R8A8Unorm || data.Format() == vk::Format::eB8G8R8A8Srgb;
+	bool rgba = data.Format() == vk::Format::eR8G8B8A8Unorm || data.Format() == vk::Format::eR8G8B8A8Srgb;
+	if ((bgra || rgba) && extent.depth == 1 && data.LayerCount() == 1) {
+		std::ofstream file(_directory / (std::string(name) + ".ppm"), std::ios::binary);
+		if (!file) {
+			errf_color(ConsoleColor::Red, "Failed to open capture file for %s\n", name);
+			return;
+		}
+		file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+		std::vector<char> row(extent.width * 3);
+		for (uint32_t y = 0; y < extent.height; y++) {
+			const std::byte* src = bytes.data() + y * data.RowPitch();
+			for (uint32_t x = 0; x < extent.width; x++) {
+				row[x * 3 + 0] = (char)src[x * 4 + (bgra ? 2 : 0)];
+				row[x * 3 + 1] = (char)src[x * 4 + 1];
+				row[x * 3 + 2] = (char)src[x * 4 + (bgra ? 0 : 2)];
+			}
+			file.write(row.data(), row.size());
+		}
+	}
+	else {
+		std::string rawName = std::string(name) + "_" + std::to_string(extent.width) + "x" + std::to_string(extent.height) + "x" + std::to_string(extent.depth * data.LayerCount()) + "_" + vk::to_string(data.Format()) + ".bin";
+		std::ofstream file(_directory / rawName, std::ios::binary);
+		if (!file) {
+			errf_color(ConsoleColor::Red, "Failed to open capture file for %s\n", name);
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+	++_framesWritten;
+}
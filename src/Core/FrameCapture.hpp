@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Readback.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+
+namespace vrg {
+
+	// Streams rendered frames to disk. Frames are read back through a ReadbackRing and written
+	// on a separate thread, so the render loop only records a copy per frame and never waits on the disk.
+	// 8 bit RGBA/BGRA frames are written as binary PPM, anything else as a raw dump with the extent and format in the name.
+	class FrameCapture {
+	public:
+		FrameCapture(Device& device, const std::filesystem::path& directory, size_t maxQueuedFrames = 8);
+		~FrameCapture();
+
+		// Records the copy of this frame's image into the command buffer
+		void Capture(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view);
+		// Hands finished readbacks to the writer thread, call once per frame
+		void Poll();
+		// Blocks until every captured frame is on disk
+		void Finish();
+
+		inline size_t FramesWritten() const { return _framesWritten; }
+		inline size_t FramesDropped() const { return _framesDropped; }
+
+	private:
+		struct Frame {
+			size_t index;
+			std::shared_ptr<const ReadbackData> data;
+		};
+
+		void WriterThread();
+		void WriteFrame(const Frame& frame);
+
+		ReadbackRing _readback;
+		std::filesystem::path _directory;
+		size_t _maxQueuedFrames;
+		size_t _frameIndex = 0;
+
+		std::thread _writer;
+		std::mutex _mutex;
+		std::condition_variable _queueCondition;
+		std::condition_variable _idleCondition;
+		std::deque<Frame> _queue;
+		bool _writing = false;
+		bool _stop = false;
+
+		std::atomic<size_t> _framesWritten = 0;
+		std::atomic<size_t> _framesDropped = 0;
+	};
+
+}
@@ -28,6 +28,26 @@ namespace vrg {
 		inline Attribute& at(const VertexAttributeId& id) { return attributes.at(id); }
 		inline Attribute& at(const VertexAttributeType& type, uint32_t index = 0) { return attributes.at(VertexAttributeId(type, index)); }
 
+		// Normals in a two component format and tangents in eR8G8B8A8Snorm hold octahedral encoded directions, tangents keep
+		// their handedness in w. Every other normalized or half format is expanded to float by the vertex fetch
+		static inline bool Octahedral(VertexAttributeType type, vk::Format format) {
+			if (type == VertexAttributeType::Normal) return format == vk::Format::eR16G16Snorm || format == vk::Format::eR8G8Snorm;
+			if (type == VertexAttributeType::Tangent) return format == vk::Format::eR8G8B8A8Snorm;
+			return false;
+		}
+
+		// Defines that select the matching decode functions of Shaders/VertexDecode.h, add them to the vertex shader's
+		// ShaderCompileOptions. Positions are dequantized by the mesh's PositionTransform instead
+		inline std::vector<std::pair<std::string, std::string>> DecodeDefines() const {
+			std::vector<std::pair<std::string, std::string>> defines;
+			for (const auto& [id, attribute] : attributes) {
+				if (id.typeIndex != 0 || !Octahedral(id.type, attribute.format)) continue;
+				defines.emplace_back(id.type == VertexAttributeType::Normal ? "VRG_NORMAL_OCTAHEDRAL" : "VRG_TANGENT_OCTAHEDRAL", "1");
+			}
+			std::ranges::sort(defines);
+			return defines;
+		}
+
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,605 @@
+#include "GltfLoader.hpp"
+#include "Json.hpp"
+
+#include <filesystem>
+#include <numeric>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VRG_SSE2
+#endif
+
+using namespace vrg;
+
+namespace gltf {
+	constexpr uint32_t GlbMagic = 0x46546C67; //"glTF"
+	constexpr uint32_t JsonChunk = 0x4E4F534A;
+	constexpr uint32_t BinaryChunk = 0x004E4942;
+
+	constexpr uint32_t Byte = 5120;
+	constexpr uint32_t UnsignedByte = 5121;
+	constexpr uint32_t Short = 5122;
+	constexpr uint32_t UnsignedShort = 5123;
+	constexpr uint32_t UnsignedInt = 5125;
+	constexpr uint32_t Float = 5126;
+
+	inline uint32_t ComponentSize(uint32_t componentType) {
+		switch (componentType) {
+		case Byte: case UnsignedByte: return 1;
+		case Short: case UnsignedShort: return 2;
+		case UnsignedInt: case Float: return 4;
+		default: throw std::runtime_error("Invalid glTF component type " + std::to_string(componentType));
+		}
+	}
+
+	inline uint32_t ComponentCount(const std::string& type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4" || type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		throw std::runtime_error("Invalid glTF accessor type " + type);
+	}
+
+	// Conversions follow the glTF spec, signed normalized values clamp to -1
+	inline float ToFloat(const std::byte* src, uint32_t componentType, bool normalized) {
+		switch (componentType) {
+		case Byte: { int8_t v; memcpy(&v, src, sizeof(v)); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+		case UnsignedByte: { uint8_t v; memcpy(&v, src, sizeof(v)); return normalized ? v / 255.0f : v; }
+		case Short: { int16_t v; memcpy(&v, src, sizeof(v)); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+		case UnsignedShort: { uint16_t v; memcpy(&v, src, sizeof(v)); return normalized ? v / 65535.0f : v; }
+		case UnsignedInt: { uint32_t v; memcpy(&v, src, sizeof(v)); return (float)v; }
+		default: { float v; memcpy(&v, src, sizeof(v)); return v; }
+		}
+	}
+
+	// Accessor min and max hold the stored values, normalized accessors convert them like their data
+	inline float ToFloat(double value, uint32_t componentType, bool normalized) {
+		if (!normalized) return (float)value;
+		switch (componentType) {
+		case Byte: return std::max((float)value / 127.0f, -1.0f);
+		case UnsignedByte: return (float)value / 255.0f;
+		case Short: return std::max((float)value / 32767.0f, -1.0f);
+		case UnsignedShort: return (float)value / 65535.0f;
+		default: return (float)value;
+		}
+	}
+
+	inline uint32_t ToIndex(const std::byte* src, uint32_t componentType) {
+		switch (componentType) {
+		case UnsignedByte: return (uint8_t)*src;
+		case UnsignedShort: { uint16_t v; memcpy(&v, src, sizeof(v)); return v; }
+		default: { uint32_t v; memcpy(&v, src, sizeof(v)); return v; }
+		}
+	}
+
+	//the packed conversions below handle the bulk of quantized data four to sixteen values at a time
+	inline void ConvertU8(const uint8_t* src, float* dst, size_t count, float scale) {
+		size_t i = 0;
+#ifdef VRG_SSE2
+		const __m128 s = _mm_set1_ps(scale);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= count; i += 16) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), s));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), s));
+			_mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), s));
+			_mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), s));
+		}
+#endif
+		for (; i < count; i++) dst[i] = src[i] * scale;
+	}
+
+	inline void ConvertU16(const uint16_t* src, float* dst, size_t count, float scale) {
+		size_t i = 0;
+#ifdef VRG_SSE2
+		const __m128 s = _mm_set1_ps(scale);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= count; i += 8) {
+			__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), s));
+			_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), s));
+		}
+#endif
+		for (; i < count; i++) dst[i] = src[i] * scale;
+	}
+
+	inline void ConvertS8(const int8_t* src, float* dst, size_t count, float scale, float minimum) {
+		size_t i = 0;
+#ifdef VRG_SSE2
+		const __m128 s = _mm_set1_ps(scale);
+		const __m128 m = _mm_set1_ps(minimum);
+		for (; i + 8 <= count; i += 8) {
+			__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+			//sign extend by placing each value in the high half and shifting it back down
+			__m128i words = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+			_mm_storeu_ps(dst + i, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), s), m));
+			_mm_storeu_ps(dst + i + 4, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), s), m));
+		}
+#endif
+		for (; i < count; i++) dst[i] = std::max(src[i] * scale, minimum);
+	}
+
+	inline void ConvertS16(const int16_t* src, float* dst, size_t count, float scale, float minimum) {
+		size_t i = 0;
+#ifdef VRG_SSE2
+		const __m128 s = _mm_set1_ps(scale);
+		const __m128 m = _mm_set1_ps(minimum);
+		for (; i + 8 <= count; i += 8) {
+			__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+			_mm_storeu_ps(dst + i, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), s), m));
+			_mm_storeu_ps(dst + i + 4, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), s), m));
+		}
+#endif
+		for (; i < count; i++) dst[i] = std::max(src[i] * scale, minimum);
+	}
+
+	inline void WidenU16(const uint16_t* src, uint32_t* dst, size_t count) {
+		size_t i = 0;
+#ifdef VRG_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= count; i += 8) {
+			__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(words, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(words, zero));
+		}
+#endif
+		for (; i < count; i++) dst[i] = src[i];
+	}
+
+	//values are already checked to fit
+	inline void NarrowIndices(const uint32_t* src, std::byte* dst, uint32_t stride, size_t count) {
+		if (stride == sizeof(uint16_t)) {
+			uint16_t* out = reinterpret_cast<uint16_t*>(dst);
+			for (size_t i = 0; i < count; i++) out[i] = (uint16_t)src[i];
+		}
+		else {
+			uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+			for (size_t i = 0; i < count; i++) out[i] = (uint8_t)src[i];
+		}
+	}
+
+	inline std::vector<std::byte> DecodeBase64(std::string_view text) {
+		auto value = [](char c) -> int {
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+' || c == '-') return 62;
+			if (c == '/' || c == '_') return 63;
+			return -1;
+		};
+		std::vector<std::byte> data;
+		data.reserve(text.size() / 4 * 3);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (char c : text) {
+			int v = value(c);
+			if (v < 0) {
+				if (c == '=') break;
+				throw std::runtime_error("Invalid base64 in glTF data uri");
+			}
+			bits = (bits << 6) | (uint32_t)v;
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				data.push_back(std::byte((bits >> bitCount) & 0xFF));
+			}
+		}
+		return data;
+	}
+
+	inline std::string DecodeUri(const std::string& uri) {
+		std::string path;
+		for (size_t i = 0; i < uri.size(); i++) {
+			if (uri[i] == '%' && i + 2 < uri.size()) {
+				path += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+				i += 2;
+			}
+			else {
+				path += uri[i];
+			}
+		}
+		return path;
+	}
+
+	inline size_t Align(size_t offset) {
+		//enough for any vertex format and index type
+		return (offset + 15) & ~size_t(15);
+	}
+}
+
+GltfLoader::GltfLoader(const std::string& path, bool uint8Indices) : _uint8Indices(uint8Indices) {
+	std::filesystem::path filePath(path);
+	_name = filePath.stem().string();
+	std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+	if (!file) throw std::runtime_error("Could not open " + path);
+	_files.push_back(file);
+
+	std::string_view json(reinterpret_cast<const char*>(file->Data()), file->Size());
+	std::span<const std::byte> binaryChunk;
+	uint32_t magic = 0;
+	if (file->Size() >= 12) memcpy(&magic, file->Data(), sizeof(magic));
+	if (magic == gltf::GlbMagic) {
+		//12 byte header, then chunks of length, type and data padded to 4 bytes. JSON first, then an optional binary chunk
+		uint32_t header[3];
+		memcpy(header, file->Data(), sizeof(header));
+		if (header[1] != 2) throw std::runtime_error(path + " is glb version " + std::to_string(header[1]) + ", only 2 is supported");
+		size_t length = std::min<size_t>(header[2], file->Size());
+		size_t offset = sizeof(header);
+		json = {};
+		while (offset + 8 <= length) {
+			uint32_t chunk[2];
+			memcpy(chunk, file->Data() + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > length - offset) throw std::runtime_error(path + " has a truncated chunk");
+			if (chunk[1] == gltf::JsonChunk && json.empty()) json = std::string_view(reinterpret_cast<const char*>(file->Data() + offset), chunk[0]);
+			else if (chunk[1] == gltf::BinaryChunk && binaryChunk.empty()) binaryChunk = file->Bytes().subspan(offset, chunk[0]);
+			offset += (chunk[0] + 3) & ~3u;
+		}
+		if (json.empty()) throw std::runtime_error(path + " has no JSON chunk");
+	}
+
+	JsonValue document;
+	try {
+		document = JsonValue::Parse(json);
+	}
+	catch (const std::exception& e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+	std::string version = document["asset"]["version"].String("");
+	if (!version.starts_with("2.")) throw std::runtime_error(path + " is glTF " + version + ", only 2.x is supported");
+	for (const JsonValue& extension : document["extensionsRequired"].Elements()) {
+		//quantized attributes are read like any other accessor, everything else changes what the data means
+		if (extension.String() != "KHR_mesh_quantization") {
+			throw std::runtime_error(path + " requires unsupported extension " + extension.String());
+		}
+	}
+
+	loadBuffers(document, filePath.parent_path(), binaryChunk);
+	const JsonValue& meshes = document["meshes"];
+	for (uint32_t i = 0; i < meshes.Size(); i++) {
+		planMesh(document, meshes[i], i);
+	}
+}
+
+void GltfLoader::loadBuffers(const JsonValue& document, const std::filesystem::path& directory, std::span<const std::byte> binaryChunk) {
+	const JsonValue& buffers = document["buffers"];
+	for (uint32_t i = 0; i < buffers.Size(); i++) {
+		const JsonValue& buffer = buffers[i];
+		size_t byteLength = buffer["byteLength"].Get<size_t>();
+		std::span<const std::byte> data;
+		if (!buffer.Contains("uri")) {
+			//only the first buffer of a glb can refer to the binary chunk
+			if (i != 0) throw std::runtime_error("glTF buffer " + std::to_string(i) + " has no uri");
+			data = binaryChunk;
+		}
+		else if (const std::string& uri = buffer["uri"].String(); uri.starts_with("data:")) {
+			size_t comma = uri.find(',');
+			if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) {
+				throw std::runtime_error("glTF buffer " + std::to_string(i) + " has an unsupported data uri");
+			}
+			data = _embedded.emplace_back(gltf::DecodeBase64(std::string_view(uri).substr(comma + 1)));
+		}
+		else {
+			std::string relative = gltf::DecodeUri(uri);
+			//uris are utf-8, a plain std::string path would use the local code page on windows
+			std::string bufferPath = (directory / std::u8string(relative.begin(), relative.end())).string();
+			std::shared_ptr<const MappedFile> file = MappedFile::Open(bufferPath);
+			if (!file) throw std::runtime_error("Could not open glTF buffer " + bufferPath);
+			_files.push_back(file);
+			data = file->Bytes();
+		}
+		if (data.size() < byteLength) throw std::runtime_error("glTF buffer " + std::to_string(i) + " is smaller than its byteLength");
+		_buffers.push_back(data.first(byteLength));
+	}
+}
+
+std::span<const std::byte> GltfLoader::bufferView(const JsonValue& document, const JsonValue& index, size_t byteOffset, size_t byteLength) const {
+	const JsonValue& view = document["bufferViews"][index.Get<size_t>()];
+	size_t buffer = view["buffer"].Get<size_t>(SIZE_MAX);
+	if (!view || buffer >= _buffers.size()) throw std::runtime_error("glTF buffer view " + std::to_string(index.Get<size_t>()) + " does not exist");
+	size_t viewOffset = view["byteOffset"].Get<size_t>();
+	size_t viewLength = view["byteLength"].Get<size_t>();
+	if (viewOffset > _buffers[buffer].size() || viewLength > _buffers[buffer].size() - viewOffset || byteOffset > viewLength || byteLength > viewLength - byteOffset) {
+		throw std::runtime_error("glTF buffer view " + std::to_string(index.Get<size_t>()) + " is out of bounds");
+	}
+	return _buffers[buffer].subspan(viewOffset + byteOffset, byteLength);
+}
+
+GltfLoader::Accessor GltfLoader::accessor(const JsonValue& document, const JsonValue& index) const {
+	const JsonValue& json = document["accessors"][index.Get<size_t>()];
+	if (!index.IsNumber() || !json) throw std::runtime_error("glTF accessor " + std::to_string(index.Get<int64_t>(-1)) + " does not exist");
+	Accessor accessor;
+	accessor.componentType = json["componentType"].Get<uint32_t>();
+	accessor.components = gltf::ComponentCount(json["type"].String(""));
+	accessor.normalized = json["normalized"].Bool();
+	accessor.count = json["count"].Get<uint32_t>();
+	size_t elementSize = (size_t)gltf::ComponentSize(accessor.componentType) * accessor.components;
+	accessor.stride = elementSize;
+
+	if (json.Contains("bufferView") && accessor.count) {
+		const JsonValue& view = document["bufferViews"][json["bufferView"].Get<size_t>()];
+		if (view.Contains("byteStride")) accessor.stride = view["byteStride"].Get<size_t>();
+		if (accessor.stride < elementSize) throw std::runtime_error("glTF accessor " + std::to_string(index.Get<size_t>()) + " has overlapping elements");
+		size_t byteLength = accessor.stride * (accessor.count - 1) + elementSize;
+		accessor.data = bufferView(document, json["bufferView"], json["byteOffset"].Get<size_t>(), byteLength).data();
+	}
+
+	if (const JsonValue& sparse = json["sparse"]) {
+		accessor.sparseCount = sparse["count"].Get<uint32_t>();
+		accessor.sparseIndexType = sparse["indices"]["componentType"].Get<uint32_t>();
+		accessor.sparseIndices = bufferView(document, sparse["indices"]["bufferView"], sparse["indices"]["byteOffset"].Get<size_t>(),
+			(size_t)accessor.sparseCount * gltf::ComponentSize(accessor.sparseIndexType)).data();
+		accessor.sparseValues = bufferView(document, sparse["values"]["bufferView"], sparse["values"]["byteOffset"].Get<size_t>(),
+			(size_t)accessor.sparseCount * elementSize).data();
+	}
+	return accessor;
+}
+
+void GltfLoader::DecodeFloats(const Accessor& accessor, uint32_t components, float* destination) {
+	size_t componentSize = gltf::ComponentSize(accessor.componentType);
+	auto element = [&](const std::byte* src, float* dst) {
+		uint32_t copied = std::min(components, accessor.components);
+		for (uint32_t c = 0; c < copied; c++) dst[c] = gltf::ToFloat(src + c * componentSize, accessor.componentType, accessor.normalized);
+		//rgb colors read as opaque rgba
+		for (uint32_t c = copied; c < components; c++) dst[c] = c == 3 ? 1.0f : 0.0f;
+	};
+
+	size_t values = (size_t)accessor.count * components;
+	if (!accessor.data) {
+		std::fill_n(destination, values, 0.0f);
+	}
+	else if (accessor.components == components && accessor.stride == componentSize * components) {
+		const void* src = accessor.data;
+		switch (accessor.componentType) {
+		case gltf::Float: memcpy(destination, src, values * sizeof(float)); break;
+		case gltf::UnsignedByte: gltf::ConvertU8((const uint8_t*)src, destination, values, accessor.normalized ? 1.0f / 255.0f : 1.0f); break;
+		case gltf::UnsignedShort: gltf::ConvertU16((const uint16_t*)src, destination, values, accessor.normalized ? 1.0f / 65535.0f : 1.0f); break;
+		case gltf::Byte: gltf::ConvertS8((const int8_t*)src, destination, values, accessor.normalized ? 1.0f / 127.0f : 1.0f, accessor.normalized ? -1.0f : -std::numeric_limits<float>::max()); break;
+		case gltf::Short: gltf::ConvertS16((const int16_t*)src, destination, values, accessor.normalized ? 1.0f / 32767.0f : 1.0f, accessor.normalized ? -1.0f : -std::numeric_limits<float>::max()); break;
+		default:
+			for (uint32_t i = 0; i < accessor.count; i++) element(accessor.data + i * accessor.stride, destination + i * components);
+			break;
+		}
+	}
+	else {
+		//interleaved or padded, like the 4 byte stride of unsigned byte vec3s
+		for (uint32_t i = 0; i < accessor.count; i++) element(accessor.data + i * accessor.stride, destination + (size_t)i * components);
+	}
+
+	size_t elementSize = componentSize * accessor.components;
+	for (uint32_t i = 0; i < accessor.sparseCount; i++) {
+		uint32_t index = gltf::ToIndex(accessor.sparseIndices + i * gltf::ComponentSize(accessor.sparseIndexType), accessor.sparseIndexType);
+		if (index >= accessor.count) throw std::runtime_error("glTF sparse accessor index out of range");
+		element(accessor.sparseValues + i * elementSize, destination + (size_t)index * components);
+	}
+}
+
+void GltfLoader::DecodeIndices(const Accessor& accessor, uint32_t* destination) {
+	if (accessor.components != 1 || !accessor.data) throw std::runtime_error("glTF indices must be scalars in a buffer view");
+	size_t componentSize = gltf::ComponentSize(accessor.componentType);
+	bool packed = accessor.stride == componentSize;
+	if (packed && accessor.componentType == gltf::UnsignedInt) {
+		memcpy(destination, accessor.data, accessor.count * sizeof(uint32_t));
+	}
+	else if (packed && accessor.componentType == gltf::UnsignedShort) {
+		gltf::WidenU16(reinterpret_cast<const uint16_t*>(accessor.data), destination, accessor.count);
+	}
+	else {
+		for (uint32_t i = 0; i < accessor.count; i++) destination[i] = gltf::ToIndex(accessor.data + i * accessor.stride, accessor.componentType);
+	}
+}
+
+void GltfLoader::planMesh(const JsonValue& document, const JsonValue& mesh, uint32_t meshIndex) {
+	//strips, fans and loops are rewritten as lists so a mesh only needs one topology per class
+	enum class Conversion { None, TriangleStrip, TriangleFan, LineStrip, LineLoop };
+	struct Primitive {
+		Accessor position;
+		std::optional<Accessor> indices;
+		std::vector<std::pair<VertexAttributeId, Accessor>> attributes;
+		Conversion conversion = Conversion::None;
+		uint32_t indexCount = 0;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+	struct Group {
+		std::vector<Primitive> primitives;
+		//attribute -> float components
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> streams;
+		bool indexed = false;
+	};
+	std::map<vk::PrimitiveTopology, Group> groups;
+
+	std::string name = mesh["name"].String("mesh" + std::to_string(meshIndex));
+	for (const JsonValue& json : mesh["primitives"].Elements()) {
+		const JsonValue& attributes = json["attributes"];
+		if (!attributes.Contains("POSITION")) {
+			errf_color(ConsoleColor::Yellow, "Skipping primitive of glTF mesh %s without positions\n", name.c_str());
+			continue;
+		}
+
+		Primitive primitive;
+		vk::PrimitiveTopology topology;
+		switch (json["mode"].Get<uint32_t>(4)) {
+		case 0: topology = vk::PrimitiveTopology::ePointList; break;
+		case 1: topology = vk::PrimitiveTopology::eLineList; break;
+		case 2: topology = vk::PrimitiveTopology::eLineList; primitive.conversion = Conversion::LineLoop; break;
+		case 3: topology = vk::PrimitiveTopology::eLineList; primitive.conversion = Conversion::LineStrip; break;
+		case 4: topology = vk::PrimitiveTopology::eTriangleList; break;
+		case 5: topology = vk::PrimitiveTopology::eTriangleList; primitive.conversion = Conversion::TriangleStrip; break;
+		case 6: topology = vk::PrimitiveTopology::eTriangleList; primitive.conversion = Conversion::TriangleFan; break;
+		default: throw std::runtime_error("glTF mesh " + name + " has an invalid primitive mode");
+		}
+		Group& group = groups[topology];
+
+		primitive.position = accessor(document, attributes["POSITION"]);
+		//required for positions, so the bounds come without reading any vertices
+		const JsonValue& positions = document["accessors"][attributes["POSITION"].Get<size_t>()];
+		const JsonValue& minimum = positions["min"];
+		const JsonValue& maximum = positions["max"];
+		for (int c = 0; c < 3; c++) {
+			if (!minimum[c].IsNumber() || !maximum[c].IsNumber()) throw std::runtime_error("glTF mesh " + name + " has positions without min and max");
+			primitive.boundsMin[c] = gltf::ToFloat(minimum[c].Number(), primitive.position.componentType, primitive.position.normalized);
+			primitive.boundsMax[c] = gltf::ToFloat(maximum[c].Number(), primitive.position.componentType, primitive.position.normalized);
+		}
+		for (const auto& [semantic, index] : attributes.Members()) {
+			VertexAttributeId id;
+			uint32_t components;
+			if (semantic == "POSITION") { id = { VertexAttributeType::Position, 0 }; components = 3; }
+			else if (semantic == "NORMAL") { id = { VertexAttributeType::Normal, 0 }; components = 3; }
+			else if (semantic == "TANGENT") { id = { VertexAttributeType::Tangent, 0 }; components = 4; }
+			else if (semantic.starts_with("TEXCOORD_")) { id = { VertexAttributeType::TexCoord, (uint32_t)std::stoul(semantic.substr(9)) }; components = 2; }
+			else if (semantic.starts_with("COLOR_")) { id = { VertexAttributeType::Color, (uint32_t)std::stoul(semantic.substr(6)) }; components = 0; }
+			//joints, weights and application specific attributes have no VertexAttributeType
+			else continue;
+
+			Accessor data = accessor(document, index);
+			if (data.count != primitive.position.count) throw std::runtime_error("glTF mesh " + name + " has attributes of different lengths");
+			if (!components) components = data.components;
+			uint32_t& streamComponents = group.streams[{ (uint32_t)id.type, id.typeIndex }];
+			streamComponents = std::max(streamComponents, components);
+			primitive.attributes.emplace_back(id, data);
+		}
+
+		uint32_t sourceCount = primitive.position.count;
+		if (json.Contains("indices")) {
+			primitive.indices = accessor(document, json["indices"]);
+			sourceCount = primitive.indices->count;
+		}
+		switch (primitive.conversion) {
+		case Conversion::None: primitive.indexCount = sourceCount; break;
+		case Conversion::TriangleStrip:
+		case Conversion::TriangleFan: primitive.indexCount = sourceCount >= 3 ? 3 * (sourceCount - 2) : 0; break;
+		case Conversion::LineStrip: primitive.indexCount = sourceCount >= 2 ? 2 * (sourceCount - 1) : 0; break;
+		case Conversion::LineLoop: primitive.indexCount = sourceCount >= 2 ? 2 * sourceCount : 0; break;
+		}
+		group.indexed |= primitive.indices || primitive.conversion != Conversion::None;
+		group.primitives.push_back(std::move(primitive));
+	}
+
+	for (auto& [topology, group] : groups) {
+		Mesh::Layout& layout = _layouts.emplace_back();
+		layout.name = groups.size() > 1 ? name + " " + vk::to_string(topology) : name;
+		layout.topology = topology;
+		for (const Primitive& primitive : group.primitives) {
+			layout.boundsMin = layout.submeshes.empty() ? primitive.boundsMin : glm::min(layout.boundsMin, primitive.boundsMin);
+			layout.boundsMax = layout.submeshes.empty() ? primitive.boundsMax : glm::max(layout.boundsMax, primitive.boundsMax);
+			uint32_t count = group.indexed ? primitive.indexCount : primitive.position.count;
+			layout.submeshes.emplace_back(count / verts_per_prim(topology), layout.vertexCount, layout.indexCount);
+			layout.vertexCount += primitive.position.count;
+			if (group.indexed) layout.indexCount += primitive.indexCount;
+		}
+
+		for (const auto& [key, components] : group.streams) {
+			static constexpr vk::Format formats[] = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+			//one binding per attribute, the cook step interleaves them if asked to
+			Mesh::Layout::Binding& binding = layout.bindings.emplace_back();
+			binding.stride = components * sizeof(float);
+			binding.offset = gltf::Align(_dataSize);
+			_dataSize = binding.offset + (size_t)layout.vertexCount * binding.stride;
+			layout.attributes.push_back({ { (VertexAttributeType)key.first, key.second }, (uint32_t)layout.bindings.size() - 1, formats[components - 1], 0 });
+		}
+		if (group.indexed) {
+			//indices count from the primitive's first vertex, so the largest primitive decides
+			uint32_t maxVertices = 0;
+			for (const Primitive& primitive : group.primitives) maxVertices = std::max(maxVertices, primitive.position.count);
+			layout.indexStride = Mesh::IndexStride(maxVertices, _uint8Indices);
+			layout.indexOffset = gltf::Align(_dataSize);
+			_dataSize = layout.indexOffset + (size_t)layout.indexCount * layout.indexStride;
+		}
+
+		for (size_t p = 0; p < group.primitives.size(); p++) {
+			const Primitive& primitive = group.primitives[p];
+			const Mesh::Submesh& submesh = layout.submeshes[p];
+
+			for (const Mesh::Layout::Attribute& attribute : layout.attributes) {
+				const Mesh::Layout::Binding& binding = layout.bindings[attribute.binding];
+				auto it = std::ranges::find(primitive.attributes, attribute.id, &std::pair<VertexAttributeId, Accessor>::first);
+				uint32_t components = binding.stride / sizeof(float);
+				size_t offset = binding.offset + (size_t)submesh.firstVertex * binding.stride;
+				if (it == primitive.attributes.end()) {
+					//another primitive of the mesh has the attribute, colors default to white
+					float value = attribute.id.type == VertexAttributeType::Color ? 1.0f : 0.0f;
+					size_t count = (size_t)primitive.position.count * components;
+					_jobs.push_back([offset, count, value](std::byte* destination) {
+						std::fill_n(reinterpret_cast<float*>(destination + offset), count, value);
+					});
+				}
+				else {
+					_jobs.push_back([data = it->second, components, offset](std::byte* destination) {
+						DecodeFloats(data, components, reinterpret_cast<float*>(destination + offset));
+					});
+				}
+			}
+
+			if (!group.indexed) continue;
+			uint32_t stride = layout.indexStride;
+			size_t offset = layout.indexOffset + (size_t)submesh.firstIndex * stride;
+			_jobs.push_back([primitive, offset, stride, name](std::byte* destination) {
+				//narrower indices are decoded to 32 bit first and converted once they are checked
+				std::vector<uint32_t> wide(stride == sizeof(uint32_t) ? 0 : primitive.indexCount);
+				uint32_t* dst = stride == sizeof(uint32_t) ? reinterpret_cast<uint32_t*>(destination + offset) : wide.data();
+				if (primitive.conversion == Conversion::None) {
+					if (primitive.indices) DecodeIndices(*primitive.indices, dst);
+					else std::iota(dst, dst + primitive.indexCount, 0u);
+				}
+				else {
+					std::vector<uint32_t> source(primitive.indices ? primitive.indices->count : primitive.position.count);
+					if (primitive.indices) DecodeIndices(*primitive.indices, source.data());
+					else std::iota(source.begin(), source.end(), 0u);
+					uint32_t* out = dst;
+					switch (primitive.conversion) {
+					case Conversion::TriangleStrip:
+						//every other triangle swaps its first two vertices to keep the winding, like the rasterizer does
+						for (size_t i = 0; i + 2 < source.size(); i++) {
+							*out++ = source[i + (i & 1)];
+							*out++ = source[i + 1 - (i & 1)];
+							*out++ = source[i + 2];
+						}
+						break;
+					case Conversion::TriangleFan:
+						for (size_t i = 1; i + 1 < source.size(); i++) {
+							*out++ = source[i];
+							*out++ = source[i + 1];
+							*out++ = source[0];
+						}
+						break;
+					case Conversion::LineStrip:
+					case Conversion::LineLoop:
+						for (size_t i = 0; i + 1 < source.size(); i++) {
+							*out++ = source[i];
+							*out++ = source[i + 1];
+						}
+						if (primitive.conversion == Conversion::LineLoop && source.size() >= 2) {
+							*out++ = source.back();
+							*out++ = source.front();
+						}
+						break;
+					default: break;
+					}
+				}
+				//the gpu would read past the vertex streams
+				if (std::any_of(dst, dst + primitive.indexCount, [&](uint32_t index) { return index >= primitive.position.count; })) {
+					throw std::runtime_error("glTF mesh " + name + " has indices past its vertices");
+				}
+				if (stride != sizeof(uint32_t)) gltf::NarrowIndices(dst, destination + offset, stride, primitive.indexCount);
+			});
+		}
+	}
+}
+
+void GltfLoader::Decode(std::byte* destination, ThreadPool* pool) const {
+	if (pool) {
+		pool->ParallelFor(0, _jobs.size(), [&](size_t i) { _jobs[i](destination); });
+	}
+	else {
+		for (const auto& job : _jobs) job(destination);
+	}
+}
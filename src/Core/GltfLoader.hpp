@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+#include <filesystem>
+
+namespace vrg {
+
+	class JsonValue;
+
+	// Reads the meshes of glTF 2.0 files, both .gltf with external or base64 embedded buffers and binary .glb.
+	// Buffers are memory mapped and decoded straight into the staging memory, nothing is read into an intermediate copy.
+	// Every glTF mesh becomes one Mesh per primitive topology with one Submesh per primitive. Attributes are converted to
+	// 32 bit floats, indices to the narrowest type the largest primitive allows and strips, fans and loops to lists. Nodes, materials, skins and morph targets are not read
+	class GltfLoader {
+	public:
+		// Maps the file and its buffers and works out where every stream goes. Throws std::runtime_error if the file
+		// is not valid glTF 2.0 or references data that doesn't exist. uint8Indices allows 1 byte indices for meshes whose
+		// primitives have at most 256 vertices, only pass it for devices with Device::IndexTypeUint8
+		GltfLoader(const std::string& path, bool uint8Indices = false);
+
+		GltfLoader(const GltfLoader&) = delete;
+		GltfLoader& operator=(const GltfLoader&) = delete;
+
+		inline const std::vector<Mesh::Layout>& Layouts() const { return _layouts; }
+		// bytes Decode writes, vertex and index streams of all meshes together
+		inline size_t DataSize() const { return _dataSize; }
+
+		// Writes every stream to destination, which has to hold DataSize bytes. Primitives are decoded in parallel when a pool is given
+		void Decode(std::byte* destination, ThreadPool* pool = nullptr) const;
+
+		// Decodes into one staging buffer and records a single copy into one device local buffer shared by all meshes
+		inline std::vector<std::shared_ptr<Mesh>> Upload(CommandBuffer& commandBuffer, ThreadPool* pool = nullptr) const {
+			return Mesh::Upload(commandBuffer, _name, _layouts, _dataSize, [&](std::byte* destination) { Decode(destination, pool); });
+		}
+
+		static inline std::vector<std::shared_ptr<Mesh>> Load(CommandBuffer& commandBuffer, const std::string& path, ThreadPool* pool = nullptr) {
+			return GltfLoader(path, commandBuffer._device.IndexTypeUint8()).Upload(commandBuffer, pool);
+		}
+
+	private:
+		struct Accessor {
+			//null for accessors without a buffer view, they read as zeros
+			const std::byte* data = nullptr;
+			size_t stride = 0;
+			uint32_t componentType = 0;
+			uint32_t components = 0;
+			bool normalized = false;
+			uint32_t count = 0;
+
+			//sparse accessors replace the elements at sparseIndices with sparseValues after the dense data is read
+			uint32_t sparseCount = 0;
+			const std::byte* sparseIndices = nullptr;
+			uint32_t sparseIndexType = 0;
+			const std::byte* sparseValues = nullptr;
+		};
+
+		std::string _name;
+		std::vector<std::shared_ptr<const MappedFile>> _files;
+		std::vector<std::vector<std::byte>> _embedded;
+		std::vector<std::span<const std::byte>> _buffers;
+
+		bool _uint8Indices = false;
+		std::vector<Mesh::Layout> _layouts;
+		size_t _dataSize = 0;
+		//each writes a separate range of the destination, so they can run in any order
+		std::vector<std::function<void(std::byte*)>> _jobs;
+
+		void loadBuffers(const JsonValue& document, const std::filesystem::path& directory, std::span<const std::byte> binaryChunk);
+		std::span<const std::byte> bufferView(const JsonValue& document, const JsonValue& index, size_t byteOffset, size_t byteLength) const;
+		Accessor accessor(const JsonValue& document, const JsonValue& index) const;
+		void planMesh(const JsonValue& document, const JsonValue& mesh, uint32_t meshIndex);
+
+		static void DecodeFloats(const Accessor& accessor, uint32_t components, float* destination);
+		static void DecodeIndices(const Accessor& accessor, uint32_t* destination);
+	};
+
+}
@@ -136,7 +136,8 @@ Instance::Instance(std::vector<std::string> extensions, std::vector<std::string>
 
 	std::vector<std::string> deviceExtensions{
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-		VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME
+		VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME,
+		VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME
 	};
 	_device = std::make_unique<vrg::Device>(*this, 0, deviceExtensions, validationLayers);
 
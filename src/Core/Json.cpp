@@ -0,0 +1,179 @@
+#include "Json.hpp"
+
+#include <charconv>
+
+using namespace vrg;
+
+namespace vrg {
+
+	class JsonParser {
+	public:
+		std::string_view text;
+		size_t offset = 0;
+		uint32_t depth = 0;
+
+		[[noreturn]] inline void Fail(const char* message) const {
+			throw std::runtime_error("JSON " + std::string(message) + " at offset " + std::to_string(offset));
+		}
+
+		inline void SkipWhitespace() {
+			while (offset < text.size() && (text[offset] == ' ' || text[offset] == '\n' || text[offset] == '\r' || text[offset] == '\t')) offset++;
+		}
+
+		inline char Peek() {
+			SkipWhitespace();
+			if (offset >= text.size()) Fail("ends unexpectedly");
+			return text[offset];
+		}
+
+		inline void Expect(std::string_view token) {
+			if (text.substr(offset, token.size()) != token) Fail("has an unexpected token");
+			offset += token.size();
+		}
+
+		inline uint32_t ReadHex() {
+			if (offset + 4 > text.size()) Fail("has a truncated escape");
+			uint32_t value = 0;
+			auto [end, error] = std::from_chars(text.data() + offset, text.data() + offset + 4, value, 16);
+			if (error != std::errc() || end != text.data() + offset + 4) Fail("has an invalid escape");
+			offset += 4;
+			return value;
+		}
+
+		inline void AppendUtf8(std::string& out, uint32_t codepoint) {
+			if (codepoint < 0x80) {
+				out += (char)codepoint;
+			}
+			else if (codepoint < 0x800) {
+				out += (char)(0xC0 | (codepoint >> 6));
+				out += (char)(0x80 | (codepoint & 0x3F));
+			}
+			else if (codepoint < 0x10000) {
+				out += (char)(0xE0 | (codepoint >> 12));
+				out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+				out += (char)(0x80 | (codepoint & 0x3F));
+			}
+			else {
+				out += (char)(0xF0 | (codepoint >> 18));
+				out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+				out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+				out += (char)(0x80 | (codepoint & 0x3F));
+			}
+		}
+
+		inline std::string ParseString() {
+			offset++; //opening quote
+			std::string out;
+			while (true) {
+				//copy runs without escapes in one go, most strings have none
+				size_t end = text.find_first_of("\"\\", offset);
+				if (end == std::string_view::npos) Fail("has an unterminated string");
+				out.append(text.data() + offset, end - offset);
+				offset = end + 1;
+				if (text[end] == '"') return out;
+
+				if (offset >= text.size()) Fail("has an unterminated string");
+				char escape = text[offset++];
+				switch (escape) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t codepoint = ReadHex();
+					if (codepoint >= 0xD800 && codepoint < 0xDC00) {
+						Expect("\\u");
+						uint32_t low = ReadHex();
+						if (low < 0xDC00 || low >= 0xE000) Fail("has an invalid surrogate pair");
+						codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(out, codepoint);
+					break;
+				}
+				default: Fail("has an invalid escape");
+				}
+			}
+		}
+
+		inline double ParseNumber() {
+			double value = 0;
+			const char* begin = text.data() + offset;
+			auto [end, error] = std::from_chars(begin, text.data() + text.size(), value);
+			if (error != std::errc() || end == begin) Fail("has an invalid number");
+			offset += end - begin;
+			return value;
+		}
+
+		inline JsonValue ParseValue() {
+			//malicious files could nest deep enough to overflow the stack
+			if (++depth > 512) Fail("nests too deep");
+			JsonValue value;
+			char c = Peek();
+			if (c == '{') {
+				value._type = JsonValue::Type::Object;
+				offset++;
+				if (Peek() == '}') offset++;
+				else while (true) {
+					if (Peek() != '"') Fail("expects a member name");
+					std::string name = ParseString();
+					if (Peek() != ':') Fail("expects ':'");
+					offset++;
+					value._members.emplace_back(std::move(name), ParseValue());
+					c = Peek();
+					offset++;
+					if (c == '}') break;
+					if (c != ',') Fail("expects ',' or '}'");
+				}
+			}
+			else if (c == '[') {
+				value._type = JsonValue::Type::Array;
+				offset++;
+				if (Peek() == ']') offset++;
+				else while (true) {
+					value._elements.push_back(ParseValue());
+					c = Peek();
+					offset++;
+					if (c == ']') break;
+					if (c != ',') Fail("expects ',' or ']'");
+				}
+			}
+			else if (c == '"') {
+				value._type = JsonValue::Type::String;
+				value._string = ParseString();
+			}
+			else if (c == 't') {
+				Expect("true");
+				value._type = JsonValue::Type::Bool;
+				value._number = 1;
+			}
+			else if (c == 'f') {
+				Expect("false");
+				value._type = JsonValue::Type::Bool;
+			}
+			else if (c == 'n') {
+				Expect("null");
+			}
+			else {
+				value._type = JsonValue::Type::Number;
+				value._number = ParseNumber();
+			}
+			depth--;
+			return value;
+		}
+	};
+
+}
+
+JsonValue JsonValue::Parse(std::string_view text) {
+	JsonParser parser{ text };
+	//skip a utf-8 byte order mark
+	if (text.starts_with("\xEF\xBB\xBF")) parser.offset = 3;
+	JsonValue root = parser.ParseValue();
+	parser.SkipWhitespace();
+	if (parser.offset != text.size()) parser.Fail("has trailing characters");
+	return root;
+}
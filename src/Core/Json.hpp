@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Util.hpp"
+
+namespace vrg {
+
+	// Read only JSON document. Parse reads the text in a single pass without copying it first, so it can run straight on a
+	// mapped file. Lookups of missing members or out of range elements return a null value instead of throwing, which keeps
+	// reading optional fields short
+	class JsonValue {
+	public:
+		enum class Type {
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		// Throws std::runtime_error with the offset of the first syntax error
+		static JsonValue Parse(std::string_view text);
+
+		JsonValue() = default;
+
+		inline Type GetType() const { return _type; }
+		inline bool IsNull() const { return _type == Type::Null; }
+		inline bool IsBool() const { return _type == Type::Bool; }
+		inline bool IsNumber() const { return _type == Type::Number; }
+		inline bool IsString() const { return _type == Type::String; }
+		inline bool IsArray() const { return _type == Type::Array; }
+		inline bool IsObject() const { return _type == Type::Object; }
+		inline operator bool() const { return !IsNull(); }
+
+		inline bool Bool(bool fallback = false) const { return IsBool() ? _number != 0 : fallback; }
+		inline double Number(double fallback = 0) const { return IsNumber() ? _number : fallback; }
+		template<typename T> requires std::is_arithmetic_v<T>
+		inline T Get(T fallback = {}) const { return IsNumber() ? (T)_number : fallback; }
+		inline const std::string& String() const { return _string; }
+		inline std::string String(const std::string& fallback) const { return IsString() ? _string : fallback; }
+
+		// element count of arrays and member count of objects
+		inline size_t Size() const { return IsArray() ? _elements.size() : IsObject() ? _members.size() : 0; }
+		inline const std::vector<JsonValue>& Elements() const { return _elements; }
+		inline const std::vector<std::pair<std::string, JsonValue>>& Members() const { return _members; }
+
+		inline const JsonValue& operator[](size_t index) const { return index < _elements.size() ? _elements[index] : Null(); }
+		inline const JsonValue& operator[](std::string_view name) const {
+			//glTF objects have a handful of members, a linear search beats hashing them
+			for (const auto& [key, value] : _members) {
+				if (key == name) return value;
+			}
+			return Null();
+		}
+		inline const JsonValue& operator[](const char* name) const { return (*this)[std::string_view(name)]; }
+		inline bool Contains(std::string_view name) const { return !(*this)[name].IsNull(); }
+
+	private:
+		friend class JsonParser;
+
+		Type _type = Type::Null;
+		double _number = 0;
+		std::string _string;
+		std::vector<JsonValue> _elements;
+		std::vector<std::pair<std::string, JsonValue>> _members;
+
+		static inline const JsonValue& Null() {
+			static const JsonValue null;
+			return null;
+		}
+	};
+
+}
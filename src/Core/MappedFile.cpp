@@ -0,0 +1,59 @@
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace vrg;
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path) {
+	std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+	file->_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file->_file == INVALID_HANDLE_VALUE) return nullptr;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file->_file, &size)) return nullptr;
+	if (size.QuadPart == 0) return file;
+
+	file->_mapping = CreateFileMappingA(file->_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!file->_mapping) return nullptr;
+	file->_data = static_cast<const std::byte*>(MapViewOfFile(file->_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!file->_data) return nullptr;
+	file->_size = (size_t)size.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return nullptr;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		close(fd);
+		return nullptr;
+	}
+	if (info.st_size > 0) {
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			return nullptr;
+		}
+		file->_data = static_cast<const std::byte*>(data);
+		file->_size = (size_t)info.st_size;
+	}
+	//the mapping keeps its own reference to the file
+	close(fd);
+#endif
+	return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapping) CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+	if (_data) munmap(const_cast<std::byte*>(_data), _size);
+#endif
+}
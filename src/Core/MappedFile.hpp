@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Util.hpp"
+
+namespace vrg {
+
+	// Read only memory mapping of a whole file. Meant for files nothing writes to while they are open, like shader bundles
+	class MappedFile {
+	public:
+		// nullptr if the file can't be opened or mapped
+		static std::shared_ptr<const MappedFile> Open(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		inline const std::byte* Data() const { return _data; }
+		inline size_t Size() const { return _size; }
+		inline std::span<const std::byte> Bytes() const { return { _data, _size }; }
+
+	private:
+		MappedFile() = default;
+
+		//stays null for empty files, nothing gets mapped
+		const std::byte* _data = nullptr;
+		size_t _size = 0;
+#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+#endif
+	};
+
+}
@@ -1,5 +1,7 @@
 #include "Mesh.hpp"
 
+#include <glm/gtc/packing.hpp>
+
 using namespace vrg;
 
 std::shared_ptr<Mesh> Mesh::Cube(CommandBuffer& commandBuffer) {
@@ -15,7 +17,7 @@ std::shared_ptr<Mesh> Mesh::Cube(CommandBuffer& commandBuffer) {
 		{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
 		{1.0f, 0.0f, 1.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}
 	};
-	const std::vector<uint32_t> inds = {
+	const std::vector<uint16_t> inds = {
 		0, 1, 2,
 		1, 3, 2,
 		5, 4, 6,
@@ -31,28 +33,91 @@ std::shared_ptr<Mesh> Mesh::Cube(CommandBuffer& commandBuffer) {
 	};
 
 
-	BufferVector<glm::vec3> vertices(device, verts.size());
-	BufferVector<glm::vec3> colors(device, cols.size());
-	BufferVector<uint32_t> indices(device, inds.size());
+	//corners and colors are exact as half and unorm8, the vertex fetch expands both to the float3 the shaders read
+	BufferVector<uint64_t> vertices(device, verts.size());
+	BufferVector<uint32_t> colors(device, cols.size());
+	BufferVector<uint16_t> indices(device, inds.size());
 
 
 	//vertices.Resize(3);
 	//colors.Resize(3);
 	//indices.Resize(3);
 
-	memcpy(vertices.Data(), verts.data(), verts.size() * sizeof(glm::vec3));
-	memcpy(colors.Data(), cols.data(), cols.size() * sizeof(glm::vec3));
-	memcpy(indices.Data(), inds.data(), inds.size() * sizeof(uint32_t));
+	for (size_t i = 0; i < verts.size(); i++) vertices.Data()[i] = glm::packHalf4x16(glm::vec4(verts[i], 0.0f));
+	for (size_t i = 0; i < cols.size(); i++) colors.Data()[i] = glm::packUnorm4x8(glm::vec4(cols[i], 1.0f));
+	memcpy(indices.Data(), inds.data(), inds.size() * sizeof(uint16_t));
 
-	m->_indices = commandBuffer.CopyBuffer<uint32_t>(indices, vk::BufferUsageFlagBits::eIndexBuffer);
+	m->_indices = commandBuffer.CopyBuffer<uint16_t>(indices, vk::BufferUsageFlagBits::eIndexBuffer);
 
 	//m->_geometry.bindings.resize(2);
-	m->_geometry.bindings[VertexAttributeType::Position].first = commandBuffer.CopyBuffer<glm::vec3>(vertices, vk::BufferUsageFlagBits::eVertexBuffer);
-	m->_geometry.bindings[VertexAttributeType::Color].first = commandBuffer.CopyBuffer<glm::vec3>(colors, vk::BufferUsageFlagBits::eVertexBuffer);
+	m->_geometry.bindings[VertexAttributeType::Position].first = commandBuffer.CopyBuffer<uint64_t>(vertices, vk::BufferUsageFlagBits::eVertexBuffer);
+	m->_geometry.bindings[VertexAttributeType::Color].first = commandBuffer.CopyBuffer<uint32_t>(colors, vk::BufferUsageFlagBits::eVertexBuffer);
 
-	m->_geometry[VertexAttributeType::Position][0] = Geometry::Attribute(VertexAttributeType::Position, vk::Format::eR32G32B32Sfloat, 0);
-	m->_geometry[VertexAttributeType::Color][0] = Geometry::Attribute(VertexAttributeType::Color, vk::Format::eR32G32B32Sfloat, 0);
+	m->_geometry[VertexAttributeType::Position][0] = Geometry::Attribute(VertexAttributeType::Position, vk::Format::eR16G16B16A16Sfloat, 0);
+	m->_geometry[VertexAttributeType::Color][0] = Geometry::Attribute(VertexAttributeType::Color, vk::Format::eR8G8B8A8Unorm, 0);
 
 	m->_submeshes.emplace_back(inds.size() / 3, 0, 0);
+	m->_boundsMin = glm::vec3(-0.5f);
+	m->_boundsMax = glm::vec3(0.5f);
 	return m;
-}
\ No newline at end of file
+}
+
+std::vector<std::shared_ptr<Mesh>> Mesh::Create(const std::vector<Layout>& layouts, const std::shared_ptr<Buffer>& buffer) {
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	meshes.reserve(layouts.size());
+	for (const Layout& layout : layouts) {
+		auto m = std::make_shared<Mesh>(layout.name, vrg::Geometry{ layout.topology });
+		//meshes without any vertices have nothing in the buffer
+		for (uint32_t i = 0; buffer && i < layout.bindings.size(); i++) {
+			const Layout::Binding& binding = layout.bindings[i];
+			m->_geometry.bindings[i] = { Buffer::StrideView(buffer, binding.stride, binding.offset, layout.vertexCount), vk::VertexInputRate::eVertex };
+		}
+		for (const Layout::Attribute& attribute : layout.attributes) {
+			m->_geometry[attribute.id] = Geometry::Attribute(attribute.binding, attribute.format, attribute.offset);
+		}
+		if (buffer && layout.indexStride) {
+			m->_indices = Buffer::StrideView(buffer, layout.indexStride, layout.indexOffset, layout.indexCount);
+		}
+		m->_submeshes = layout.submeshes;
+		m->_boundsMin = layout.boundsMin;
+		m->_boundsMax = layout.boundsMax;
+		m->_positionScale = layout.positionScale;
+		m->_positionOffset = layout.positionOffset;
+		meshes.push_back(m);
+	}
+	return meshes;
+}
+
+std::vector<std::shared_ptr<Mesh>> Mesh::Upload(CommandBuffer& commandBuffer, const std::string& name, const std::vector<Layout>& layouts,
+	vk::DeviceSize dataSize, const std::function<void(std::byte*)>& fill) {
+	if (dataSize == 0) return Create(layouts, nullptr);
+	Device& device = commandBuffer._device;
+	if (!device.IndexTypeUint8() && std::ranges::any_of(layouts, [](const Layout& layout) { return layout.indexStride == sizeof(uint8_t); })) {
+		throw std::runtime_error("Meshes of " + name + " have 1 byte indices, the device doesn't support VK_EXT_index_type_uint8");
+	}
+
+	vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eVertexBuffer;
+	if (std::ranges::any_of(layouts, [](const Layout& layout) { return layout.indexStride != 0; })) usage |= vk::BufferUsageFlagBits::eIndexBuffer;
+
+	if (device.UnifiedMemory()) {
+		//the gpu reads host visible memory at full speed, a staging copy would only cost time and memory
+		auto buffer = std::make_shared<Buffer>(device, name, dataSize, usage, VMA_MEMORY_USAGE_CPU_TO_GPU, vk::SharingMode::eExclusive,
+			vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		if (buffer->Data()) {
+			fill(buffer->Data());
+			return Create(layouts, buffer);
+		}
+	}
+
+	//host memory rather than the small device local and host visible heap, a scene can be hundreds of megabytes
+	auto staging = std::make_shared<Buffer>(device, name + " staging", dataSize, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY,
+		vk::SharingMode::eExclusive, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	fill(staging->Data());
+
+	auto buffer = std::make_shared<Buffer>(device, name, dataSize, usage | vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
+	commandBuffer.CopyBuffer(Buffer::View<std::byte>(staging), Buffer::View<std::byte>(buffer));
+	commandBuffer.Barrier(vk::MemoryBarrier2KHR(
+		vk::PipelineStageFlagBits2KHR::eAllTransfer, vk::AccessFlagBits2KHR::eTransferWrite,
+		vk::PipelineStageFlagBits2KHR::eVertexAttributeInput | vk::PipelineStageFlagBits2KHR::eIndexInput, vk::AccessFlagBits2KHR::eVertexAttributeRead | vk::AccessFlagBits2KHR::eIndexRead));
+	return Create(layouts, buffer);
+}
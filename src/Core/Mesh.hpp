@@ -13,14 +13,72 @@ namespace vrg {
 			uint32_t firstIndex;
 		};
 
+		// Where the vertex and index data of one mesh lives inside a buffer shared by many meshes. Loaders describe their meshes
+		// with these so a whole file is uploaded with one allocation and one copy
+		struct Layout {
+			// one vertex buffer binding, attributes are interleaved when several use it
+			struct Binding {
+				vk::DeviceSize offset;
+				uint32_t stride;
+			};
+			struct Attribute {
+				VertexAttributeId id;
+				uint32_t binding;
+				vk::Format format;
+				//from the start of the vertex
+				uint32_t offset;
+			};
+
+			std::string name;
+			vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
+			//0 for meshes without indices
+			uint32_t indexStride = 0;
+			vk::DeviceSize indexOffset = 0;
+			std::vector<Binding> bindings;
+			std::vector<Attribute> attributes;
+			std::vector<Submesh> submeshes;
+			//object space box around every position
+			glm::vec3 boundsMin = glm::vec3(0);
+			glm::vec3 boundsMax = glm::vec3(0);
+			//positions in a normalized format are stored as (position - positionOffset) / positionScale
+			float positionScale = 1.0f;
+			glm::vec3 positionOffset = glm::vec3(0);
+		};
+
+		// Narrowest index stride for submeshes whose indices reach at most vertexCount vertices past their firstVertex.
+		// 1 byte indices need Device::IndexTypeUint8
+		static inline uint32_t IndexStride(uint64_t vertexCount, bool uint8) {
+			if (uint8 && vertexCount <= 0x100) return sizeof(uint8_t);
+			return vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+		}
+
 		static std::shared_ptr<Mesh> Cube(CommandBuffer& commandBuffer);
 
+		// Creates the meshes described by layouts in buffer
+		static std::vector<std::shared_ptr<Mesh>> Create(const std::vector<Layout>& layouts, const std::shared_ptr<Buffer>& buffer);
+		// Allocates one staging buffer of dataSize bytes, lets fill write every mesh into it and records one copy into a single
+		// device local buffer, followed by a barrier for vertex and index reads. On unified memory fill writes straight into
+		// the buffer the meshes use and nothing is recorded
+		static std::vector<std::shared_ptr<Mesh>> Upload(CommandBuffer& commandBuffer, const std::string& name, const std::vector<Layout>& layouts,
+			vk::DeviceSize dataSize, const std::function<void(std::byte*)>& fill);
+
 		inline Mesh(const std::string& name, const Geometry& geometry = { vk::PrimitiveTopology::eTriangleList })
 			: _name(name), _geometry(geometry) {}
 
 		inline Buffer::StrideView& Indices() { return _indices; }
 		inline vrg::Geometry& Geometry() { return _geometry; }
 		inline std::vector<Submesh>& Submeshes() { return _submeshes; }
+		inline const glm::vec3& BoundsMin() const { return _boundsMin; }
+		inline const glm::vec3& BoundsMax() const { return _boundsMax; }
+		// Turns stored positions into object space, multiply it into the model matrix. Identity unless the positions are quantized,
+		// the scale is uniform so normals transformed with the same matrix only need renormalizing
+		inline glm::mat4 PositionTransform() const {
+			glm::mat4 transform(_positionScale);
+			transform[3] = glm::vec4(_positionOffset, 1.0f);
+			return transform;
+		}
 
 		inline uint32_t Index(uint32_t i, uint32_t baseIndex = 0, uint32_t baseVertex = 0) const {
 			if (_indices) {
@@ -45,6 +103,8 @@ namespace vrg {
 			auto pipeline = std::dynamic_pointer_cast<GraphicsPipeline>(commandBuffer.BoundPipeline());
 			if (!pipeline) throw std::runtime_error("Cannot draw a mesh without a graphics pipeline bound");
 
+			//no-op unless the pipeline takes topology or vertex input as dynamic state
+			commandBuffer.SetVertexInput(_geometry);
 			for (auto& [binding, buffer] : _geometry.bindings) {
 				commandBuffer.BindVertexBuffer(binding, buffer.first);
 			}
@@ -54,10 +114,10 @@ namespace vrg {
 
 			for (const Submesh& s : _submeshes) {
 				if (_indices) {
-					commandBuffer->drawIndexed(s.primitiveCount * verts_per_prim(_geometry.primitiveTopology), instanceCount, s.firstIndex, s.firstVertex, firstInstance);
+					commandBuffer.DrawIndexed(s.primitiveCount * verts_per_prim(_geometry.primitiveTopology), instanceCount, s.firstIndex, s.firstVertex, firstInstance);
 				}
 				else {
-					commandBuffer->draw(s.primitiveCount * verts_per_prim(_geometry.primitiveTopology), instanceCount, s.firstVertex, firstInstance);
+					commandBuffer.Draw(s.primitiveCount * verts_per_prim(_geometry.primitiveTopology), instanceCount, s.firstVertex, firstInstance);
 				}
 			}
 		}
@@ -67,5 +127,9 @@ namespace vrg {
 		vrg::Geometry _geometry;
 		Buffer::StrideView _indices;
 		std::vector<Submesh> _submeshes;
+		glm::vec3 _boundsMin = glm::vec3(0);
+		glm::vec3 _boundsMax = glm::vec3(0);
+		float _positionScale = 1.0f;
+		glm::vec3 _positionOffset = glm::vec3(0);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "MeshBundle.hpp"
+
+#include <filesystem>
+
+using namespace vrg;
+
+static constexpr uint32_t MeshBundleMagic = 0x4D475256; //"VRGM"
+
+//same scheme as shader bundles, fixed size records read in place and strings in a table of null terminated strings.
+//the vertex and index data of every mesh follows as one page aligned block, layout offsets are relative to its start
+struct MeshBundleHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t meshCount;
+	uint32_t stringTableSize;
+	uint64_t stringTableOffset;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+};
+
+//followed by its bindings, attributes and submeshes in that order
+struct PackedMesh {
+	uint32_t name;
+	uint32_t topology;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexStride;
+	uint32_t bindingCount;
+	uint32_t attributeCount;
+	uint32_t submeshCount;
+	uint64_t indexOffset;
+	uint64_t recordsOffset;
+	float boundsMin[3];
+	float boundsMax[3];
+	float positionOffset[3];
+	float positionScale;
+};
+
+struct PackedBinding {
+	uint64_t offset;
+	uint32_t stride;
+	uint32_t padding;
+};
+
+struct PackedAttribute {
+	uint32_t attributeType;
+	uint32_t attributeIndex;
+	uint32_t binding;
+	uint32_t format;
+	uint32_t offset;
+};
+
+struct PackedSubmesh {
+	uint32_t primitiveCount;
+	uint32_t firstVertex;
+	uint32_t firstIndex;
+};
+
+static constexpr size_t RecordAlignment = 8;
+
+class MeshBundleWriter {
+public:
+	std::vector<std::byte> data;
+	std::string strings;
+
+	inline uint32_t String(const std::string& s) {
+		uint32_t offset = (uint32_t)strings.size();
+		strings.append(s);
+		strings.push_back('\0');
+		return offset;
+	}
+
+	template<typename T>
+	inline size_t Append(const T* values, size_t count) {
+		size_t offset = data.size();
+		data.resize(offset + sizeof(T) * count);
+		if (count) memcpy(data.data() + offset, values, sizeof(T) * count);
+		return offset;
+	}
+	template<typename T>
+	inline size_t Append(const std::vector<T>& values) { return Append(values.data(), values.size()); }
+
+	inline void Align(size_t alignment) { data.resize((data.size() + alignment - 1) / alignment * alignment); }
+};
+
+class MeshBundleReader {
+public:
+	std::span<const std::byte> bytes;
+	std::string path;
+
+	template<typename T>
+	inline std::span<const T> Array(uint64_t offset, uint64_t count) const {
+		if (offset % alignof(T) || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T)) {
+			throw std::runtime_error("Mesh bundle " + path + " is corrupted");
+		}
+		return std::span<const T>(reinterpret_cast<const T*>(bytes.data() + offset), count);
+	}
+	template<typename T>
+	inline std::span<const T> Next(uint64_t& offset, uint64_t count) const {
+		std::span<const T> array = Array<T>(offset, count);
+		offset += array.size_bytes();
+		return array;
+	}
+};
+
+//the gpu reads whatever a layout points at, so both the writer and the reader check every range
+static void checkLayout(const Mesh::Layout& layout, size_t dataSize, const std::string& file) {
+	auto fail = [&](const char* what) { throw std::runtime_error("Mesh " + layout.name + " in " + file + " has " + what); };
+	auto fits = [&](uint64_t offset, uint64_t count, uint64_t stride) { return offset <= dataSize && (count == 0 || (dataSize - offset) / count >= stride); };
+
+	for (const Mesh::Layout::Binding& binding : layout.bindings) {
+		if (!binding.stride || !fits(binding.offset, layout.vertexCount, binding.stride)) fail("a vertex binding out of bounds");
+	}
+	for (const Mesh::Layout::Attribute& attribute : layout.attributes) {
+		if (attribute.binding >= layout.bindings.size()) fail("an attribute without a binding");
+		if (attribute.offset + texel_size(attribute.format) > layout.bindings[attribute.binding].stride) fail("an attribute outside its vertex");
+	}
+	if (layout.indexStride != 0 && layout.indexStride != 1 && layout.indexStride != 2 && layout.indexStride != 4) fail("an invalid index stride");
+	if (layout.indexStride && !fits(layout.indexOffset, layout.indexCount, layout.indexStride)) fail("indices out of bounds");
+	for (const Mesh::Submesh& submesh : layout.submeshes) {
+		uint64_t count = (uint64_t)submesh.primitiveCount * verts_per_prim(layout.topology);
+		if (layout.indexStride ? submesh.firstIndex + count > layout.indexCount : submesh.firstVertex + count > layout.vertexCount) fail("a submesh out of bounds");
+	}
+}
+
+void MeshBundle::Write(const std::string& path, const std::vector<Mesh::Layout>& layouts, std::span<const std::byte> data) {
+	MeshBundleWriter writer;
+
+	MeshBundleHeader header = {};
+	header.magic = MeshBundleMagic;
+	header.version = Version;
+	header.meshCount = (uint32_t)layouts.size();
+	writer.Append(&header, 1);
+
+	size_t meshesOffset = writer.data.size();
+	std::vector<PackedMesh> meshes(layouts.size());
+	writer.Append(meshes);
+
+	for (size_t i = 0; i < layouts.size(); i++) {
+		const Mesh::Layout& layout = layouts[i];
+		checkLayout(layout, data.size(), path);
+		PackedMesh& mesh = meshes[i];
+		mesh.name = writer.String(layout.name);
+		mesh.topology = (uint32_t)layout.topology;
+		mesh.vertexCount = layout.vertexCount;
+		mesh.indexCount = layout.indexCount;
+		mesh.indexStride = layout.indexStride;
+		mesh.bindingCount = (uint32_t)layout.bindings.size();
+		mesh.attributeCount = (uint32_t)layout.attributes.size();
+		mesh.submeshCount = (uint32_t)layout.submeshes.size();
+		mesh.indexOffset = layout.indexOffset;
+		for (int c = 0; c < 3; c++) {
+			mesh.boundsMin[c] = layout.boundsMin[c];
+			mesh.boundsMax[c] = layout.boundsMax[c];
+			mesh.positionOffset[c] = layout.positionOffset[c];
+		}
+		mesh.positionScale = layout.positionScale;
+
+		std::vector<PackedBinding> bindings;
+		for (const Mesh::Layout::Binding& binding : layout.bindings) {
+			bindings.push_back({ binding.offset, binding.stride, 0 });
+		}
+		std::vector<PackedAttribute> attributes;
+		for (const Mesh::Layout::Attribute& attribute : layout.attributes) {
+			attributes.push_back({ (uint32_t)attribute.id.type, attribute.id.typeIndex, attribute.binding, (uint32_t)attribute.format, attribute.offset });
+		}
+		std::vector<PackedSubmesh> submeshes;
+		for (const Mesh::Submesh& submesh : layout.submeshes) {
+			submeshes.push_back({ submesh.primitiveCount, submesh.firstVertex, submesh.firstIndex });
+		}
+
+		writer.Align(RecordAlignment);
+		mesh.recordsOffset = writer.data.size();
+		writer.Append(bindings);
+		writer.Append(attributes);
+		writer.Append(submeshes);
+	}
+	memcpy(writer.data.data() + meshesOffset, meshes.data(), meshes.size() * sizeof(PackedMesh));
+
+	writer.Align(RecordAlignment);
+	header.stringTableOffset = writer.data.size();
+	header.stringTableSize = (uint32_t)writer.strings.size();
+	writer.Append(writer.strings.data(), writer.strings.size());
+
+	writer.Align(DataAlignment);
+	header.dataOffset = writer.data.size();
+	header.dataSize = data.size();
+	memcpy(writer.data.data(), &header, sizeof(header));
+
+	//the data is written straight from the caller's memory, it can be hundreds of megabytes
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size()) ||
+			!file.write(reinterpret_cast<const char*>(data.data()), data.size())) {
+			throw std::runtime_error("Failed to write mesh bundle " + tmpPath);
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) {
+		throw std::runtime_error("Failed to write mesh bundle " + path + ": " + error.message());
+	}
+}
+
+MeshBundle::MeshBundle(const std::string& path) {
+	_name = std::filesystem::path(path).stem().string();
+	_file = MappedFile::Open(path);
+	if (!_file) {
+		throw std::runtime_error("Failed to open mesh bundle " + path);
+	}
+	MeshBundleReader reader{ _file->Bytes(), path };
+
+	const MeshBundleHeader& header = reader.Array<MeshBundleHeader>(0, 1)[0];
+	if (header.magic != MeshBundleMagic || header.version != Version) {
+		throw std::runtime_error("Mesh bundle " + path + " was built for a different version");
+	}
+	_data = reader.Array<std::byte>(header.dataOffset, header.dataSize);
+	std::span<const char> strings = reader.Array<char>(header.stringTableOffset, header.stringTableSize);
+	auto string = [&](uint32_t offset) {
+		if (offset >= strings.size()) throw std::runtime_error("Mesh bundle " + path + " is corrupted");
+		const char* begin = strings.data() + offset;
+		const char* end = std::find(begin, strings.data() + strings.size(), '\0');
+		return std::string(begin, end);
+	};
+
+	_layouts.reserve(header.meshCount);
+	for (const PackedMesh& mesh : reader.Array<PackedMesh>(sizeof(MeshBundleHeader), header.meshCount)) {
+		Mesh::Layout& layout = _layouts.emplace_back();
+		layout.name = string(mesh.name);
+		layout.topology = (vk::PrimitiveTopology)mesh.topology;
+		layout.vertexCount = mesh.vertexCount;
+		layout.indexCount = mesh.indexCount;
+		layout.indexStride = mesh.indexStride;
+		layout.indexOffset = mesh.indexOffset;
+		layout.boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+		layout.boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+		layout.positionOffset = glm::vec3(mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2]);
+		layout.positionScale = mesh.positionScale;
+
+		uint64_t offset = mesh.recordsOffset;
+		for (const PackedBinding& b : reader.Next<PackedBinding>(offset, mesh.bindingCount)) {
+			layout.bindings.push_back({ b.offset, b.stride });
+		}
+		for (const PackedAttribute& a : reader.Next<PackedAttribute>(offset, mesh.attributeCount)) {
+			layout.attributes.push_back({ { (VertexAttributeType)a.attributeType, a.attributeIndex }, a.binding, (vk::Format)a.format, a.offset });
+		}
+		for (const PackedSubmesh& s : reader.Next<PackedSubmesh>(offset, mesh.submeshCount)) {
+			layout.submeshes.push_back({ s.primitiveCount, s.firstVertex, s.firstIndex });
+		}
+		checkLayout(layout, _data.size(), path);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "MappedFile.hpp"
+
+namespace vrg {
+
+	// Meshes cooked offline by the MeshCooker tool, stored exactly as they are uploaded. The file is memory mapped, the
+	// layouts are read from a few fixed size records and the vertex and index data is copied to the gpu as one span
+	// without looking at it. The data starts on a page boundary so the copy reads whole pages straight from the mapping
+	class MeshBundle {
+	public:
+		// bump whenever the layout below or Mesh::Layout changes
+		static constexpr uint32_t Version = 2;
+		static constexpr size_t DataAlignment = 4096;
+
+		// Writes layouts and the data they point into, throws if the file can't be written or a layout points outside data
+		static void Write(const std::string& path, const std::vector<Mesh::Layout>& layouts, std::span<const std::byte> data);
+
+		// Throws if the file is missing, truncated or from another version
+		MeshBundle(const std::string& path);
+
+		inline const std::vector<Mesh::Layout>& Layouts() const { return _layouts; }
+		inline std::span<const std::byte> Data() const { return _data; }
+
+		// Copies the data into one staging buffer, or straight into the mesh buffer on unified memory
+		inline std::vector<std::shared_ptr<Mesh>> Upload(CommandBuffer& commandBuffer) const {
+			return Mesh::Upload(commandBuffer, _name, _layouts, _data.size(), [&](std::byte* destination) { memcpy(destination, _data.data(), _data.size()); });
+		}
+
+		static inline std::vector<std::shared_ptr<Mesh>> Load(CommandBuffer& commandBuffer, const std::string& path) {
+			return MeshBundle(path).Upload(commandBuffer);
+		}
+
+	private:
+		std::string _name;
+		std::shared_ptr<const MappedFile> _file;
+		std::span<const std::byte> _data;
+		std::vector<Mesh::Layout> _layouts;
+	};
+
+}
@@ -0,0 +1,486 @@
+#include "MeshOptimizer.hpp"
+
+using namespace vrg;
+
+static inline uint32_t readIndex(const std::byte* indices, uint32_t stride, size_t i) {
+	switch (stride) {
+	case sizeof(uint8_t): return (uint8_t)indices[i];
+	case sizeof(uint16_t): { uint16_t v; memcpy(&v, indices + i * stride, sizeof(v)); return v; }
+	default: { uint32_t v; memcpy(&v, indices + i * stride, sizeof(v)); return v; }
+	}
+}
+
+static inline void writeIndex(std::byte* indices, uint32_t stride, size_t i, uint32_t value) {
+	switch (stride) {
+	case sizeof(uint8_t): indices[i] = std::byte(value); break;
+	case sizeof(uint16_t): { uint16_t v = (uint16_t)value; memcpy(indices + i * stride, &v, sizeof(v)); break; }
+	default: memcpy(indices + i * stride, &value, sizeof(value)); break;
+	}
+}
+
+uint32_t MeshOptimizer::CacheMisses(std::span<const uint32_t> indices, uint32_t cacheSize) {
+	if (indices.empty()) return 0;
+	//a vertex is still cached if fewer than cacheSize misses happened since it was loaded
+	std::vector<uint32_t> loadedAt(*std::ranges::max_element(indices) + 1, UINT32_MAX);
+	uint32_t misses = 0;
+	for (uint32_t index : indices) {
+		if (loadedAt[index] == UINT32_MAX || misses - loadedAt[index] >= cacheSize) {
+			loadedAt[index] = misses++;
+		}
+	}
+	return misses;
+}
+
+static uint32_t uniqueVertices(std::span<const uint32_t> indices) {
+	if (indices.empty()) return 0;
+	std::vector<bool> used(*std::ranges::max_element(indices) + 1);
+	uint32_t count = 0;
+	for (uint32_t index : indices) {
+		if (!used[index]) {
+			used[index] = true;
+			count++;
+		}
+	}
+	return count;
+}
+
+//Tom Forsyth, Linear-Speed Vertex Cache Optimisation. Greedily emits the triangle whose vertices score highest, vertices
+//score by their position in a simulated lru cache and by how few triangles still need them
+static void optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount) {
+	constexpr uint32_t CacheSize = 32;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+
+	auto score = [](int32_t position, uint32_t remaining) -> float {
+		if (remaining == 0) return -1.0f;
+		float s = 0;
+		//the last triangle's vertices get a fixed score so strips don't always turn the same way
+		if (position >= 0) s = position < 3 ? 0.75f : std::pow(1.0f - (position - 3) / float(CacheSize - 3), 1.5f);
+		//lonely vertices are picked up early instead of being left for the end
+		return s + 2.0f / std::sqrt((float)remaining);
+	};
+
+	//triangles using each vertex, the live ones are kept at the front of each range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices) remaining[index]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) vertexScore[v] = score(-1, remaining[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<bool> emitted(triangleCount);
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	std::vector<uint32_t> cache, newCache;
+	size_t best = std::ranges::max_element(triangleScore) - triangleScore.begin();
+	size_t cursor = 0;
+	for (size_t n = 0; n < triangleCount; n++) {
+		if (best == SIZE_MAX) {
+			//nothing in the cache has triangles left, continue with the next one in the original order
+			while (emitted[cursor]) cursor++;
+			best = cursor;
+		}
+		emitted[best] = true;
+
+		newCache.clear();
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[best * 3 + k];
+			output.push_back(v);
+			if (std::ranges::find(newCache, v) == newCache.end()) newCache.push_back(v);
+			uint32_t* begin = adjacency.data() + offsets[v];
+			uint32_t* end = begin + remaining[v];
+			std::swap(*std::find(begin, end, (uint32_t)best), *(end - 1));
+			remaining[v]--;
+		}
+		for (uint32_t v : cache) {
+			if (std::ranges::find(newCache, v) == newCache.end()) newCache.push_back(v);
+		}
+		//evicted vertices fall back to their uncached score too
+		for (size_t i = 0; i < newCache.size(); i++) {
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < CacheSize ? (int32_t)i : -1;
+			vertexScore[v] = score(cachePosition[v], remaining[v]);
+		}
+		if (newCache.size() > CacheSize) newCache.resize(CacheSize);
+		std::swap(cache, newCache);
+
+		best = SIZE_MAX;
+		float bestScore = -std::numeric_limits<float>::max();
+		for (uint32_t v : cache) {
+			for (uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; i++) {
+				uint32_t t = adjacency[i];
+				float s = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = s;
+				if (s > bestScore) {
+					bestScore = s;
+					best = t;
+				}
+			}
+		}
+	}
+	std::ranges::copy(output, indices.begin());
+}
+
+//Sander et al, Fast Triangle Reordering for Vertex Locality and Reduced Overdraw. The cache optimized order is split into
+//clusters where the cache starts over anyway, then clusters facing away from the mesh center are moved to the front so
+//they occlude the rest. Reverted if the cache efficiency gets worse than threshold allows
+static void optimizeOverdraw(std::span<uint32_t> indices, const std::vector<glm::vec3>& positions, uint32_t cacheSize, float threshold) {
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+	uint32_t baseMisses = MeshOptimizer::CacheMisses(indices, cacheSize);
+	float baseAcmr = baseMisses / (float)triangleCount;
+
+	std::vector<size_t> clusterStarts;
+	{
+		std::vector<uint32_t> loadedAt(positions.size(), UINT32_MAX);
+		uint32_t misses = 0;
+		uint32_t clusterMisses = 0;
+		size_t clusterStart = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			uint32_t triangleMisses = 0;
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = indices[t * 3 + k];
+				if (loadedAt[v] == UINT32_MAX || misses - loadedAt[v] >= cacheSize) {
+					loadedAt[v] = misses++;
+					triangleMisses++;
+				}
+			}
+			//hard boundaries where the cache is cold anyway, soft ones once the cluster alone is as good as the whole mesh
+			bool hard = triangleMisses == 3;
+			bool soft = t - clusterStart >= 32 && clusterMisses <= baseAcmr * threshold * (t - clusterStart);
+			if (t == 0 || hard || soft) {
+				clusterStarts.push_back(t);
+				clusterStart = t;
+				clusterMisses = 0;
+			}
+			clusterMisses += triangleMisses;
+		}
+	}
+	if (clusterStarts.size() < 2) return;
+
+	glm::vec3 meshCenter(0);
+	float meshArea = 0;
+	std::vector<std::pair<float, size_t>> clusters(clusterStarts.size());
+	std::vector<glm::vec3> clusterCenters(clusterStarts.size());
+	std::vector<glm::vec3> clusterNormals(clusterStarts.size());
+	for (size_t c = 0; c < clusterStarts.size(); c++) {
+		size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+		glm::vec3 center(0), normal(0);
+		float area = 0;
+		for (size_t t = clusterStarts[c]; t < end; t++) {
+			const glm::vec3& a = positions[indices[t * 3]];
+			const glm::vec3& b = positions[indices[t * 3 + 1]];
+			const glm::vec3& d = positions[indices[t * 3 + 2]];
+			glm::vec3 cross = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(cross);
+			center += (a + b + d) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCenter += center;
+		meshArea += area;
+		clusterCenters[c] = area > 0 ? center / area : positions[indices[clusterStarts[c] * 3]];
+		float length = glm::length(normal);
+		clusterNormals[c] = length > 0 ? normal / length : glm::vec3(0);
+	}
+	if (meshArea <= 0) return;
+	meshCenter /= meshArea;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		clusters[c] = { glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c]), c };
+	}
+	std::ranges::stable_sort(clusters, std::ranges::greater(), &std::pair<float, size_t>::first);
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const auto& [key, c] : clusters) {
+		size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+		sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + end * 3);
+	}
+	if (MeshOptimizer::CacheMisses(sorted, cacheSize) <= baseMisses * threshold) {
+		std::ranges::copy(sorted, indices.begin());
+	}
+}
+
+//16 bit indices reach 65536 vertices past the base vertex. Submeshes spanning more are cut where the next triangle would
+//leave that window, each part draws with a base vertex of its own. Vertices are in first use order by now, so parts are few
+static void splitSubmesh(const Mesh::Submesh& submesh, std::vector<uint32_t>& indices, std::vector<Mesh::Submesh>& parts) {
+	constexpr uint32_t MaxSpan = 0x10000;
+	size_t first = submesh.firstIndex;
+	size_t end = first + (size_t)submesh.primitiveCount * 3;
+	if (first == end) {
+		parts.push_back(submesh);
+		return;
+	}
+
+	size_t start = first;
+	uint32_t min = UINT32_MAX, max = 0;
+	auto emit = [&](size_t stop) {
+		for (size_t i = start; i < stop; i++) indices[i] -= min;
+		parts.push_back({ (uint32_t)((stop - start) / 3), submesh.firstVertex + min, (uint32_t)start });
+	};
+	for (size_t t = first; t < end; t += 3) {
+		uint32_t triangleMin = std::min({ indices[t], indices[t + 1], indices[t + 2] });
+		uint32_t triangleMax = std::max({ indices[t], indices[t + 1], indices[t + 2] });
+		if (t > start && std::max(max, triangleMax) - std::min(min, triangleMin) >= MaxSpan) {
+			emit(t);
+			start = t;
+			min = UINT32_MAX;
+			max = 0;
+		}
+		min = std::min(min, triangleMin);
+		max = std::max(max, triangleMax);
+	}
+	emit(end);
+}
+
+//everything one mesh turns into, relative to its own data until the meshes are packed together again
+struct OptimizedMesh {
+	Mesh::Layout layout;
+	std::vector<std::byte> data;
+	std::optional<MeshOptimizer::Statistics> statistics;
+};
+
+static inline void alignData(std::vector<std::byte>& data) {
+	data.resize((data.size() + 15) & ~size_t(15));
+}
+
+static OptimizedMesh optimizeMesh(const Mesh::Layout& layout, const std::vector<std::byte>& data, const MeshOptimizer::Options& options) {
+	OptimizedMesh result;
+	result.layout = layout;
+	auto copyIndices = [&]() {
+		if (!layout.indexStride) return;
+		alignData(result.data);
+		result.layout.indexOffset = result.data.size();
+		auto begin = data.begin() + layout.indexOffset;
+		result.data.insert(result.data.end(), begin, begin + (size_t)layout.indexCount * layout.indexStride);
+	};
+	auto copyVertices = [&](const std::vector<uint32_t>* order) {
+		for (size_t b = 0; b < layout.bindings.size(); b++) {
+			const Mesh::Layout::Binding& binding = layout.bindings[b];
+			alignData(result.data);
+			result.layout.bindings[b].offset = result.data.size();
+			if (!order) {
+				auto begin = data.begin() + binding.offset;
+				result.data.insert(result.data.end(), begin, begin + (size_t)layout.vertexCount * binding.stride);
+				continue;
+			}
+			size_t offset = result.data.size();
+			result.data.resize(offset + order->size() * binding.stride);
+			for (size_t v = 0; v < order->size(); v++) {
+				memcpy(result.data.data() + offset + v * binding.stride, data.data() + binding.offset + (size_t)(*order)[v] * binding.stride, binding.stride);
+			}
+		}
+	};
+
+	bool supported = layout.topology == vk::PrimitiveTopology::eTriangleList && layout.indexStride && layout.vertexCount;
+	std::vector<uint32_t> indices(supported ? layout.indexCount : 0);
+	for (size_t i = 0; i < indices.size(); i++) indices[i] = readIndex(data.data() + layout.indexOffset, layout.indexStride, i);
+
+	//vertices each submesh references, starting at its base vertex
+	struct Range {
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+	};
+	std::vector<Range> ranges;
+	for (const Mesh::Submesh& submesh : layout.submeshes) {
+		if (!supported) break;
+		size_t count = (size_t)submesh.primitiveCount * 3;
+		if (submesh.firstIndex + count > indices.size()) {
+			supported = false;
+			break;
+		}
+		uint32_t maxIndex = 0;
+		for (size_t i = submesh.firstIndex; i < submesh.firstIndex + count; i++) maxIndex = std::max(maxIndex, indices[i]);
+		Range range = { submesh.firstVertex, count ? maxIndex + 1 : 0 };
+		if ((uint64_t)range.firstVertex + range.vertexCount > layout.vertexCount) supported = false;
+		ranges.push_back(range);
+	}
+	//triangles are rewritten per submesh, two submeshes drawing the same indices would be rewritten twice
+	std::vector<std::pair<uint32_t, uint32_t>> indexRanges;
+	for (const Mesh::Submesh& submesh : layout.submeshes) indexRanges.emplace_back(submesh.firstIndex, submesh.firstIndex + submesh.primitiveCount * 3);
+	std::ranges::sort(indexRanges);
+	for (size_t i = 1; i < indexRanges.size(); i++) {
+		if (indexRanges[i - 1].second > indexRanges[i].first) supported = false;
+	}
+	if (!supported) {
+		copyVertices(nullptr);
+		copyIndices();
+		return result;
+	}
+
+	//vertices can only move if no two submeshes share them
+	std::vector<Range> sortedRanges = ranges;
+	std::ranges::sort(sortedRanges, {}, &Range::firstVertex);
+	bool disjoint = true;
+	for (size_t i = 1; i < sortedRanges.size(); i++) {
+		if (sortedRanges[i - 1].firstVertex + sortedRanges[i - 1].vertexCount > sortedRanges[i].firstVertex) disjoint = false;
+	}
+	bool remap = disjoint && (options.weld || options.vertexFetch);
+
+	//welding compares the packed attribute values, a vertex's key is every attribute's bytes back to back
+	uint32_t keySize = 0;
+	for (const Mesh::Layout::Attribute& attribute : layout.attributes) keySize += (uint32_t)texel_size(attribute.format);
+	bool weld = remap && options.weld && keySize && std::ranges::none_of(layout.attributes, [](const auto& a) { return texel_size(a.format) == 0; });
+
+	auto position = std::ranges::find_if(layout.attributes, [](const auto& a) { return a.id == VertexAttributeId{ VertexAttributeType::Position, 0 } && a.format == vk::Format::eR32G32B32Sfloat; });
+	bool overdraw = options.overdraw && position != layout.attributes.end();
+
+	MeshOptimizer::Statistics statistics;
+	statistics.name = layout.name;
+	statistics.verticesBefore = layout.vertexCount;
+	uint32_t missesBefore = 0, missesAfter = 0, uniqueBefore = 0, uniqueAfter = 0;
+
+	std::vector<uint32_t> order;
+	for (size_t s = 0; s < layout.submeshes.size(); s++) {
+		Mesh::Submesh& submesh = result.layout.submeshes[s];
+		const Range& range = ranges[s];
+		std::span<uint32_t> triangles(indices.data() + submesh.firstIndex, (size_t)submesh.primitiveCount * 3);
+		statistics.triangles += submesh.primitiveCount;
+		missesBefore += MeshOptimizer::CacheMisses(triangles, options.cacheSize);
+		uniqueBefore += uniqueVertices(triangles);
+
+		if (weld) {
+			std::vector<std::byte> keys((size_t)range.vertexCount * keySize);
+			for (uint32_t v = 0; v < range.vertexCount; v++) {
+				std::byte* key = keys.data() + (size_t)v * keySize;
+				for (const Mesh::Layout::Attribute& attribute : layout.attributes) {
+					const Mesh::Layout::Binding& binding = layout.bindings[attribute.binding];
+					size_t size = texel_size(attribute.format);
+					memcpy(key, data.data() + binding.offset + (size_t)(range.firstVertex + v) * binding.stride + attribute.offset, size);
+					key += size;
+				}
+			}
+			std::unordered_map<std::string_view, uint32_t> first;
+			first.reserve(range.vertexCount);
+			std::vector<uint32_t> canonical(range.vertexCount);
+			for (uint32_t v = 0; v < range.vertexCount; v++) {
+				std::string_view key(reinterpret_cast<const char*>(keys.data()) + (size_t)v * keySize, keySize);
+				canonical[v] = first.emplace(key, v).first->second;
+			}
+			for (uint32_t& index : triangles) index = canonical[index];
+		}
+
+		if (options.vertexCache) optimizeVertexCache(triangles, range.vertexCount);
+
+		if (overdraw) {
+			const Mesh::Layout::Binding& binding = layout.bindings[position->binding];
+			std::vector<glm::vec3> positions(range.vertexCount);
+			for (uint32_t v = 0; v < range.vertexCount; v++) {
+				memcpy(&positions[v], data.data() + binding.offset + (size_t)(range.firstVertex + v) * binding.stride + position->offset, sizeof(glm::vec3));
+			}
+			optimizeOverdraw(triangles, positions, options.cacheSize, options.overdrawThreshold);
+		}
+
+		if (remap) {
+			//first use order when optimizing fetch, otherwise the surviving vertices keep their relative order
+			std::vector<uint32_t> newIndex(range.vertexCount, UINT32_MAX);
+			uint32_t newFirst = (uint32_t)order.size();
+			if (options.vertexFetch) {
+				for (uint32_t index : triangles) {
+					if (newIndex[index] == UINT32_MAX) {
+						newIndex[index] = (uint32_t)order.size() - newFirst;
+						order.push_back(range.firstVertex + index);
+					}
+				}
+			}
+			else {
+				for (uint32_t index : triangles) newIndex[index] = 0;
+				for (uint32_t v = 0; v < range.vertexCount; v++) {
+					if (newIndex[v] == UINT32_MAX) continue;
+					newIndex[v] = (uint32_t)order.size() - newFirst;
+					order.push_back(range.firstVertex + v);
+				}
+			}
+			for (uint32_t& index : triangles) index = newIndex[index];
+			submesh.firstVertex = newFirst;
+		}
+
+		missesAfter += MeshOptimizer::CacheMisses(triangles, options.cacheSize);
+		uniqueAfter += uniqueVertices(triangles);
+	}
+
+	if (remap) result.layout.vertexCount = (uint32_t)order.size();
+	copyVertices(remap ? &order : nullptr);
+
+	//indices only get smaller, the stride still fits
+	uint32_t indexStride = layout.indexStride;
+	if (options.narrowIndices) {
+		std::vector<Mesh::Submesh> parts;
+		for (const Mesh::Submesh& submesh : result.layout.submeshes) splitSubmesh(submesh, indices, parts);
+		uint64_t span = 0;
+		for (const Mesh::Submesh& part : parts) {
+			for (size_t i = part.firstIndex; i < part.firstIndex + (size_t)part.primitiveCount * 3; i++) span = std::max<uint64_t>(span, indices[i] + 1ull);
+		}
+		indexStride = std::min(indexStride, Mesh::IndexStride(span, options.uint8Indices));
+		result.layout.submeshes = std::move(parts);
+	}
+	result.layout.indexStride = indexStride;
+	alignData(result.data);
+	result.layout.indexOffset = result.data.size();
+	result.data.resize(result.data.size() + (size_t)layout.indexCount * indexStride);
+	for (size_t i = 0; i < indices.size(); i++) writeIndex(result.data.data() + result.layout.indexOffset, indexStride, i, indices[i]);
+	statistics.indexStrideBefore = layout.indexStride;
+	statistics.indexStrideAfter = indexStride;
+	statistics.submeshesBefore = (uint32_t)layout.submeshes.size();
+	statistics.submeshesAfter = (uint32_t)result.layout.submeshes.size();
+
+	statistics.verticesAfter = result.layout.vertexCount;
+	if (statistics.triangles) {
+		statistics.acmrBefore = missesBefore / (float)statistics.triangles;
+		statistics.acmrAfter = missesAfter / (float)statistics.triangles;
+	}
+	statistics.atvrBefore = uniqueBefore ? missesBefore / (float)uniqueBefore : 0;
+	statistics.atvrAfter = uniqueAfter ? missesAfter / (float)uniqueAfter : 0;
+	result.statistics = statistics;
+	return result;
+}
+
+std::vector<MeshOptimizer::Statistics> MeshOptimizer::Optimize(std::vector<Mesh::Layout>& layouts, std::vector<std::byte>& data, ThreadPool* pool) const {
+	std::vector<OptimizedMesh> meshes(layouts.size());
+	auto optimize = [&](size_t i) { meshes[i] = optimizeMesh(layouts[i], data, _options); };
+	if (pool) pool->ParallelFor(0, layouts.size(), optimize);
+	else for (size_t i = 0; i < layouts.size(); i++) optimize(i);
+
+	std::vector<std::byte> packed;
+	std::vector<Statistics> statistics;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		OptimizedMesh& mesh = meshes[i];
+		alignData(packed);
+		vk::DeviceSize base = packed.size();
+		packed.insert(packed.end(), mesh.data.begin(), mesh.data.end());
+		for (Mesh::Layout::Binding& binding : mesh.layout.bindings) binding.offset += base;
+		mesh.layout.indexOffset += base;
+		layouts[i] = std::move(mesh.layout);
+		if (mesh.statistics) statistics.push_back(*mesh.statistics);
+	}
+	data = std::move(packed);
+	return statistics;
+}
+
+void MeshOptimizer::PrintStatistics(const std::vector<Statistics>& statistics) {
+	uint32_t triangles = 0, verticesBefore = 0, verticesAfter = 0;
+	double missesBefore = 0, missesAfter = 0;
+	for (const Statistics& s : statistics) {
+		printf("  %s: %u triangles, %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u -> %u byte indices in %u -> %u submeshes\n", s.name.c_str(), s.triangles,
+			s.verticesBefore, s.verticesAfter, s.acmrBefore, s.acmrAfter, s.atvrBefore, s.atvrAfter, s.indexStrideBefore, s.indexStrideAfter, s.submeshesBefore, s.submeshesAfter);
+		triangles += s.triangles;
+		verticesBefore += s.verticesBefore;
+		verticesAfter += s.verticesAfter;
+		missesBefore += s.acmrBefore * s.triangles;
+		missesAfter += s.acmrAfter * s.triangles;
+	}
+	if (triangles) {
+		printf_color(ConsoleColor::Cyan, "%u triangles, %u -> %u vertices, ACMR %.3f -> %.3f\n", triangles, verticesBefore, verticesAfter, missesBefore / triangles, missesAfter / triangles);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "ThreadPool.hpp"
+
+namespace vrg {
+
+	// Reorders indexed triangle list meshes for the gpu before they are uploaded, at import or cook time. Works on the
+	// layouts and data that GltfLoader and MeshBundle use, meshes on the gpu are never read back. Per submesh it
+	//  - welds vertices whose attributes are bit identical
+	//  - orders triangles for the post transform vertex cache with Forsyth's algorithm
+	//  - sorts clusters of triangles so those facing away from the center are drawn first, cutting overdraw,
+	//    as long as the vertex cache efficiency stays within overdrawThreshold
+	//  - renumbers vertices in the order the indices first use them so vertex fetch walks memory linearly
+	//  - stores indices with the narrowest stride, splitting submeshes over 65536 vertices into parts with their own base vertex
+	// Other topologies and meshes without indices are passed through unchanged
+	class MeshOptimizer {
+	public:
+		struct Options {
+			bool weld = true;
+			bool vertexCache = true;
+			bool overdraw = true;
+			bool vertexFetch = true;
+			bool narrowIndices = true;
+			// 1 byte indices for meshes whose submeshes use at most 256 vertices, only for devices with Device::IndexTypeUint8
+			bool uint8Indices = false;
+			// how much the average cache miss ratio may grow in exchange for less overdraw
+			float overdrawThreshold = 1.05f;
+			// entries of the fifo cache ACMR and ATVR are measured with, modern gpus behave like 16 to 32
+			uint32_t cacheSize = 16;
+		};
+
+		struct Statistics {
+			std::string name;
+			uint32_t triangles = 0;
+			uint32_t verticesBefore = 0;
+			uint32_t verticesAfter = 0;
+			// average cache miss ratio, transformed vertices per triangle. 0.5 is ideal for large grids, 3 is the worst
+			float acmrBefore = 0;
+			float acmrAfter = 0;
+			// average transform to vertex ratio, transformed vertices per referenced vertex. 1 is ideal
+			float atvrBefore = 0;
+			float atvrAfter = 0;
+			uint32_t indexStrideBefore = 0;
+			uint32_t indexStrideAfter = 0;
+			uint32_t submeshesBefore = 0;
+			uint32_t submeshesAfter = 0;
+		};
+
+		inline MeshOptimizer(const Options& options = {}) : _options(options) {}
+
+		// Optimizes every mesh in place and repacks data, meshes are processed in parallel when a pool is given.
+		// Returns the statistics of every indexed triangle list mesh
+		std::vector<Statistics> Optimize(std::vector<Mesh::Layout>& layouts, std::vector<std::byte>& data, ThreadPool* pool = nullptr) const;
+
+		// Vertices a fifo cache of cacheSize entries transforms for these triangles
+		static uint32_t CacheMisses(std::span<const uint32_t> indices, uint32_t cacheSize);
+		static inline float ACMR(std::span<const uint32_t> indices, uint32_t cacheSize) {
+			return indices.size() < 3 ? 0 : CacheMisses(indices, cacheSize) / float(indices.size() / 3);
+		}
+
+		static void PrintStatistics(const std::vector<Statistics>& statistics);
+
+	private:
+		Options _options;
+	};
+
+}
@@ -0,0 +1,265 @@
+#include "MeshQuantizer.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+using namespace vrg;
+
+glm::vec2 MeshQuantizer::OctahedralEncode(const glm::vec3& direction) {
+	float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (length == 0) return glm::vec2(0);
+	glm::vec2 p = glm::vec2(direction) / length;
+	if (direction.z < 0) {
+		//the lower hemisphere is folded over the diagonals
+		glm::vec2 sign(p.x >= 0 ? 1.0f : -1.0f, p.y >= 0 ? 1.0f : -1.0f);
+		p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+	}
+	return p;
+}
+
+glm::vec3 MeshQuantizer::OctahedralDecode(const glm::vec2& encoded) {
+	glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0 ? -t : t;
+	n.y += n.y >= 0 ? -t : t;
+	return glm::normalize(n);
+}
+
+enum class Encoding {
+	Copy,
+	PositionSnorm16,
+	PositionHalf,
+	NormalOctahedral,
+	TangentOctahedral,
+	ColorUnorm8,
+	TexCoordHalf
+};
+
+static inline uint32_t floatComponents(vk::Format format) {
+	switch (format) {
+	case vk::Format::eR32Sfloat: return 1;
+	case vk::Format::eR32G32Sfloat: return 2;
+	case vk::Format::eR32G32B32Sfloat: return 3;
+	case vk::Format::eR32G32B32A32Sfloat: return 4;
+	default: return 0;
+	}
+}
+
+//half stops at 65504
+static constexpr float HalfMax = 65504.0f;
+
+struct QuantizedMesh {
+	Mesh::Layout layout;
+	std::vector<std::byte> data;
+	std::optional<MeshQuantizer::Statistics> statistics;
+};
+
+static inline void alignData(std::vector<std::byte>& data) {
+	data.resize((data.size() + 15) & ~size_t(15));
+}
+
+static QuantizedMesh quantizeMesh(const Mesh::Layout& layout, const std::vector<std::byte>& data, const MeshQuantizer::Options& options) {
+	QuantizedMesh result;
+	result.layout = layout;
+	auto copyIndices = [&]() {
+		if (!layout.indexStride) return;
+		alignData(result.data);
+		result.layout.indexOffset = result.data.size();
+		auto begin = data.begin() + layout.indexOffset;
+		result.data.insert(result.data.end(), begin, begin + (size_t)layout.indexCount * layout.indexStride);
+	};
+
+	//attributes without a fixed size can't be given a binding of their own, such meshes are only moved
+	if (std::ranges::any_of(layout.attributes, [](const auto& a) { return texel_size(a.format) == 0; })) {
+		for (size_t b = 0; b < layout.bindings.size(); b++) {
+			alignData(result.data);
+			result.layout.bindings[b].offset = result.data.size();
+			auto begin = data.begin() + layout.bindings[b].offset;
+			result.data.insert(result.data.end(), begin, begin + (size_t)layout.vertexCount * layout.bindings[b].stride);
+		}
+		copyIndices();
+		return result;
+	}
+
+	MeshQuantizer::Statistics statistics;
+	statistics.name = layout.name;
+	for (const Mesh::Layout::Binding& binding : layout.bindings) statistics.bytesBefore += (vk::DeviceSize)layout.vertexCount * binding.stride;
+
+	auto read = [&](const Mesh::Layout::Attribute& attribute, uint32_t v) {
+		const Mesh::Layout::Binding& binding = layout.bindings[attribute.binding];
+		glm::vec4 value(0);
+		memcpy(&value, data.data() + binding.offset + (size_t)v * binding.stride + attribute.offset, floatComponents(attribute.format) * sizeof(float));
+		return value;
+	};
+	auto all = [&](const Mesh::Layout::Attribute& attribute, auto predicate) {
+		for (uint32_t v = 0; v < layout.vertexCount; v++) {
+			if (!predicate(read(attribute, v))) return false;
+		}
+		return true;
+	};
+
+	result.layout.bindings.clear();
+	for (size_t a = 0; a < layout.attributes.size(); a++) {
+		const Mesh::Layout::Attribute& source = layout.attributes[a];
+		Mesh::Layout::Attribute& attribute = result.layout.attributes[a];
+		uint32_t components = floatComponents(source.format);
+
+		Encoding encoding = Encoding::Copy;
+		switch (source.id.type) {
+		case VertexAttributeType::Position:
+			if (components != 3 || source.id.typeIndex != 0) break;
+			if (options.positions == MeshQuantizer::PositionFormat::Snorm16) encoding = Encoding::PositionSnorm16;
+			if (options.positions == MeshQuantizer::PositionFormat::Half) encoding = Encoding::PositionHalf;
+			break;
+		case VertexAttributeType::Normal:
+			if (components == 3 && options.octahedralNormals) encoding = Encoding::NormalOctahedral;
+			break;
+		case VertexAttributeType::Tangent:
+			if (components == 4 && options.octahedralTangents) encoding = Encoding::TangentOctahedral;
+			break;
+		case VertexAttributeType::Color:
+			//hdr vertex colors stay float
+			if (components >= 3 && options.unorm8Colors && all(source, [](const glm::vec4& c) { return glm::all(glm::greaterThanEqual(c, glm::vec4(0))) && glm::all(glm::lessThanEqual(c, glm::vec4(1))); })) {
+				encoding = Encoding::ColorUnorm8;
+			}
+			break;
+		case VertexAttributeType::TexCoord:
+			if (components == 2 && options.halfTexCoords && all(source, [](const glm::vec4& t) { return std::abs(t.x) <= HalfMax && std::abs(t.y) <= HalfMax; })) {
+				encoding = Encoding::TexCoordHalf;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (encoding == Encoding::PositionSnorm16 || encoding == Encoding::PositionHalf) {
+			glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+			for (uint32_t v = 0; v < layout.vertexCount; v++) {
+				glm::vec3 p = read(source, v);
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+			if (layout.vertexCount) {
+				//half keeps its own exponent, centering it is all that helps. The snorm scale is the same on every axis so
+				//the transform stays a similarity and doesn't skew normals
+				glm::vec3 extent = (max - min) * 0.5f;
+				float scale = std::max(extent.x, std::max(extent.y, extent.z));
+				result.layout.positionOffset = (min + max) * 0.5f;
+				result.layout.positionScale = encoding == Encoding::PositionSnorm16 && scale > 0 ? scale : 1.0f;
+			}
+		}
+
+		switch (encoding) {
+		case Encoding::Copy: attribute.format = source.format; break;
+		case Encoding::PositionSnorm16: attribute.format = vk::Format::eR16G16B16A16Snorm; break;
+		case Encoding::PositionHalf: attribute.format = vk::Format::eR16G16B16A16Sfloat; break;
+		case Encoding::NormalOctahedral: attribute.format = vk::Format::eR16G16Snorm; break;
+		case Encoding::TangentOctahedral: attribute.format = vk::Format::eR8G8B8A8Snorm; break;
+		case Encoding::ColorUnorm8: attribute.format = vk::Format::eR8G8B8A8Unorm; break;
+		case Encoding::TexCoordHalf: attribute.format = vk::Format::eR16G16Sfloat; break;
+		}
+
+		alignData(result.data);
+		Mesh::Layout::Binding binding = { result.data.size(), (uint32_t)((texel_size(attribute.format) + 3) & ~3ull) };
+		attribute.binding = (uint32_t)result.layout.bindings.size();
+		attribute.offset = 0;
+		result.layout.bindings.push_back(binding);
+		result.data.resize(binding.offset + (size_t)layout.vertexCount * binding.stride);
+
+		glm::vec3 offset = result.layout.positionOffset;
+		float scale = result.layout.positionScale;
+		for (uint32_t v = 0; v < layout.vertexCount; v++) {
+			std::byte* destination = result.data.data() + binding.offset + (size_t)v * binding.stride;
+			if (encoding == Encoding::Copy) {
+				const Mesh::Layout::Binding& sourceBinding = layout.bindings[source.binding];
+				memcpy(destination, data.data() + sourceBinding.offset + (size_t)v * sourceBinding.stride + source.offset, texel_size(source.format));
+				continue;
+			}
+
+			glm::vec4 value = read(source, v);
+			switch (encoding) {
+			case Encoding::PositionSnorm16: {
+				uint64_t packed = glm::packSnorm4x16(glm::vec4((glm::vec3(value) - offset) / scale, 0.0f));
+				memcpy(destination, &packed, sizeof(packed));
+				glm::vec3 decoded = glm::vec3(glm::unpackSnorm4x16(packed)) * scale + offset;
+				statistics.positionError = std::max(statistics.positionError, glm::length(decoded - glm::vec3(value)));
+				break;
+			}
+			case Encoding::PositionHalf: {
+				uint64_t packed = glm::packHalf4x16(glm::vec4(glm::vec3(value) - offset, 0.0f));
+				memcpy(destination, &packed, sizeof(packed));
+				glm::vec3 decoded = glm::vec3(glm::unpackHalf4x16(packed)) + offset;
+				statistics.positionError = std::max(statistics.positionError, glm::length(decoded - glm::vec3(value)));
+				break;
+			}
+			case Encoding::NormalOctahedral: {
+				uint32_t packed = glm::packSnorm2x16(MeshQuantizer::OctahedralEncode(glm::vec3(value)));
+				memcpy(destination, &packed, sizeof(packed));
+				float length = glm::length(glm::vec3(value));
+				if (length > 0) {
+					float cosine = glm::dot(MeshQuantizer::OctahedralDecode(glm::unpackSnorm2x16(packed)), glm::vec3(value) / length);
+					statistics.normalError = std::max(statistics.normalError, glm::degrees(std::acos(std::clamp(cosine, -1.0f, 1.0f))));
+				}
+				break;
+			}
+			case Encoding::TangentOctahedral: {
+				glm::vec2 encoded = MeshQuantizer::OctahedralEncode(glm::vec3(value));
+				uint32_t packed = glm::packSnorm4x8(glm::vec4(encoded, 0.0f, value.w < 0 ? -1.0f : 1.0f));
+				memcpy(destination, &packed, sizeof(packed));
+				break;
+			}
+			case Encoding::ColorUnorm8: {
+				uint32_t packed = glm::packUnorm4x8(components == 4 ? value : glm::vec4(glm::vec3(value), 1.0f));
+				memcpy(destination, &packed, sizeof(packed));
+				break;
+			}
+			case Encoding::TexCoordHalf: {
+				uint32_t packed = glm::packHalf2x16(glm::vec2(value));
+				memcpy(destination, &packed, sizeof(packed));
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+	copyIndices();
+
+	for (const Mesh::Layout::Binding& binding : result.layout.bindings) statistics.bytesAfter += (vk::DeviceSize)layout.vertexCount * binding.stride;
+	result.statistics = statistics;
+	return result;
+}
+
+std::vector<MeshQuantizer::Statistics> MeshQuantizer::Quantize(std::vector<Mesh::Layout>& layouts, std::vector<std::byte>& data, ThreadPool* pool) const {
+	std::vector<QuantizedMesh> meshes(layouts.size());
+	auto quantize = [&](size_t i) { meshes[i] = quantizeMesh(layouts[i], data, _options); };
+	if (pool) pool->ParallelFor(0, layouts.size(), quantize);
+	else for (size_t i = 0; i < layouts.size(); i++) quantize(i);
+
+	std::vector<std::byte> packed;
+	std::vector<Statistics> statistics;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		QuantizedMesh& mesh = meshes[i];
+		alignData(packed);
+		vk::DeviceSize base = packed.size();
+		packed.insert(packed.end(), mesh.data.begin(), mesh.data.end());
+		for (Mesh::Layout::Binding& binding : mesh.layout.bindings) binding.offset += base;
+		mesh.layout.indexOffset += base;
+		layouts[i] = std::move(mesh.layout);
+		if (mesh.statistics) statistics.push_back(*mesh.statistics);
+	}
+	data = std::move(packed);
+	return statistics;
+}
+
+void MeshQuantizer::PrintStatistics(const std::vector<Statistics>& statistics) {
+	vk::DeviceSize bytesBefore = 0, bytesAfter = 0;
+	for (const Statistics& s : statistics) {
+		printf("  %s: %llu -> %llu vertex bytes, position error %g, normal error %.3f degrees\n", s.name.c_str(),
+			(unsigned long long)s.bytesBefore, (unsigned long long)s.bytesAfter, s.positionError, s.normalError);
+		bytesBefore += s.bytesBefore;
+		bytesAfter += s.bytesAfter;
+	}
+	if (bytesBefore) {
+		printf_color(ConsoleColor::Cyan, "%llu -> %llu bytes of vertex data, %.1f%%\n", (unsigned long long)bytesBefore, (unsigned long long)bytesAfter, 100.0 * bytesAfter / bytesBefore);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Mesh.hpp"
+#include "ThreadPool.hpp"
+
+namespace vrg {
+
+	// Stores float vertex attributes in compact formats before meshes are uploaded or cooked, on the same layouts and data
+	// as MeshOptimizer. Every attribute gets its own binding, the cook step interleaves them if asked to
+	//  - positions as snorm16 scaled to the mesh's bounds, or as half around its center. Mesh::PositionTransform undoes it
+	//  - normals as octahedral snorm16, tangents as octahedral snorm8 with the handedness in w
+	//  - colors within [0, 1] as unorm8
+	//  - texture coordinates as half
+	// Only the octahedral directions need shader code, see Geometry::DecodeDefines. Attributes in other formats are copied
+	class MeshQuantizer {
+	public:
+		enum class PositionFormat {
+			Float,
+			Half,
+			Snorm16
+		};
+
+		struct Options {
+			PositionFormat positions = PositionFormat::Snorm16;
+			bool octahedralNormals = true;
+			bool octahedralTangents = true;
+			bool unorm8Colors = true;
+			bool halfTexCoords = true;
+		};
+
+		struct Statistics {
+			std::string name;
+			vk::DeviceSize bytesBefore = 0;
+			vk::DeviceSize bytesAfter = 0;
+			// largest distance between a decoded and the original position, in object space
+			float positionError = 0;
+			// largest angle between a decoded and the original normal, in degrees
+			float normalError = 0;
+		};
+
+		inline MeshQuantizer(const Options& options = {}) : _options(options) {}
+
+		// Quantizes every mesh in place and repacks data, meshes are processed in parallel when a pool is given
+		std::vector<Statistics> Quantize(std::vector<Mesh::Layout>& layouts, std::vector<std::byte>& data, ThreadPool* pool = nullptr) const;
+
+		// Octahedral mapping of a unit vector to [-1, 1]^2, OctahedralDecode in Shaders/VertexDecode.h is the inverse
+		static glm::vec2 OctahedralEncode(const glm::vec3& direction);
+		static glm::vec3 OctahedralDecode(const glm::vec2& encoded);
+
+		static void PrintStatistics(const std::vector<Statistics>& statistics);
+
+	private:
+		Options _options;
+	};
+
+}
@@ -3,6 +3,8 @@
 #include "RenderPass.hpp"
 #include "Geometry.hpp"
 #include "DescriptorSet.hpp"
+#include "PipelineLibrary.hpp"
+#include "PipelineTelemetry.hpp"
 
 namespace vrg {
 
@@ -10,27 +12,62 @@ namespace vrg {
 	protected:
 		std::vector<std::shared_ptr<SpirvModule>> _modules;
 		std::vector<vk::PipelineShaderStageCreateInfo> _stages;
+		//content of each stage, the module's hash combined with its specialization
+		std::vector<size_t> _stageHashes;
+		struct Specialization {
+			std::vector<vk::SpecializationMapEntry> entries;
+			std::vector<std::byte> data;
+			vk::SpecializationInfo info;
+		};
+		//_stages point into these
+		std::vector<Specialization> _specializations;
 		std::vector<std::shared_ptr<const DescriptorSetLayout>> _descriptorSetLayouts;
 		std::unordered_map<std::string, DescriptorBinding> _descriptorBindings;
 		std::unordered_map<std::string, vk::PushConstantRange> _pushConstants;
+		std::vector<vk::PushConstantRange> _pushConstantRanges;
 		vk::PipelineLayout _layout;
 		vk::Pipeline _pipeline;
 		size_t _hash = 0;
+		std::atomic<bool> _used = false;
 
 		inline void createStages() {
-			std::vector<vk::PushConstantRange> pushConstantRanges;
+			std::vector<vk::PushConstantRange>& pushConstantRanges = _pushConstantRanges;
+			_specializations.reserve(_modules.size());
 			for (auto spirv : _modules) {
 				vk::PipelineShaderStageCreateInfo stageInfo = {};
 				stageInfo.stage = spirv->_stage;
 				stageInfo.module = spirv->_module;
 				stageInfo.pName = spirv->_entryPoint.c_str();
+
+				size_t stageHash = spirv->_hash;
+				if (!spirv->_specializationConstants.empty()) {
+					Specialization& specialization = _specializations.emplace_back();
+					for (const auto& [id, value] : spirv->_specializationConstants) {
+						const auto& constants = spirv->Reflection().specializationConstants;
+						auto constant = std::ranges::find_if(constants, [&](const auto& c) { return c.second.constantId == id; });
+						//the shader doesn't declare it, nothing to specialize
+						if (constant == constants.end()) continue;
+						uint32_t size = constant->second.size;
+						specialization.entries.emplace_back(id, (uint32_t)specialization.data.size(), size);
+						//the low bytes hold 32 bit values on little endian hosts
+						specialization.data.resize(specialization.data.size() + size);
+						memcpy(specialization.data.data() + specialization.data.size() - size, &value, size);
+					}
+					specialization.info = vk::SpecializationInfo((uint32_t)specialization.entries.size(), specialization.entries.data(), specialization.data.size(), specialization.data.data());
+					stageInfo.pSpecializationInfo = &specialization.info;
+					for (const auto& entry : specialization.entries) {
+						stageHash = hash_combine(stageHash, entry.constantID, entry.size);
+					}
+					stageHash = hash_combine(stageHash, hash_fnv1a(std::string_view(reinterpret_cast<const char*>(specialization.data.data()), specialization.data.size())));
+				}
 				_stages.push_back(stageInfo);
-				_hash = hash_combine(_hash, spirv);
+				_stageHashes.push_back(stageHash);
+				_hash = hash_combine(_hash, stageHash);
 
-				if (spirv->_pushConstants.size()) {
+				if (spirv->PushConstants().size()) {
 					uint32_t first = ~0;
 					uint32_t last = 0;
-					for (const auto& [id, pushConstant] : spirv->_pushConstants) {
+					for (const auto& [id, pushConstant] : spirv->PushConstants()) {
 						auto it = _pushConstants.find(id);
 						if (it == _pushConstants.end()) {
 							//pushconstant doesnt exist yet, create it
@@ -40,14 +77,16 @@ namespace vrg {
 							if (it->second.offset != pushConstant.first || it->second.size != pushConstant.second) {
 								throw std::runtime_error("Spirv modules share push constant names with differents offsets and sizes");
 							}
-							first = std::min(first, pushConstant.first);
-							last = std::max(last, pushConstant.first + pushConstant.second);
+							it->second.stageFlags |= spirv->_stage;
 						}
-						pushConstantRanges.emplace_back(spirv->_stage, first, last - first);
+						first = std::min(first, pushConstant.first);
+						last = std::max(last, pushConstant.first + pushConstant.second);
 					}
+					//one range per stage, covering every push constant the stage uses
+					pushConstantRanges.emplace_back(spirv->_stage, first, last - first);
 				}
 
-				for (const auto& [id, binding] : spirv->_descriptorBindings) {
+				for (const auto& [id, binding] : spirv->DescriptorBindings()) {
 					auto it = _descriptorBindings.find(id);
 					if (it != _descriptorBindings.end()) {
 						if (it->second.binding == binding.binding && it->second.set == binding.set) {
@@ -103,7 +142,7 @@ namespace vrg {
 
 	public:
 
-		inline Pipeline(vrg::Device& device, std::string name, std::vector<std::shared_ptr<SpirvModule>>& modules)
+		inline Pipeline(vrg::Device& device, std::string name, const std::vector<std::shared_ptr<SpirvModule>>& modules)
 			: DeviceResource(device, name), _modules(modules) {
 			createStages();
 		}
@@ -123,6 +162,26 @@ namespace vrg {
 
 		virtual vk::PipelineBindPoint BindPoint() const = 0;
 
+		// Creates a pipeline with the same state as this one from different shader modules. Only reads this pipeline, safe to call from a worker thread
+		virtual std::shared_ptr<Pipeline> Rebuild(const std::vector<std::shared_ptr<SpirvModule>>& modules) const = 0;
+
+		// Exchanges every handle and all reflected state with other, which has to be the same kind of pipeline.
+		// Descriptor sets allocated from the old layouts have to be recreated afterwards. No other thread may record
+		// with either pipeline meanwhile, ShaderManager::Update swaps on the thread that records
+		inline virtual void Swap(Pipeline& other) {
+			std::swap(_modules, other._modules);
+			std::swap(_stages, other._stages);
+			std::swap(_stageHashes, other._stageHashes);
+			std::swap(_specializations, other._specializations);
+			std::swap(_descriptorSetLayouts, other._descriptorSetLayouts);
+			std::swap(_descriptorBindings, other._descriptorBindings);
+			std::swap(_pushConstants, other._pushConstants);
+			std::swap(_pushConstantRanges, other._pushConstantRanges);
+			std::swap(_layout, other._layout);
+			std::swap(_pipeline, other._pipeline);
+			std::swap(_hash, other._hash);
+		}
+
 		inline const vk::Pipeline& operator*() const { return _pipeline; }
 		inline const vk::Pipeline* operator->() const { return &_pipeline; }
 		inline operator bool() const { return _pipeline; }
@@ -130,6 +189,8 @@ namespace vrg {
 		inline bool operator==(const Pipeline& rhs) const { return rhs._pipeline == _pipeline; }
 
 		inline size_t Hash() const { return _hash; }
+		// True the first time it is called, used to record each pipeline once
+		inline bool MarkUsed() { return !_used.exchange(true); }
 		inline const auto& SpirvModules() const { return _modules; }
 		inline vk::PipelineLayout Layout() const { return _layout; }
 		inline const auto& DescriptorSetLayouts() const { return _descriptorSetLayouts; }
@@ -145,6 +206,55 @@ namespace vrg {
 		}
 	};
 
+	// Fixed function state of a graphics pipeline, which together with its shaders and render pass is enough to create it again
+	struct GraphicsPipelineState {
+		uint32_t subpassIndex = 0;
+		vk::CullModeFlags cullMode;
+		vk::PolygonMode polygonMode;
+		vk::PipelineDepthStencilStateCreateInfo depthStencilState;
+		std::vector<vk::PipelineColorBlendAttachmentState> blendStates;
+		std::vector<vk::DynamicState> dynamicStates;
+		vk::PrimitiveTopology topology;
+		std::vector<vk::VertexInputBindingDescription> vertexBindings;
+		std::unordered_map<VertexAttributeId, Geometry::Attribute> vertexAttributes;
+	};
+
+	// Pipeline handle shared by every GraphicsPipeline with equal content, see Device::GetPipeline. Destroyed with the last of them.
+	// Built from library parts it starts out fast linked and switches to the optimized link once that is done
+	struct SharedPipeline {
+		vk::Device device;
+		vk::Pipeline pipeline;
+		//keeps the cached parts alive while a pipeline made from them exists
+		PipelineLibrary::Parts parts;
+		//set before the entry is shared, Current swaps in the result
+		std::shared_ptr<PipelineLibrary::PendingLink> optimizedLink;
+		std::atomic<bool> linkPending = false;
+		std::mutex linkMutex;
+		vk::Pipeline optimized;
+
+		inline ~SharedPipeline() {
+			if (pipeline) device.destroyPipeline(pipeline);
+			if (optimized) device.destroyPipeline(optimized);
+		}
+
+		// The handle to bind, the optimized link once it is done. Command buffers are recorded on several threads,
+		// binds only take the mutex while linkPending is set
+		inline vk::Pipeline Current() {
+			if (linkPending.load(std::memory_order_acquire)) {
+				std::scoped_lock lock(linkMutex);
+				if (optimizedLink && optimizedLink->done.load(std::memory_order_acquire)) {
+					optimized = std::exchange(optimizedLink->pipeline, nullptr);
+					optimizedLink.reset();
+					linkPending.store(false, std::memory_order_release);
+				}
+				else {
+					return pipeline;
+				}
+			}
+			return optimized ? optimized : pipeline;
+		}
+	};
+
 	class GraphicsPipeline : public Pipeline {
 	private:
 		std::vector<vk::PipelineColorBlendAttachmentState> _blendStates;
@@ -159,8 +269,25 @@ namespace vrg {
 		uint32_t _renderQueue;
 		uint32_t _subpassIndex;
 
-		inline virtual void createPipeline(const vrg::RenderPass& renderPass, const vrg::Geometry& geometry) {
+		//owns _pipeline, other pipelines with equal content use the same one
+		std::shared_ptr<SharedPipeline> _shared;
+
+		//kept so the pipeline can be rebuilt with new shaders, the render pass has to outlive the pipeline
+		vk::RenderPass _renderPass;
+		std::string _renderPassName;
+		size_t _renderPassHash = 0;
+		vk::PrimitiveTopology _topology;
+		std::unordered_map<VertexAttributeId, Geometry::Attribute> _vertexAttributes;
+		std::vector<vk::VertexInputBindingDescription> _vertexBindings;
+
+		inline GraphicsPipeline(const GraphicsPipeline& source, const std::vector<std::shared_ptr<SpirvModule>>& modules)
+			: Pipeline(source._device, source.Name(), modules), _blendStates(source._blendStates), _depthStencilState(source._depthStencilState), _dynamicStates(source._dynamicStates),
+			_multiSampleState(source._multiSampleState), _cullMode(source._cullMode), _polygonMode(source._polygonMode), _subpassIndex(source._subpassIndex),
+			_renderPass(source._renderPass), _renderPassName(source._renderPassName), _renderPassHash(source._renderPassHash), _topology(source._topology), _vertexAttributes(source._vertexAttributes), _vertexBindings(source._vertexBindings) {
+			createPipeline();
+		}
 
+		inline void setRenderPass(const vrg::RenderPass& renderPass) {
 			vk::SampleCountFlagBits sampleCount = vk::SampleCountFlagBits::e1;
 
 			std::vector<vk::PipelineColorBlendAttachmentState> blendStates;
@@ -178,38 +305,221 @@ namespace vrg {
 				}
 			}
 
-			vk::GraphicsPipelineCreateInfo pipelineInfo = {};
+			_multiSampleState = { {}, sampleCount, false };
+			_renderPass = *renderPass;
+			_renderPassName = renderPass.Name();
+			_renderPassHash = renderPass.CompatibilityHash();
+		}
+
+		inline void createPipeline(const vrg::RenderPass& renderPass, const vrg::Geometry& geometry) {
+			setRenderPass(renderPass);
+			_topology = geometry.primitiveTopology;
+			_vertexAttributes = geometry.attributes;
+			_vertexBindings.clear();
+			for (auto& [binding, buffer] : geometry.bindings) {
+				_vertexBindings.emplace_back(binding, (uint32_t)buffer.first.Stride(), buffer.second);
+			}
+			createPipeline();
+		}
 
-#pragma region Vertex Input Attributes
-			std::pair<std::vector<vk::VertexInputAttributeDescription>, std::vector<vk::VertexInputBindingDescription>> vertexInput = {};
+		inline std::vector<vk::VertexInputAttributeDescription> vertexAttributes(const std::unordered_map<VertexAttributeId, Geometry::Attribute>& attributes) const {
+			std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
 			auto spirvit = std::ranges::find_if(_modules, [&](const std::shared_ptr<vrg::SpirvModule> m) { return m->_stage == vk::ShaderStageFlagBits::eVertex; });
 			if (spirvit == _modules.end()) {
 				throw std::runtime_error("Could not find vertex stage in graphics pipeline");
 			}
 
 			const vrg::SpirvModule& vs = **spirvit;
-			for (auto& [id, attribute] : geometry.attributes) {
-				auto it = std::ranges::find_if(vs._stageInputs, [&](const auto& p) { return p.second.attributeId == id; });
-				if (it != vs._stageInputs.end()) {
-					vertexInput.first.emplace_back(it->second.location, attribute.binding, attribute.format, (uint32_t)attribute.offset);
+			for (auto& [id, attribute] : attributes) {
+				auto it = std::ranges::find_if(vs.StageInputs(), [&](const auto& p) { return p.second.attributeId == id; });
+				if (it != vs.StageInputs().end()) {
+					vertexAttributes.emplace_back(it->second.location, attribute.binding, attribute.format, (uint32_t)attribute.offset);
 				}
 			}
-			vertexInput.second.resize(geometry.bindings.size());
-			for (uint32_t i = 0; auto& [binding, buffer] : geometry.bindings) {
-				vertexInput.second[i].binding = binding;
-				vertexInput.second[i].stride = buffer.first.Stride();
-				vertexInput.second[i].inputRate = buffer.second;
-				++i;
+			std::ranges::sort(vertexAttributes, {}, &vk::VertexInputAttributeDescription::location);
+			return vertexAttributes;
+		}
+
+		inline static bool supported(const Device& device, vk::DynamicState state) {
+			const Device::DynamicStateSupport& support = device.DynamicStates();
+			switch (state) {
+			case vk::DynamicState::eCullModeEXT:
+			case vk::DynamicState::ePrimitiveTopologyEXT:
+			case vk::DynamicState::eDepthTestEnableEXT:
+			case vk::DynamicState::eDepthWriteEnableEXT:
+			case vk::DynamicState::eDepthCompareOpEXT:
+				return support.extendedDynamicState;
+			case vk::DynamicState::ePrimitiveRestartEnableEXT:
+				return support.extendedDynamicState2;
+			case vk::DynamicState::ePolygonModeEXT:
+				return support.polygonMode;
+			case vk::DynamicState::eVertexInputEXT:
+				return support.vertexInput;
+			default:
+				//core state, or an extension the caller enabled itself
+				return true;
+			}
+		}
+
+		//dynamic topology only has to match the class, a triangle list pipeline can draw strips
+		inline static uint32_t topologyClass(vk::PrimitiveTopology topology) {
+			switch (topology) {
+			case vk::PrimitiveTopology::ePointList:
+				return 0;
+			case vk::PrimitiveTopology::eLineList:
+			case vk::PrimitiveTopology::eLineStrip:
+			case vk::PrimitiveTopology::eLineListWithAdjacency:
+			case vk::PrimitiveTopology::eLineStripWithAdjacency:
+				return 1;
+			case vk::PrimitiveTopology::ePatchList:
+				return 3;
+			default:
+				return 2;
+			}
+		}
+
+		//everything the pipeline bakes, by content so pipelines created with equal state share a handle through Device::GetPipeline.
+		//State that is dynamic is left out so permutations of it share one too
+		inline void hashState(const std::vector<vk::VertexInputAttributeDescription>& attributes) {
+			_hash = hash_combine(_hash, _renderPassHash, _subpassIndex, _multiSampleState.rasterizationSamples);
+			for (const auto& blend : _blendStates) {
+				_hash = hash_combine(_hash, blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+					blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp, (uint32_t)blend.colorWriteMask);
+			}
+			for (vk::DynamicState state : _dynamicStates) {
+				_hash = hash_combine(_hash, state);
+			}
+			if (!IsDynamic(vk::DynamicState::eCullModeEXT)) _hash = hash_combine(_hash, (uint32_t)_cullMode);
+			if (!IsDynamic(vk::DynamicState::ePolygonModeEXT)) _hash = hash_combine(_hash, _polygonMode);
+			if (!IsDynamic(vk::DynamicState::eDepthTestEnableEXT)) _hash = hash_combine(_hash, _depthStencilState.depthTestEnable);
+			if (!IsDynamic(vk::DynamicState::eDepthWriteEnableEXT)) _hash = hash_combine(_hash, _depthStencilState.depthWriteEnable);
+			if (!IsDynamic(vk::DynamicState::eDepthCompareOpEXT)) _hash = hash_combine(_hash, _depthStencilState.depthCompareOp);
+			_hash = hash_combine(_hash, _depthStencilState.stencilTestEnable, _depthStencilState.depthBoundsTestEnable);
+			_hash = hash_combine(_hash, IsDynamic(vk::DynamicState::ePrimitiveTopologyEXT) ? topologyClass(_topology) : (uint32_t)_topology);
+			if (!IsDynamic(vk::DynamicState::eVertexInputEXT)) {
+				for (const auto& binding : _vertexBindings) {
+					_hash = hash_combine(_hash, binding.binding, binding.stride, binding.inputRate);
+				}
+				for (const auto& attribute : attributes) {
+					_hash = hash_combine(_hash, attribute.location, attribute.binding, attribute.format, attribute.offset);
+				}
+			}
+		}
+
+		//splits pipelineInfo into the four library parts, reusing cached ones, and fast links them into shared
+		inline void linkPipeline(PipelineLibrary& library, SharedPipeline& shared, const vk::GraphicsPipelineCreateInfo& pipelineInfo, const std::vector<vk::VertexInputAttributeDescription>& attributes) {
+			//layouts are compared by definition, every pipeline creates its own
+			size_t layoutKey = 0;
+			for (const auto& setLayout : _descriptorSetLayouts) {
+				std::map<uint32_t, DescriptorSetLayout::Binding> bindings(setLayout->Bindings().begin(), setLayout->Bindings().end());
+				layoutKey = hash_combine(layoutKey, bindings.size());
+				for (const auto& [index, binding] : bindings) {
+					layoutKey = hash_combine(layoutKey, index, binding.descriptorType, (uint32_t)binding.stageFlags, binding.descriptorCount);
+				}
+			}
+			for (const auto& range : _pushConstantRanges) {
+				layoutKey = hash_combine(layoutKey, (uint32_t)range.stageFlags, range.offset, range.size);
+			}
+			size_t dynamicKey = 0;
+			for (vk::DynamicState state : _dynamicStates) {
+				dynamicKey = hash_combine(dynamicKey, state);
+			}
+
+			std::vector<vk::PipelineShaderStageCreateInfo> preRasterizationStages, fragmentStages;
+			size_t preRasterizationKey = 0, fragmentKey = 0;
+			for (size_t i = 0; i < _modules.size(); i++) {
+				bool fragment = _modules[i]->_stage == vk::ShaderStageFlagBits::eFragment;
+				(fragment ? fragmentStages : preRasterizationStages).push_back(_stages[i]);
+				size_t& stageKey = fragment ? fragmentKey : preRasterizationKey;
+				stageKey = hash_combine(stageKey, _stageHashes[i]);
 			}
-			std::ranges::sort(vertexInput.first, {}, &vk::VertexInputAttributeDescription::location);
-#pragma endregion
 
-			vk::PipelineVertexInputStateCreateInfo vertexInfo({}, vertexInput.second, vertexInput.first);
+			using Flag = vk::GraphicsPipelineLibraryFlagBitsEXT;
+			PipelineLibrary::Parts parts;
+
+			vk::GraphicsPipelineCreateInfo info = {};
+			info.pDynamicState = pipelineInfo.pDynamicState;
+			info.pVertexInputState = pipelineInfo.pVertexInputState;
+			info.pInputAssemblyState = pipelineInfo.pInputAssemblyState;
+			size_t key = hash_combine(Flag::eVertexInputInterface, dynamicKey, _inputAssemblyState.primitiveRestartEnable,
+				IsDynamic(vk::DynamicState::ePrimitiveTopologyEXT) ? topologyClass(_topology) : (uint32_t)_topology);
+			if (!IsDynamic(vk::DynamicState::eVertexInputEXT)) {
+				for (const auto& binding : _vertexBindings) key = hash_combine(key, binding.binding, binding.stride, binding.inputRate);
+				for (const auto& attribute : attributes) key = hash_combine(key, attribute.location, attribute.binding, attribute.format, attribute.offset);
+			}
+			parts[0] = library.GetPart(Name(), key, Flag::eVertexInputInterface, info, {}, {});
+
+			info = vk::GraphicsPipelineCreateInfo();
+			info.pDynamicState = pipelineInfo.pDynamicState;
+			info.setStages(preRasterizationStages);
+			info.pViewportState = pipelineInfo.pViewportState;
+			info.pRasterizationState = pipelineInfo.pRasterizationState;
+			info.renderPass = _renderPass;
+			info.subpass = _subpassIndex;
+			key = hash_combine(Flag::ePreRasterizationShaders, dynamicKey, layoutKey, preRasterizationKey, _renderPassHash, _subpassIndex);
+			if (!IsDynamic(vk::DynamicState::eCullModeEXT)) key = hash_combine(key, (uint32_t)_cullMode);
+			if (!IsDynamic(vk::DynamicState::ePolygonModeEXT)) key = hash_combine(key, _polygonMode);
+			parts[1] = library.GetPart(Name(), key, Flag::ePreRasterizationShaders, info, _descriptorSetLayouts, _pushConstantRanges);
+
+			info = vk::GraphicsPipelineCreateInfo();
+			info.pDynamicState = pipelineInfo.pDynamicState;
+			info.setStages(fragmentStages);
+			info.pDepthStencilState = pipelineInfo.pDepthStencilState;
+			info.pMultisampleState = pipelineInfo.pMultisampleState;
+			info.renderPass = _renderPass;
+			info.subpass = _subpassIndex;
+			key = hash_combine(Flag::eFragmentShader, dynamicKey, layoutKey, fragmentKey, _renderPassHash, _subpassIndex, _multiSampleState.rasterizationSamples,
+				_depthStencilState.stencilTestEnable, _depthStencilState.depthBoundsTestEnable);
+			if (!IsDynamic(vk::DynamicState::eDepthTestEnableEXT)) key = hash_combine(key, _depthStencilState.depthTestEnable);
+			if (!IsDynamic(vk::DynamicState::eDepthWriteEnableEXT)) key = hash_combine(key, _depthStencilState.depthWriteEnable);
+			if (!IsDynamic(vk::DynamicState::eDepthCompareOpEXT)) key = hash_combine(key, _depthStencilState.depthCompareOp);
+			parts[2] = library.GetPart(Name(), key, Flag::eFragmentShader, info, _descriptorSetLayouts, _pushConstantRanges);
+
+			info = vk::GraphicsPipelineCreateInfo();
+			info.pDynamicState = pipelineInfo.pDynamicState;
+			info.pColorBlendState = pipelineInfo.pColorBlendState;
+			info.pMultisampleState = pipelineInfo.pMultisampleState;
+			info.renderPass = _renderPass;
+			info.subpass = _subpassIndex;
+			key = hash_combine(Flag::eFragmentOutputInterface, dynamicKey, _renderPassHash, _subpassIndex, _multiSampleState.rasterizationSamples);
+			for (const auto& blend : _blendStates) {
+				key = hash_combine(key, blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+					blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp, (uint32_t)blend.colorWriteMask);
+			}
+			parts[3] = library.GetPart(Name(), key, Flag::eFragmentOutputInterface, info, {}, {});
+
+			shared.parts = parts;
+			if (!library.FastLinking()) {
+				//an unoptimized link wouldn't be faster, link once with optimizations
+				shared.pipeline = library.Link(Name(), _hash, parts, true);
+				return;
+			}
+			shared.pipeline = library.Link(Name(), _hash, parts, false);
+			shared.optimizedLink = library.LinkOptimized(Name(), _hash, parts);
+			shared.linkPending.store(true, std::memory_order_release);
+		}
 
-			_inputAssemblyState = { {}, geometry.primitiveTopology };
+		inline void createPipeline() {
+			vk::GraphicsPipelineCreateInfo pipelineInfo = {};
+
+			for (vk::DynamicState state : _dynamicStates) {
+				if (!supported(_device, state)) {
+					throw std::invalid_argument("Graphics pipeline " + Name() + " uses dynamic state " + vk::to_string(state) + " which the device does not support");
+				}
+			}
+
+			//with dynamic vertex input the attributes are set per draw by CommandBuffer::SetVertexInput
+			std::vector<vk::VertexInputAttributeDescription> attributes;
+			if (!IsDynamic(vk::DynamicState::eVertexInputEXT)) {
+				attributes = vertexAttributes(_vertexAttributes);
+			}
+			hashState(attributes);
+
+			vk::PipelineVertexInputStateCreateInfo vertexInfo({}, _vertexBindings, attributes);
+
+			_inputAssemblyState = { {}, _topology };
 			_viewportState = { {}, 1, nullptr, 1, nullptr };
 			_rasterizationState = { {}, false, false, _polygonMode, _cullMode };
-			_multiSampleState = { {}, sampleCount, false };
 			vk::PipelineColorBlendStateCreateInfo blendState({}, false, vk::LogicOp::eCopy, _blendStates);
 			vk::PipelineDynamicStateCreateInfo dynamicState({}, _dynamicStates);
 
@@ -222,20 +532,27 @@ namespace vrg {
 			pipelineInfo.pDepthStencilState = &_depthStencilState;
 			pipelineInfo.pColorBlendState = &blendState;
 			pipelineInfo.pDynamicState = &dynamicState;
-			pipelineInfo.pVertexInputState = &vertexInfo;
+			pipelineInfo.pVertexInputState = IsDynamic(vk::DynamicState::eVertexInputEXT) ? nullptr : &vertexInfo;
 			pipelineInfo.layout = _layout;
-			pipelineInfo.renderPass = *renderPass;
+			pipelineInfo.renderPass = _renderPass;
 			pipelineInfo.subpass = _subpassIndex;
 
 			pipelineInfo.basePipelineHandle = nullptr;
 			pipelineInfo.basePipelineIndex = -1;
 
-			vk::ResultValue<vk::Pipeline> result = _device->createGraphicsPipeline(nullptr, pipelineInfo);
-			_pipeline = result.value;
-			if(result.result != vk::Result::eSuccess) {
-				//errf_color(ConsoleColor::Red, "Failed to create graphics pipeline");
-				throw std::runtime_error("Failed to create graphics pipeline");
-			}
+			//created once per content, pipelines that only differ in dynamic state get the handle the first one made
+			_shared = _device.GetPipeline(_hash, [&]() {
+				auto shared = std::make_shared<SharedPipeline>();
+				shared->device = *_device;
+				if (PipelineLibrary* library = _device.PipelineLibraries()) {
+					linkPipeline(*library, *shared, pipelineInfo, attributes);
+				}
+				else {
+					shared->pipeline = _device.Telemetry().CreateGraphicsPipeline(Name(), _hash, pipelineInfo);
+				}
+				return shared;
+			});
+			_pipeline = _shared->pipeline;
 			//PrintSuccessMessage();
 		}
 
@@ -270,7 +587,131 @@ namespace vrg {
 		}
 
 
+		// Recreates a pipeline from the State of an earlier one, the render pass has to be compatible with the one it was made for
+		inline GraphicsPipeline(vrg::Device& device, std::string name, const vrg::RenderPass& renderPass, const std::vector<std::shared_ptr<SpirvModule>>& modules, const GraphicsPipelineState& state)
+			: Pipeline(device, name, modules), _subpassIndex(state.subpassIndex), _cullMode(state.cullMode), _polygonMode(state.polygonMode),
+			_depthStencilState(state.depthStencilState), _blendStates(state.blendStates), _dynamicStates(state.dynamicStates),
+			_topology(state.topology), _vertexAttributes(state.vertexAttributes), _vertexBindings(state.vertexBindings) {
+			_depthStencilState.pNext = nullptr;
+			setRenderPass(renderPass);
+			createPipeline();
+		}
+
+		// The core dynamic states plus every extended one the device supports. Pipelines created with these only differ in
+		// shaders, render pass and blending, the rest is set on the CommandBuffer
+		inline static std::vector<vk::DynamicState> ExtendedDynamicStates(const Device& device) {
+			std::vector<vk::DynamicState> states = { vk::DynamicState::eViewport, vk::DynamicState::eScissor, vk::DynamicState::eLineWidth };
+			for (vk::DynamicState state : { vk::DynamicState::eCullModeEXT, vk::DynamicState::ePrimitiveTopologyEXT, vk::DynamicState::eDepthTestEnableEXT,
+				vk::DynamicState::eDepthWriteEnableEXT, vk::DynamicState::eDepthCompareOpEXT, vk::DynamicState::ePrimitiveRestartEnableEXT,
+				vk::DynamicState::ePolygonModeEXT, vk::DynamicState::eVertexInputEXT }) {
+				if (supported(device, state)) states.push_back(state);
+			}
+			return states;
+		}
+
 		inline vk::PipelineBindPoint BindPoint() const override { return vk::PipelineBindPoint::eGraphics; }
+
+		inline std::shared_ptr<Pipeline> Rebuild(const std::vector<std::shared_ptr<SpirvModule>>& modules) const override {
+			return std::shared_ptr<GraphicsPipeline>(new GraphicsPipeline(*this, modules));
+		}
+
+		inline ~GraphicsPipeline() {
+			//destroyed by _shared
+			_pipeline = nullptr;
+		}
+
+		inline void Swap(Pipeline& other) override {
+			Pipeline::Swap(other);
+			std::swap(_shared, static_cast<GraphicsPipeline&>(other)._shared);
+		}
+
+		// The handle to bind, switches to the link time optimized pipeline once its background link is done.
+		// Binds on several threads at once are safe, swaps are not, see Swap
+		inline vk::Pipeline UpgradeLink() { return _shared->Current(); }
+
+		inline GraphicsPipelineState State() const {
+			return { _subpassIndex, _cullMode, _polygonMode, _depthStencilState, _blendStates, _dynamicStates, _topology, _vertexBindings, _vertexAttributes };
+		}
+		inline const std::string& RenderPassName() const { return _renderPassName; }
+
+		inline bool IsDynamic(vk::DynamicState state) const { return std::ranges::find(_dynamicStates, state) != _dynamicStates.end(); }
+		inline const std::vector<vk::DynamicState>& DynamicStates() const { return _dynamicStates; }
+
+		// The state the pipeline was created with. Dynamic ones are set to these when the pipeline is bound
+		inline vk::CullModeFlags CullMode() const { return _cullMode; }
+		inline vk::PolygonMode PolygonMode() const { return _polygonMode; }
+		inline vk::PrimitiveTopology Topology() const { return _topology; }
+		inline const vk::PipelineDepthStencilStateCreateInfo& DepthStencilState() const { return _depthStencilState; }
+		inline bool PrimitiveRestart() const { return _inputAssemblyState.primitiveRestartEnable; }
+
+		// Vertex input descriptions for drawing geometry with this pipeline's vertex shader, used with dynamic vertex input
+		inline void VertexInput(const Geometry& geometry, std::vector<vk::VertexInputBindingDescription2EXT>& bindings, std::vector<vk::VertexInputAttributeDescription2EXT>& attributes) const {
+			bindings.clear();
+			attributes.clear();
+			for (auto& [binding, buffer] : geometry.bindings) {
+				bindings.emplace_back(binding, (uint32_t)buffer.first.Stride(), buffer.second, 1);
+			}
+			for (const auto& attribute : vertexAttributes(geometry.attributes)) {
+				attributes.emplace_back(attribute.location, attribute.binding, attribute.format, attribute.offset);
+			}
+		}
+		// Same for the geometry the pipeline was created with
+		inline void VertexInput(std::vector<vk::VertexInputBindingDescription2EXT>& bindings, std::vector<vk::VertexInputAttributeDescription2EXT>& attributes) const {
+			bindings.clear();
+			attributes.clear();
+			for (const auto& binding : _vertexBindings) {
+				bindings.emplace_back(binding.binding, binding.stride, binding.inputRate, 1);
+			}
+			for (const auto& attribute : vertexAttributes(_vertexAttributes)) {
+				attributes.emplace_back(attribute.location, attribute.binding, attribute.format, attribute.offset);
+			}
+		}
+	};
+
+	class ComputePipeline : public Pipeline {
+	private:
+		vk::Extent3D _workgroupSize;
+
+	public:
+		inline ComputePipeline(vrg::Device& device, std::string name, const std::shared_ptr<SpirvModule>& module)
+			: Pipeline(device, name, { module }) {
+			if (module->_stage != vk::ShaderStageFlagBits::eCompute) {
+				throw std::invalid_argument("Compute pipeline " + name + " requires a compute stage module");
+			}
+
+			//dimensions declared through specialization constants take the value the module is specialized with
+			const SpirvReflection& reflection = module->Reflection();
+			uint32_t size[3];
+			for (uint32_t i = 0; i < 3; i++) {
+				size[i] = reflection.workgroupSize[i];
+				auto it = module->_specializationConstants.find(reflection.workgroupSizeConstants[i]);
+				if (it != module->_specializationConstants.end()) size[i] = (uint32_t)it->second;
+			}
+			_workgroupSize = vk::Extent3D(size[0], size[1], size[2]);
+
+			vk::ComputePipelineCreateInfo pipelineInfo({}, _stages[0], _layout);
+			_pipeline = _device.Telemetry().CreateComputePipeline(Name(), _hash, pipelineInfo);
+		}
+
+		inline vk::PipelineBindPoint BindPoint() const override { return vk::PipelineBindPoint::eCompute; }
+
+		inline std::shared_ptr<Pipeline> Rebuild(const std::vector<std::shared_ptr<SpirvModule>>& modules) const override {
+			return std::make_shared<ComputePipeline>(_device, Name(), modules.at(0));
+		}
+
+		inline void Swap(Pipeline& other) override {
+			Pipeline::Swap(other);
+			std::swap(_workgroupSize, static_cast<ComputePipeline&>(other)._workgroupSize);
+		}
+
+		inline const vk::Extent3D& WorkgroupSize() const { return _workgroupSize; }
+		// Workgroups needed to cover threads invocations in each dimension
+		inline vk::Extent3D GroupCount(const vk::Extent3D& threads) const {
+			return vk::Extent3D(
+				(threads.width + _workgroupSize.width - 1) / _workgroupSize.width,
+				(threads.height + _workgroupSize.height - 1) / _workgroupSize.height,
+				(threads.depth + _workgroupSize.depth - 1) / _workgroupSize.depth);
+		}
 	};
 }
 
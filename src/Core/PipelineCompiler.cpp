@@ -0,0 +1,63 @@
+#include "PipelineCompiler.hpp"
+
+using namespace vrg;
+
+PipelineCompiler::PipelineCompiler(uint32_t threadCount) : _pool(threadCount) {}
+
+PipelineCompiler::~PipelineCompiler() {
+	std::unique_lock lock(_mutex);
+	_idle.wait(lock, [&]() { return _completed.load() == _queued.load(); });
+}
+
+std::shared_ptr<AsyncPipeline> PipelineCompiler::Compile(const std::string& name, std::function<std::shared_ptr<Pipeline>()> create, std::shared_ptr<Pipeline> fallback, ReadyCallback onReady) {
+	auto pipeline = std::shared_ptr<AsyncPipeline>(new AsyncPipeline(name, std::move(fallback)));
+	++_queued;
+	_pool.Submit([this, pipeline, create = std::move(create), onReady = std::move(onReady)]() {
+		std::shared_ptr<Pipeline> result;
+		std::string error;
+		try {
+			result = create();
+			if (!result) error = "create returned no pipeline";
+		}
+		catch (const std::exception& e) {
+			error = e.what();
+		}
+		{
+			std::scoped_lock lock(pipeline->_mutex);
+			pipeline->_pipeline = result;
+			pipeline->_error = error;
+			pipeline->_status = result ? AsyncPipeline::Status::Ready : AsyncPipeline::Status::Failed;
+		}
+		if (!result) {
+			errf_color(ConsoleColor::Red, "Failed to compile pipeline %s: %s\n", pipeline->Name().c_str(), error.c_str());
+		}
+		{
+			std::scoped_lock lock(_mutex);
+			_finished.emplace_back(pipeline, onReady);
+			++_completed;
+		}
+		_idle.notify_all();
+	});
+	return pipeline;
+}
+
+size_t PipelineCompiler::Poll() {
+	std::vector<std::pair<std::shared_ptr<AsyncPipeline>, ReadyCallback>> finished;
+	{
+		std::scoped_lock lock(_mutex);
+		finished.swap(_finished);
+	}
+	//outside the lock, callbacks may queue more pipelines
+	for (auto& [pipeline, onReady] : finished) {
+		if (onReady) onReady(pipeline);
+	}
+	return finished.size();
+}
+
+void PipelineCompiler::WaitIdle() {
+	{
+		std::unique_lock lock(_mutex);
+		_idle.wait(lock, [&]() { return _completed.load() == _queued.load(); });
+	}
+	Poll();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include "ThreadPool.hpp"
+
+namespace vrg {
+
+	// Handle to a pipeline that is built by a PipelineCompiler. Until it is ready Get returns the fallback, which may be null
+	class AsyncPipeline {
+	public:
+		enum class Status {
+			Pending,
+			Ready,
+			Failed
+		};
+
+		inline const std::string& Name() const { return _name; }
+		inline Status State() const {
+			std::scoped_lock lock(_mutex);
+			return _status;
+		}
+		inline bool Ready() const { return State() == Status::Ready; }
+		inline bool Failed() const { return State() == Status::Failed; }
+		// Message of the exception the create function threw
+		inline std::string Error() const {
+			std::scoped_lock lock(_mutex);
+			return _error;
+		}
+
+		inline std::shared_ptr<Pipeline> Get() const {
+			std::scoped_lock lock(_mutex);
+			return _pipeline ? _pipeline : _fallback;
+		}
+		// Used while the pipeline is pending or if it failed
+		inline void SetFallback(std::shared_ptr<Pipeline> fallback) {
+			std::scoped_lock lock(_mutex);
+			_fallback = std::move(fallback);
+		}
+
+	private:
+		friend class PipelineCompiler;
+
+		inline AsyncPipeline(const std::string& name, std::shared_ptr<Pipeline> fallback) : _name(name), _fallback(std::move(fallback)) {}
+
+		std::string _name;
+		mutable std::mutex _mutex;
+		Status _status = Status::Pending;
+		std::shared_ptr<Pipeline> _pipeline;
+		std::shared_ptr<Pipeline> _fallback;
+		std::string _error;
+	};
+
+	// Creates pipelines on worker threads. Every pipeline goes through the device's pipeline cache, so pipelines
+	// compiled while loading are cheap to create again later
+	class PipelineCompiler {
+	public:
+		using ReadyCallback = std::function<void(const std::shared_ptr<AsyncPipeline>&)>;
+
+		PipelineCompiler(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency() / 2));
+		// Waits for queued pipelines, callbacks that weren't polled yet are dropped
+		~PipelineCompiler();
+
+		PipelineCompiler(const PipelineCompiler&) = delete;
+		PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+		// create runs on a worker and has to keep everything it references alive until it finished.
+		// onReady is called from Poll once the pipeline is ready or failed
+		std::shared_ptr<AsyncPipeline> Compile(const std::string& name, std::function<std::shared_ptr<Pipeline>()> create,
+			std::shared_ptr<Pipeline> fallback = nullptr, ReadyCallback onReady = {});
+
+		// Runs the callbacks of pipelines finished since the last call on the calling thread, returns how many finished
+		size_t Poll();
+		// Blocks until every queued pipeline is finished and polls, for loading screens
+		void WaitIdle();
+
+		struct Progress {
+			size_t completed;
+			size_t total;
+		};
+		// Counts every pipeline queued so far, failed ones count as completed
+		inline Progress GetProgress() const { return { _completed.load(), _queued.load() }; }
+		inline bool Idle() const { return _completed.load() == _queued.load(); }
+
+	private:
+		std::atomic<size_t> _queued = 0;
+		std::atomic<size_t> _completed = 0;
+
+		std::mutex _mutex;
+		std::vector<std::pair<std::shared_ptr<AsyncPipeline>, ReadyCallback>> _finished;
+		std::condition_variable _idle;
+
+		//last member so the workers are joined before anything they use is destroyed
+		ThreadPool _pool;
+	};
+
+}
@@ -0,0 +1,73 @@
+#include "PipelineLibrary.hpp"
+#include "PipelineTelemetry.hpp"
+
+using namespace vrg;
+
+PipelineLibrary::PipelineLibrary(Device& device, bool fastLinking) : _device(device), _fastLinking(fastLinking), _pool(1) {}
+
+std::shared_ptr<const PipelineLibrary::Part> PipelineLibrary::GetPart(const std::string& name, size_t key, vk::GraphicsPipelineLibraryFlagsEXT flags, vk::GraphicsPipelineCreateInfo info,
+	const std::vector<std::shared_ptr<const DescriptorSetLayout>>& setLayouts, const std::vector<vk::PushConstantRange>& pushConstantRanges) {
+	{
+		std::scoped_lock lock(_mutex);
+		auto it = _parts.find(key);
+		if (it != _parts.end()) {
+			if (std::shared_ptr<const Part> part = it->second.lock()) return part;
+		}
+	}
+
+	//created outside the lock, two threads missing on the same key both compile and the first one is kept
+	auto part = std::make_shared<Part>();
+	part->device = *_device;
+	part->setLayouts = setLayouts;
+	if (flags & (vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders | vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader)) {
+		std::vector<vk::DescriptorSetLayout> layouts(setLayouts.size());
+		std::ranges::transform(setLayouts, layouts.begin(), &DescriptorSetLayout::operator*);
+		part->layout = _device->createPipelineLayout(vk::PipelineLayoutCreateInfo({}, layouts, pushConstantRanges));
+		info.layout = part->layout;
+	}
+
+	vk::GraphicsPipelineLibraryCreateInfoEXT libraryInfo(flags);
+	info.pNext = &libraryInfo;
+	info.flags |= vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+	part->pipeline = _device.Telemetry().CreateGraphicsPipeline(name + " " + vk::to_string(flags), key, info);
+
+	std::scoped_lock lock(_mutex);
+	std::weak_ptr<const Part>& entry = _parts[key];
+	if (std::shared_ptr<const Part> existing = entry.lock()) return existing;
+	entry = part;
+	return part;
+}
+
+vk::Pipeline PipelineLibrary::Link(const std::string& name, size_t hash, const Parts& parts, bool optimize) const {
+	std::array<vk::Pipeline, 4> libraries;
+	std::ranges::transform(parts, libraries.begin(), [](const std::shared_ptr<const Part>& part) { return part->pipeline; });
+	vk::PipelineLibraryCreateInfoKHR linkInfo(libraries);
+
+	vk::GraphicsPipelineCreateInfo info = {};
+	info.pNext = &linkInfo;
+	//identical to the pipeline's own layout, but lives as long as the parts
+	info.layout = parts[1]->layout;
+	if (optimize) info.flags = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+	return _device.Telemetry().CreateGraphicsPipeline(name + (optimize ? " optimized link" : " fast link"), hash, info);
+}
+
+std::shared_ptr<PipelineLibrary::PendingLink> PipelineLibrary::LinkOptimized(const std::string& name, size_t hash, const Parts& parts) {
+	auto link = std::make_shared<PendingLink>();
+	link->device = *_device;
+	_pool.Submit([this, link, name, hash, parts]() {
+		try {
+			link->pipeline = Link(name, hash, parts, true);
+		}
+		catch (const std::exception& e) {
+			//the fast linked pipeline keeps being used
+			errf_color(ConsoleColor::Yellow, "%s\n", e.what());
+		}
+		link->done.store(true, std::memory_order_release);
+	});
+	return link;
+}
+
+void PipelineLibrary::Collect() {
+	std::scoped_lock lock(_mutex);
+	std::erase_if(_parts, [](const auto& entry) { return entry.second.expired(); });
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "DescriptorSet.hpp"
+#include "ThreadPool.hpp"
+
+namespace vrg {
+
+	// Graphics pipeline parts from VK_EXT_graphics_pipeline_library, shared by every pipeline on the device with equal state.
+	// A pipeline built from cached parts is fast linked right away, the link time optimized version is created in the background.
+	// Parts are keyed by content and live as long as a pipeline made from them, Collect drops the expired entries
+	class PipelineLibrary {
+	public:
+		// One compiled part. Pre-rasterization and fragment shader parts own a layout identical to the pipeline's
+		struct Part {
+			vk::Device device;
+			vk::Pipeline pipeline;
+			vk::PipelineLayout layout;
+			std::vector<std::shared_ptr<const DescriptorSetLayout>> setLayouts;
+
+			inline ~Part() {
+				if (pipeline) device.destroyPipeline(pipeline);
+				if (layout) device.destroyPipelineLayout(layout);
+			}
+		};
+		using Parts = std::array<std::shared_ptr<const Part>, 4>;
+
+		// Optimized link running in the background. The owner takes pipeline once done is set, otherwise it is destroyed with this
+		struct PendingLink {
+			vk::Device device;
+			std::atomic<bool> done = false;
+			vk::Pipeline pipeline;
+
+			inline ~PendingLink() {
+				if (pipeline) device.destroyPipeline(pipeline);
+			}
+		};
+
+		PipelineLibrary(Device& device, bool fastLinking);
+
+		PipelineLibrary(const PipelineLibrary&) = delete;
+		PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+		// False if the driver reports that linking without optimization isn't actually faster
+		inline bool FastLinking() const { return _fastLinking; }
+
+		// The cached part for key, created from info on a miss and recorded in the telemetry under name. info has to describe exactly the state of the part,
+		// the library flags and a layout built from setLayouts and pushConstantRanges are filled in here
+		std::shared_ptr<const Part> GetPart(const std::string& name, size_t key, vk::GraphicsPipelineLibraryFlagsEXT flags, vk::GraphicsPipelineCreateInfo info,
+			const std::vector<std::shared_ptr<const DescriptorSetLayout>>& setLayouts, const std::vector<vk::PushConstantRange>& pushConstantRanges);
+
+		// Links the four parts into a complete pipeline, parts are ordered vertex input, pre-rasterization, fragment shader, fragment output
+		vk::Pipeline Link(const std::string& name, size_t hash, const Parts& parts, bool optimize) const;
+		// Queues a link time optimized link, the parts are kept alive until it finished
+		std::shared_ptr<PendingLink> LinkOptimized(const std::string& name, size_t hash, const Parts& parts);
+
+		// Forgets parts no pipeline uses anymore, called by the device once per submit
+		void Collect();
+		inline size_t PartCount() {
+			std::scoped_lock lock(_mutex);
+			return (size_t)std::ranges::count_if(_parts, [](const auto& entry) { return !entry.second.expired(); });
+		}
+
+	private:
+		Device& _device;
+		bool _fastLinking;
+
+		std::mutex _mutex;
+		std::unordered_map<size_t, std::weak_ptr<const Part>> _parts;
+
+		//last member, optimized links in flight finish before anything they use is destroyed
+		ThreadPool _pool;
+	};
+
+}
@@ -0,0 +1,316 @@
+#include "PipelineRecorder.hpp"
+
+using namespace vrg;
+
+static constexpr uint32_t UsageMagic = 0x50475256; //"VRGP"
+
+//records are packed without alignment, every value is written with a fixed width so files move between platforms
+class RecordWriter {
+public:
+	std::vector<std::byte> data;
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	inline void Write(const T& value) {
+		const std::byte* bytes = reinterpret_cast<const std::byte*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
+	inline void Write(const std::string& text) {
+		Write((uint32_t)text.size());
+		const std::byte* bytes = reinterpret_cast<const std::byte*>(text.data());
+		data.insert(data.end(), bytes, bytes + text.size());
+	}
+};
+
+class RecordReader {
+public:
+	std::span<const std::byte> bytes;
+	size_t offset = 0;
+
+	template<typename T> requires std::is_trivially_copyable_v<T>
+	inline T Read() {
+		if (sizeof(T) > bytes.size() - offset) throw std::runtime_error("Pipeline usage record is truncated");
+		T value;
+		memcpy(&value, bytes.data() + offset, sizeof(T));
+		offset += sizeof(T);
+		return value;
+	}
+	inline std::string ReadString() {
+		uint32_t size = Read<uint32_t>();
+		if (size > bytes.size() - offset) throw std::runtime_error("Pipeline usage record is truncated");
+		std::string text(reinterpret_cast<const char*>(bytes.data() + offset), size);
+		offset += size;
+		return text;
+	}
+};
+
+//what Prewarm needs to create a recorded pipeline
+struct Recipe {
+	vk::PipelineBindPoint bindPoint;
+	std::string name;
+	std::vector<ShaderManager::FileRequest> shaders;
+	std::string renderPass;
+	GraphicsPipelineState state;
+};
+
+static void WriteDepthStencil(RecordWriter& writer, const vk::PipelineDepthStencilStateCreateInfo& state) {
+	writer.Write((uint32_t)state.flags);
+	writer.Write((uint32_t)state.depthTestEnable);
+	writer.Write((uint32_t)state.depthWriteEnable);
+	writer.Write((uint32_t)state.depthCompareOp);
+	writer.Write((uint32_t)state.depthBoundsTestEnable);
+	writer.Write((uint32_t)state.stencilTestEnable);
+	//all 32 bit fields
+	writer.Write(state.front);
+	writer.Write(state.back);
+	writer.Write(state.minDepthBounds);
+	writer.Write(state.maxDepthBounds);
+}
+
+static vk::PipelineDepthStencilStateCreateInfo ReadDepthStencil(RecordReader& reader) {
+	vk::PipelineDepthStencilStateCreateInfo state;
+	state.flags = vk::PipelineDepthStencilStateCreateFlags(reader.Read<uint32_t>());
+	state.depthTestEnable = reader.Read<uint32_t>();
+	state.depthWriteEnable = reader.Read<uint32_t>();
+	state.depthCompareOp = (vk::CompareOp)reader.Read<uint32_t>();
+	state.depthBoundsTestEnable = reader.Read<uint32_t>();
+	state.stencilTestEnable = reader.Read<uint32_t>();
+	state.front = reader.Read<vk::StencilOpState>();
+	state.back = reader.Read<vk::StencilOpState>();
+	state.minDepthBounds = reader.Read<float>();
+	state.maxDepthBounds = reader.Read<float>();
+	return state;
+}
+
+static Recipe ReadRecipe(std::span<const std::byte> bytes) {
+	RecordReader reader{ bytes };
+	Recipe recipe;
+	recipe.bindPoint = (vk::PipelineBindPoint)reader.Read<uint32_t>();
+	recipe.name = reader.ReadString();
+	uint32_t shaderCount = reader.Read<uint32_t>();
+	for (uint32_t i = 0; i < shaderCount; i++) {
+		ShaderManager::FileRequest& request = recipe.shaders.emplace_back();
+		request.filename = reader.ReadString();
+		request.stage = (vk::ShaderStageFlagBits)reader.Read<uint32_t>();
+		request.options.name = reader.ReadString();
+		uint32_t defineCount = reader.Read<uint32_t>();
+		for (uint32_t j = 0; j < defineCount; j++) {
+			std::string macro = reader.ReadString();
+			request.options.defines.emplace_back(macro, reader.ReadString());
+		}
+		request.options.entryPoint = reader.ReadString();
+		request.options.optimization = (shaderc_optimization_level)reader.Read<uint32_t>();
+		request.options.stripDebugInfo = reader.Read<uint32_t>();
+		uint32_t constantCount = reader.Read<uint32_t>();
+		for (uint32_t j = 0; j < constantCount; j++) {
+			uint32_t id = reader.Read<uint32_t>();
+			request.options.specializationConstants[id] = reader.Read<uint64_t>();
+		}
+	}
+	if (recipe.bindPoint != vk::PipelineBindPoint::eGraphics) return recipe;
+
+	recipe.renderPass = reader.ReadString();
+	GraphicsPipelineState& state = recipe.state;
+	state.subpassIndex = reader.Read<uint32_t>();
+	state.cullMode = vk::CullModeFlags(reader.Read<uint32_t>());
+	state.polygonMode = (vk::PolygonMode)reader.Read<uint32_t>();
+	state.depthStencilState = ReadDepthStencil(reader);
+	state.blendStates.resize(reader.Read<uint32_t>());
+	for (auto& blend : state.blendStates) blend = reader.Read<vk::PipelineColorBlendAttachmentState>();
+	state.dynamicStates.resize(reader.Read<uint32_t>());
+	for (auto& dynamicState : state.dynamicStates) dynamicState = (vk::DynamicState)reader.Read<uint32_t>();
+	state.topology = (vk::PrimitiveTopology)reader.Read<uint32_t>();
+	state.vertexBindings.resize(reader.Read<uint32_t>());
+	for (auto& binding : state.vertexBindings) binding = reader.Read<vk::VertexInputBindingDescription>();
+	uint32_t attributeCount = reader.Read<uint32_t>();
+	for (uint32_t i = 0; i < attributeCount; i++) {
+		VertexAttributeId id;
+		id.type = (VertexAttributeType)reader.Read<uint32_t>();
+		id.typeIndex = reader.Read<uint32_t>();
+		Geometry::Attribute& attribute = state.vertexAttributes[id];
+		attribute.binding = reader.Read<uint32_t>();
+		attribute.format = (vk::Format)reader.Read<uint32_t>();
+		attribute.offset = reader.Read<uint64_t>();
+	}
+	return recipe;
+}
+
+PipelineRecorder::PipelineRecorder(Device& device, ShaderManager& shaderManager) : _device(device), _shaderManager(shaderManager) {
+	if (_device._pipelineRecorder) {
+		throw std::runtime_error("Device already has a PipelineRecorder");
+	}
+	_device._pipelineRecorder = this;
+}
+
+PipelineRecorder::~PipelineRecorder() {
+	_device._pipelineRecorder = nullptr;
+}
+
+void PipelineRecorder::Record(const Pipeline& pipeline) {
+	RecordWriter writer;
+	writer.Write((uint32_t)pipeline.BindPoint());
+	writer.Write(pipeline.Name());
+	writer.Write((uint32_t)pipeline.SpirvModules().size());
+	for (const auto& module : pipeline.SpirvModules()) {
+		std::optional<ShaderManager::FileRequest> request = _shaderManager.Request(module);
+		if (!request) return;
+		writer.Write(request->filename);
+		writer.Write((uint32_t)request->stage);
+		writer.Write(request->options.name);
+		writer.Write((uint32_t)request->options.defines.size());
+		for (const auto& [macro, value] : request->options.defines) {
+			writer.Write(macro);
+			writer.Write(value);
+		}
+		writer.Write(request->options.entryPoint);
+		writer.Write((uint32_t)request->options.optimization);
+		writer.Write((uint32_t)request->options.stripDebugInfo);
+		writer.Write((uint32_t)request->options.specializationConstants.size());
+		for (const auto& [id, value] : request->options.specializationConstants) {
+			writer.Write(id);
+			writer.Write(value);
+		}
+	}
+
+	if (const GraphicsPipeline* graphics = dynamic_cast<const GraphicsPipeline*>(&pipeline)) {
+		GraphicsPipelineState state = graphics->State();
+		writer.Write(graphics->RenderPassName());
+		writer.Write(state.subpassIndex);
+		writer.Write((uint32_t)state.cullMode);
+		writer.Write((uint32_t)state.polygonMode);
+		WriteDepthStencil(writer, state.depthStencilState);
+		writer.Write((uint32_t)state.blendStates.size());
+		for (const auto& blend : state.blendStates) writer.Write(blend);
+		writer.Write((uint32_t)state.dynamicStates.size());
+		for (vk::DynamicState dynamicState : state.dynamicStates) writer.Write((uint32_t)dynamicState);
+		writer.Write((uint32_t)state.topology);
+		writer.Write((uint32_t)state.vertexBindings.size());
+		for (const auto& binding : state.vertexBindings) writer.Write(binding);
+		//sorted so equal state always gives the same bytes
+		std::vector<std::pair<VertexAttributeId, Geometry::Attribute>> attributes(state.vertexAttributes.begin(), state.vertexAttributes.end());
+		std::ranges::sort(attributes, {}, [](const auto& a) { return std::make_pair((uint32_t)a.first.type, a.first.typeIndex); });
+		writer.Write((uint32_t)attributes.size());
+		for (const auto& [id, attribute] : attributes) {
+			writer.Write((uint32_t)id.type);
+			writer.Write(id.typeIndex);
+			writer.Write(attribute.binding);
+			writer.Write((uint32_t)attribute.format);
+			writer.Write((uint64_t)attribute.offset);
+		}
+	}
+
+	uint64_t key = hash_fnv1a(std::string_view(reinterpret_cast<const char*>(writer.data.data()), writer.data.size()));
+	std::scoped_lock lock(_mutex);
+	_records.emplace(key, std::move(writer.data));
+}
+
+bool PipelineRecorder::Save(const std::filesystem::path& path) const {
+	RecordWriter writer;
+	{
+		std::scoped_lock lock(_mutex);
+		writer.Write(UsageMagic);
+		writer.Write(Version);
+		writer.Write((uint32_t)_records.size());
+		for (const auto& [key, record] : _records) {
+			writer.Write((uint32_t)record.size());
+			writer.data.insert(writer.data.end(), record.begin(), record.end());
+		}
+	}
+
+	//never leave a half written file behind under the real name
+	std::filesystem::path tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size())) {
+			errf_color(ConsoleColor::Red, "Could not write pipeline usage to %s\n", tmpPath.string().c_str());
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) {
+		errf_color(ConsoleColor::Red, "Could not write pipeline usage to %s: %s\n", path.string().c_str(), error.message().c_str());
+		return false;
+	}
+	return true;
+}
+
+size_t PipelineRecorder::Prewarm(const std::filesystem::path& path, PipelineCompiler& compiler, const std::vector<std::shared_ptr<RenderPass>>& renderPasses) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) return 0;
+	std::vector<std::byte> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	RecordReader reader{ data };
+	std::vector<std::pair<uint64_t, std::span<const std::byte>>> records;
+	try {
+		if (reader.Read<uint32_t>() != UsageMagic || reader.Read<uint32_t>() != Version) {
+			//recorded by another build, the next Save replaces it
+			printf_color(ConsoleColor::Yellow, "Ignoring pipeline usage %s from another version\n", path.string().c_str());
+			return 0;
+		}
+		uint32_t count = reader.Read<uint32_t>();
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t size = reader.Read<uint32_t>();
+			if (size > data.size() - reader.offset) throw std::runtime_error("Pipeline usage record is truncated");
+			std::span<const std::byte> record(data.data() + reader.offset, size);
+			reader.offset += size;
+			records.emplace_back(hash_fnv1a(std::string_view(reinterpret_cast<const char*>(record.data()), record.size())), record);
+		}
+	}
+	catch (const std::exception& e) {
+		errf_color(ConsoleColor::Yellow, "Ignoring pipeline usage %s: %s\n", path.string().c_str(), e.what());
+		return 0;
+	}
+
+	size_t queued = 0;
+	for (const auto& [key, bytes] : records) {
+		Recipe recipe;
+		try {
+			recipe = ReadRecipe(bytes);
+		}
+		catch (const std::exception& e) {
+			errf_color(ConsoleColor::Yellow, "Skipping pipeline usage record: %s\n", e.what());
+			continue;
+		}
+		{
+			//kept even if it can't be prewarmed this time, so the next Save doesn't forget it
+			std::scoped_lock lock(_mutex);
+			_records.emplace(key, std::vector<std::byte>(bytes.begin(), bytes.end()));
+		}
+
+		std::shared_ptr<RenderPass> renderPass;
+		if (recipe.bindPoint == vk::PipelineBindPoint::eGraphics) {
+			auto it = std::ranges::find(renderPasses, recipe.renderPass, &RenderPass::Name);
+			if (it == renderPasses.end()) continue;
+			renderPass = *it;
+		}
+		else if (recipe.bindPoint != vk::PipelineBindPoint::eCompute || recipe.shaders.size() != 1) {
+			continue;
+		}
+
+		auto pipeline = compiler.Compile(recipe.name, [this, recipe, renderPass]() -> std::shared_ptr<Pipeline> {
+			std::vector<std::shared_ptr<SpirvModule>> modules;
+			for (const ShaderManager::FileRequest& request : recipe.shaders) {
+				std::shared_ptr<SpirvModule> module = _shaderManager.FetchFile(request.filename, request.stage, request.options);
+				if (!module) throw std::runtime_error("Shader " + request.filename + " failed to compile");
+				modules.push_back(module);
+			}
+			if (recipe.bindPoint == vk::PipelineBindPoint::eCompute) {
+				return std::make_shared<ComputePipeline>(_device, recipe.name, modules[0]);
+			}
+			return std::make_shared<GraphicsPipeline>(_device, recipe.name, *renderPass, modules, recipe.state);
+		});
+		std::scoped_lock lock(_mutex);
+		_prewarmed.push_back(pipeline);
+		queued++;
+	}
+	printf_color(ConsoleColor::Cyan, "Prewarming %zu of %zu recorded pipelines\n", queued, records.size());
+	return queued;
+}
+
+void PipelineRecorder::ReleasePrewarmed() {
+	std::scoped_lock lock(_mutex);
+	_prewarmed.clear();
+}
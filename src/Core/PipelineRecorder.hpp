@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ShaderManager.hpp"
+#include "PipelineCompiler.hpp"
+
+#include <filesystem>
+
+namespace vrg {
+
+	// Records the state of every pipeline bound during a session and writes it to a compact binary file. On the next launch
+	// Prewarm creates those pipelines again on background threads before the first frame needs them. That fills the pipeline
+	// cache, the pipeline library parts and the driver's own caches, also on drivers that ignore vk::PipelineCache data
+	class PipelineRecorder {
+	public:
+		// bump whenever the record layout or GraphicsPipelineState changes
+		static constexpr uint32_t Version = 1;
+
+		// Registers with the device, which reports every pipeline bound from then on. Shaders are stored as the file
+		// and options shaderManager fetched them with
+		PipelineRecorder(Device& device, ShaderManager& shaderManager);
+		~PipelineRecorder();
+
+		PipelineRecorder(const PipelineRecorder&) = delete;
+		PipelineRecorder& operator=(const PipelineRecorder&) = delete;
+
+		// Called the first time a pipeline is bound. Pipelines with shaders that weren't fetched from files are skipped
+		void Record(const Pipeline& pipeline);
+		inline size_t Count() const {
+			std::scoped_lock lock(_mutex);
+			return _records.size();
+		}
+
+		// Writes every pipeline recorded this session and every one loaded by Prewarm. Returns false if the file can't be written
+		bool Save(const std::filesystem::path& path) const;
+
+		// Queues every pipeline in a file written by Save on compiler and returns how many. Graphics pipelines are skipped unless
+		// a render pass with the recorded name is passed. The pipelines are kept until ReleasePrewarmed, use the compiler's
+		// progress to wait for them on a loading screen. A missing file is not an error, the first launch has none
+		size_t Prewarm(const std::filesystem::path& path, PipelineCompiler& compiler, const std::vector<std::shared_ptr<RenderPass>>& renderPasses);
+		void ReleasePrewarmed();
+
+	private:
+		Device& _device;
+		ShaderManager& _shaderManager;
+
+		mutable std::mutex _mutex;
+		//serialized records by their hash, each pipeline state is stored once. Ordered so saved files are reproducible
+		std::map<uint64_t, std::vector<std::byte>> _records;
+		std::vector<std::shared_ptr<AsyncPipeline>> _prewarmed;
+	};
+
+}
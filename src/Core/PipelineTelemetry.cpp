@@ -0,0 +1,184 @@
+#include "PipelineTelemetry.hpp"
+
+using namespace vrg;
+
+PipelineTelemetry::PipelineTelemetry(Device& device, bool creationFeedback, bool executableProperties)
+	: _device(device), _creationFeedback(creationFeedback), _executableProperties(executableProperties) {}
+
+vk::Pipeline PipelineTelemetry::CreateGraphicsPipeline(const std::string& name, size_t hash, vk::GraphicsPipelineCreateInfo info) {
+	Feedback feedback;
+	if (_creationFeedback) {
+		feedback.stages.resize(info.stageCount);
+		feedback.info = vk::PipelineCreationFeedbackCreateInfoEXT(&feedback.pipeline, info.stageCount, feedback.stages.data());
+		feedback.info.pNext = info.pNext;
+		info.pNext = &feedback.info;
+	}
+	//libraries have no executables of their own, their statistics show up in the linked pipeline
+	bool statistics = _captureStatistics && !(info.flags & vk::PipelineCreateFlagBits::eLibraryKHR);
+	if (statistics) info.flags |= vk::PipelineCreateFlagBits::eCaptureStatisticsKHR;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	vk::ResultValue<vk::Pipeline> result = _device->createGraphicsPipeline(_device.PipelineCache(), info);
+	auto end = std::chrono::high_resolution_clock::now();
+	if (result.result != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create graphics pipeline " + name);
+	}
+
+	Record record;
+	record.name = name;
+	record.hash = hash;
+	record.bindPoint = vk::PipelineBindPoint::eGraphics;
+	record.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	Finish(record, feedback, info.pStages, result.value, statistics);
+	return result.value;
+}
+
+vk::Pipeline PipelineTelemetry::CreateComputePipeline(const std::string& name, size_t hash, vk::ComputePipelineCreateInfo info) {
+	Feedback feedback;
+	if (_creationFeedback) {
+		feedback.stages.resize(1);
+		feedback.info = vk::PipelineCreationFeedbackCreateInfoEXT(&feedback.pipeline, 1, feedback.stages.data());
+		feedback.info.pNext = info.pNext;
+		info.pNext = &feedback.info;
+	}
+	bool statistics = _captureStatistics;
+	if (statistics) info.flags |= vk::PipelineCreateFlagBits::eCaptureStatisticsKHR;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	vk::ResultValue<vk::Pipeline> result = _device->createComputePipeline(_device.PipelineCache(), info);
+	auto end = std::chrono::high_resolution_clock::now();
+	if (result.result != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create compute pipeline " + name);
+	}
+
+	Record record;
+	record.name = name;
+	record.hash = hash;
+	record.bindPoint = vk::PipelineBindPoint::eCompute;
+	record.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	Finish(record, feedback, &info.stage, result.value, statistics);
+	return result.value;
+}
+
+void PipelineTelemetry::Finish(Record& record, const Feedback& feedback, const vk::PipelineShaderStageCreateInfo* stages, vk::Pipeline pipeline, bool statistics) {
+	if (_creationFeedback && (feedback.pipeline.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid)) {
+		record.valid = true;
+		record.cacheHit = (bool)(feedback.pipeline.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit);
+		record.driverMilliseconds = feedback.pipeline.duration / 1e6;
+		for (size_t i = 0; i < feedback.stages.size(); i++) {
+			Stage& stage = record.stages.emplace_back();
+			stage.stage = stages[i].stage;
+			stage.valid = (bool)(feedback.stages[i].flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid);
+			stage.cacheHit = (bool)(feedback.stages[i].flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit);
+			stage.milliseconds = feedback.stages[i].duration / 1e6;
+		}
+	}
+
+	if (statistics) {
+		VkPipelineInfoKHR pipelineInfo = { VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR, nullptr, pipeline };
+		uint32_t executableCount = 0;
+		_device.vkGetPipelineExecutablePropertiesKHR(*_device, &pipelineInfo, &executableCount, nullptr);
+		std::vector<VkPipelineExecutablePropertiesKHR> properties(executableCount, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR });
+		_device.vkGetPipelineExecutablePropertiesKHR(*_device, &pipelineInfo, &executableCount, properties.data());
+
+		for (uint32_t i = 0; i < executableCount; i++) {
+			Executable& executable = record.executables.emplace_back();
+			executable.name = properties[i].name;
+			executable.stages = vk::ShaderStageFlags(properties[i].stages);
+			executable.subgroupSize = properties[i].subgroupSize;
+
+			VkPipelineExecutableInfoKHR executableInfo = { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR, nullptr, pipeline, i };
+			uint32_t statisticCount = 0;
+			_device.vkGetPipelineExecutableStatisticsKHR(*_device, &executableInfo, &statisticCount, nullptr);
+			std::vector<VkPipelineExecutableStatisticKHR> values(statisticCount, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR });
+			_device.vkGetPipelineExecutableStatisticsKHR(*_device, &executableInfo, &statisticCount, values.data());
+			for (const VkPipelineExecutableStatisticKHR& value : values) {
+				std::string text;
+				switch (value.format) {
+				case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR: text = value.value.b32 ? "true" : "false"; break;
+				case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR: text = std::to_string(value.value.i64); break;
+				case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR: text = std::to_string(value.value.u64); break;
+				case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR: text = std::to_string(value.value.f64); break;
+				default: break;
+				}
+				executable.statistics.emplace_back(value.name, text);
+			}
+		}
+	}
+
+	std::scoped_lock lock(_mutex);
+	_records.push_back(std::move(record));
+}
+
+std::vector<PipelineTelemetry::Record> PipelineTelemetry::Records() const {
+	std::scoped_lock lock(_mutex);
+	return _records;
+}
+
+void PipelineTelemetry::Clear() {
+	std::scoped_lock lock(_mutex);
+	_records.clear();
+}
+
+//quotes fields that would break the csv
+static std::string CsvField(const std::string& text) {
+	if (text.find_first_of(",\"\n") == std::string::npos) return text;
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"') quoted += '"';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+bool PipelineTelemetry::Dump(const std::filesystem::path& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file) {
+		errf_color(ConsoleColor::Red, "Could not write pipeline telemetry to %s\n", path.string().c_str());
+		return false;
+	}
+	file << "name,hash,bind point,create ms,driver ms,cache hit,stages,statistics\n";
+	for (const Record& record : Records()) {
+		std::string stages;
+		for (const Stage& stage : record.stages) {
+			if (!stages.empty()) stages += "; ";
+			stages += vk::to_string(stage.stage) + " ";
+			stages += stage.valid ? std::to_string(stage.milliseconds) + "ms " + (stage.cacheHit ? "hit" : "miss") : "unknown";
+		}
+		std::string statistics;
+		for (const Executable& executable : record.executables) {
+			for (const auto& [name, value] : executable.statistics) {
+				if (!statistics.empty()) statistics += "; ";
+				statistics += executable.name + " " + name + "=" + value;
+			}
+		}
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)record.hash);
+		file << CsvField(record.name) << ',' << hash << ',' << vk::to_string(record.bindPoint) << ',' << record.milliseconds << ',';
+		if (record.valid) file << record.driverMilliseconds << ',' << (record.cacheHit ? "yes" : "no") << ',';
+		else file << ",unknown,";
+		file << CsvField(stages) << ',' << CsvField(statistics) << '\n';
+	}
+	return (bool)file;
+}
+
+void PipelineTelemetry::PrintSummary(size_t slowest) const {
+	std::vector<Record> records = Records();
+	double total = 0;
+	size_t hits = 0;
+	size_t reported = 0;
+	for (const Record& record : records) {
+		total += record.milliseconds;
+		if (record.valid) {
+			reported++;
+			if (record.cacheHit) hits++;
+		}
+	}
+	printf_color(ConsoleColor::Cyan, "%zu pipelines created in %.2fms, %zu of %zu with feedback hit the pipeline cache\n", records.size(), total, hits, reported);
+
+	std::ranges::sort(records, std::ranges::greater(), &Record::milliseconds);
+	for (size_t i = 0; i < std::min(slowest, records.size()); i++) {
+		const Record& record = records[i];
+		printf("  %8.2fms %s %s\n", record.milliseconds, record.name.c_str(), !record.valid ? "" : record.cacheHit ? "(cache hit)" : "(cache miss)");
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <filesystem>
+
+namespace vrg {
+
+	// Records how long every pipeline took to create and whether the driver found it in its cache, from
+	// VK_EXT_pipeline_creation_feedback. With statistics capture on, shader executable statistics like register
+	// and spill counts are read back through VK_KHR_pipeline_executable_properties. Safe to use from several threads
+	class PipelineTelemetry {
+	public:
+		struct Stage {
+			vk::ShaderStageFlagBits stage;
+			bool valid = false;
+			bool cacheHit = false;
+			double milliseconds = 0;
+		};
+		struct Executable {
+			std::string name;
+			vk::ShaderStageFlags stages;
+			uint32_t subgroupSize = 0;
+			//statistic name -> value formatted as text, the names are up to the driver
+			std::vector<std::pair<std::string, std::string>> statistics;
+		};
+		struct Record {
+			std::string name;
+			size_t hash = 0;
+			vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+			//time spent in the create call on this thread
+			double milliseconds = 0;
+			//the rest is only filled in when the driver reports feedback
+			bool valid = false;
+			bool cacheHit = false;
+			double driverMilliseconds = 0;
+			std::vector<Stage> stages;
+			std::vector<Executable> executables;
+		};
+
+		PipelineTelemetry(Device& device, bool creationFeedback, bool executableProperties);
+
+		PipelineTelemetry(const PipelineTelemetry&) = delete;
+		PipelineTelemetry& operator=(const PipelineTelemetry&) = delete;
+
+		// Executable statistics can make creation slower and are off by default. Ignored without driver support
+		inline void SetCaptureStatistics(bool capture) { _captureStatistics = capture && _executableProperties; }
+		inline bool CaptureStatistics() const { return _captureStatistics; }
+
+		// Creates the pipeline with feedback chained into info and records it. Throws if creation fails
+		vk::Pipeline CreateGraphicsPipeline(const std::string& name, size_t hash, vk::GraphicsPipelineCreateInfo info);
+		vk::Pipeline CreateComputePipeline(const std::string& name, size_t hash, vk::ComputePipelineCreateInfo info);
+
+		std::vector<Record> Records() const;
+		void Clear();
+
+		// One line per pipeline, comma separated. Returns false if the file can't be written
+		bool Dump(const std::filesystem::path& path) const;
+		// Totals, cache hit rate and the slowest pipelines
+		void PrintSummary(size_t slowest = 10) const;
+
+	private:
+		Device& _device;
+		bool _creationFeedback;
+		bool _executableProperties;
+		std::atomic<bool> _captureStatistics = false;
+
+		mutable std::mutex _mutex;
+		std::vector<Record> _records;
+
+		//chains feedback into info.pNext and fills in record once the pipeline exists
+		struct Feedback {
+			vk::PipelineCreationFeedbackEXT pipeline;
+			std::vector<vk::PipelineCreationFeedbackEXT> stages;
+			vk::PipelineCreationFeedbackCreateInfoEXT info;
+		};
+		void Finish(Record& record, const Feedback& feedback, const vk::PipelineShaderStageCreateInfo* stages, vk::Pipeline pipeline, bool statistics);
+	};
+
+}
@@ -0,0 +1,104 @@
+#include "Readback.hpp"
+
+using namespace vrg;
+
+ReadbackRing::ReadbackRing(Device& device, uint32_t maxBuffers) : _device(device), _maxBuffers(maxBuffers) {}
+
+ReadbackRing::~ReadbackRing() {
+	if (!_pending.empty()) {
+		errf_color(ConsoleColor::Yellow, "Destroying ReadbackRing with %zu unresolved reads\n", _pending.size());
+	}
+	//unresolved futures see a broken promise instead of hanging
+	_pending.clear();
+	_buffers.clear();
+}
+
+std::shared_ptr<Buffer> ReadbackRing::AcquireBuffer(vk::DeviceSize size) {
+	//a buffer is free once no ReadbackData references it anymore
+	std::shared_ptr<Buffer>* best = nullptr;
+	for (auto& buffer : _buffers) {
+		if (buffer.use_count() == 1 && buffer->Size() >= size && (!best || buffer->Size() < (*best)->Size())) {
+			best = &buffer;
+		}
+	}
+	if (best) return *best;
+
+	if (_buffers.size() >= _maxBuffers) {
+		//drop a free buffer that was too small to make room, otherwise grow past the limit
+		auto freeBuffer = std::ranges::find_if(_buffers, [](const auto& b) { return b.use_count() == 1; });
+		if (freeBuffer != _buffers.end()) {
+			_buffers.erase(freeBuffer);
+		}
+		else {
+			errf_color(ConsoleColor::Yellow, "ReadbackRing exceeded %u buffers, results are not being released\n", _maxBuffers);
+		}
+	}
+
+	//round up so frames of slightly different sizes can share buffers
+	vk::DeviceSize bufferSize = std::bit_ceil(size);
+	return _buffers.emplace_back(std::make_shared<Buffer>(_device, "Readback", bufferSize, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_TO_CPU, vk::SharingMode::eExclusive, vk::MemoryPropertyFlagBits::eHostVisible));
+}
+
+std::shared_ptr<ReadbackData> ReadbackRing::Record(CommandBuffer& commandBuffer, const Texture::View& view) {
+	Texture& texture = view.Texture();
+	vk::ImageSubresourceRange range = view.SubresourceRange();
+	vk::DeviceSize texelSize = texel_size(texture.Format());
+	if (texelSize == 0) {
+		throw std::invalid_argument("Cannot read back texture " + texture.Name() + " with format " + vk::to_string(texture.Format()));
+	}
+	if (texture.SampleCount() != vk::SampleCountFlagBits::e1) {
+		throw std::invalid_argument("Cannot read back multisampled texture " + texture.Name());
+	}
+	if (!(texture.Usage() & vk::ImageUsageFlagBits::eTransferSrc)) {
+		throw std::invalid_argument("Texture " + texture.Name() + " was not created with TransferSrc usage");
+	}
+
+	auto data = std::make_shared<ReadbackData>();
+	data->_extent = vk::Extent3D(std::max(1u, texture.Extent().width >> range.baseMipLevel), std::max(1u, texture.Extent().height >> range.baseMipLevel), std::max(1u, texture.Extent().depth >> range.baseMipLevel));
+	data->_format = texture.Format();
+	data->_layerCount = range.layerCount;
+	data->_size = texelSize * data->_extent.width * data->_extent.height * data->_extent.depth * range.layerCount;
+	data->_buffer = AcquireBuffer(data->_size);
+
+	//depth/stencil images can only copy one aspect at a time
+	vk::ImageAspectFlags aspect = range.aspectMask;
+	if (aspect & vk::ImageAspectFlagBits::eDepth) aspect = vk::ImageAspectFlagBits::eDepth;
+
+	commandBuffer.CopyImageToBuffer(texture, vk::ImageSubresourceLayers(aspect, range.baseMipLevel, range.baseArrayLayer, range.layerCount),
+		Buffer::View<std::byte>(data->_buffer, 0, data->_size), {}, data->_extent);
+	//the copy has to be visible to host reads once the fence signals
+	commandBuffer.Barrier(vk::BufferMemoryBarrier2KHR(vk::PipelineStageFlagBits2KHR::eCopy, vk::AccessFlagBits2KHR::eTransferWrite,
+		vk::PipelineStageFlagBits2KHR::eHost, vk::AccessFlagBits2KHR::eHostRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, **data->_buffer, 0, data->_size));
+	return data;
+}
+
+std::future<std::shared_ptr<const ReadbackData>> ReadbackRing::Read(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view) {
+	std::promise<std::shared_ptr<const ReadbackData>> promise;
+	auto future = promise.get_future();
+	_pending.push_back(Request{ commandBuffer, Record(*commandBuffer, view), std::move(promise) });
+	return future;
+}
+
+void ReadbackRing::Read(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view, Callback callback) {
+	_pending.push_back(Request{ commandBuffer, Record(*commandBuffer, view), std::move(callback) });
+}
+
+void ReadbackRing::Poll() {
+	while (!_pending.empty()) {
+		Request& request = _pending.front();
+		if (request.commandBuffer->CompletionFence().Status() != vk::Result::eSuccess) {
+			//command buffers complete in submission order on a queue, later requests can't be done either
+			break;
+		}
+		request.data->_buffer->Invalidate(0, request.data->_size);
+
+		std::shared_ptr<const ReadbackData> data = std::move(request.data);
+		if (auto* promise = std::get_if<std::promise<std::shared_ptr<const ReadbackData>>>(&request.completion)) {
+			promise->set_value(std::move(data));
+		}
+		else {
+			std::get<Callback>(request.completion)(std::move(data));
+		}
+		_pending.pop_front();
+	}
+}
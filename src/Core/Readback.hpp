@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CommandBuffer.hpp"
+
+#include <future>
+
+namespace vrg {
+
+	// Host copy of one image subresource. The staging buffer goes back to the ring once the last reference is dropped
+	class ReadbackData {
+	private:
+		friend class ReadbackRing;
+		std::shared_ptr<Buffer> _buffer;
+		vk::DeviceSize _size = 0;
+		vk::Extent3D _extent;
+		vk::Format _format = vk::Format::eUndefined;
+		uint32_t _layerCount = 1;
+
+	public:
+		inline std::span<const std::byte> Data() const { return std::span<const std::byte>(_buffer->Data(), _size); }
+		inline vk::Extent3D Extent() const { return _extent; }
+		inline vk::Format Format() const { return _format; }
+		inline uint32_t LayerCount() const { return _layerCount; }
+		inline vk::DeviceSize RowPitch() const { return _extent.width * texel_size(_format); }
+	};
+
+	// Copies images into pooled host-visible buffers and hands the results back once the
+	// command buffer that recorded the copy has finished on the GPU. Nothing here waits on the device,
+	// results are resolved by Poll which only checks fences.
+	class ReadbackRing {
+	public:
+		using Callback = std::function<void(std::shared_ptr<const ReadbackData>)>;
+
+		ReadbackRing(Device& device, uint32_t maxBuffers = 8);
+		~ReadbackRing();
+
+		// Records a copy of the view's first mip and its layers. The command buffer has to be executed before the result can resolve
+		std::future<std::shared_ptr<const ReadbackData>> Read(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view);
+		void Read(const std::shared_ptr<CommandBuffer>& commandBuffer, const Texture::View& view, Callback callback);
+
+		// Resolves every request whose command buffer has completed, in submission order. Call once per frame
+		void Poll();
+
+		inline size_t PendingCount() const { return _pending.size(); }
+		inline size_t BufferCount() const { return _buffers.size(); }
+
+	private:
+		struct Request {
+			std::shared_ptr<CommandBuffer> commandBuffer;
+			std::shared_ptr<ReadbackData> data;
+			std::variant<std::promise<std::shared_ptr<const ReadbackData>>, Callback> completion;
+		};
+
+		std::shared_ptr<ReadbackData> Record(CommandBuffer& commandBuffer, const Texture::View& view);
+		std::shared_ptr<Buffer> AcquireBuffer(vk::DeviceSize size);
+
+		Device& _device;
+		uint32_t _maxBuffers;
+		std::vector<std::shared_ptr<Buffer>> _buffers;
+		std::deque<Request> _pending;
+	};
+
+}
@@ -151,6 +151,18 @@ namespace vrg {
 
 			auto renderPassInfo = vk::RenderPassCreateInfo({}, attachments, subpasses, dependencies);
 			_renderPass = _device->createRenderPass(renderPassInfo);
+
+			//what makes render passes compatible, pipelines created for one can be used with the other
+			_compatibilityHash = hash_combine(attachments.size(), subpassData.size());
+			for (const auto& attachment : attachments) {
+				_compatibilityHash = hash_combine(_compatibilityHash, attachment.format, attachment.samples);
+			}
+			for (const auto& spd : subpassData) {
+				_compatibilityHash = hash_combine(_compatibilityHash, spd.inputAttachments.size(), spd.colorAttachments.size(), spd.resolveAttachments.size(), spd.depthAttachment.attachment);
+				for (const auto& reference : spd.inputAttachments) _compatibilityHash = hash_combine(_compatibilityHash, reference.attachment);
+				for (const auto& reference : spd.colorAttachments) _compatibilityHash = hash_combine(_compatibilityHash, reference.attachment);
+				for (const auto& reference : spd.resolveAttachments) _compatibilityHash = hash_combine(_compatibilityHash, reference.attachment);
+			}
 		}
 
 		inline ~RenderPass() {
@@ -163,6 +175,8 @@ namespace vrg {
 		inline const auto& SubpassDescriptions() const { return _subpassDescriptions; }
 		inline const std::vector<std::pair<vk::AttachmentDescription, std::string>>& AttachmentDescriptions() const { return _attachmentDescriptions; }
 		inline size_t AttachmentIndex(const std::string& id) const { return _attachmentMap.at(id); }
+		// Equal for render passes that are compatible, unlike the handle it stays the same when the render pass is recreated
+		inline size_t CompatibilityHash() const { return _compatibilityHash; }
 
 	private:
 		friend class CommandBuffer;
@@ -175,6 +189,7 @@ namespace vrg {
 		std::vector<SubpassDescription> _subpassDescriptions;
 
 		size_t _hash;
+		size_t _compatibilityHash = 0;
 	};
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Device.hpp"
+
+namespace vrg {
+
+	class Sampler : public DeviceResource {
+	private:
+		vk::Sampler _sampler;
+		vk::SamplerCreateInfo _createInfo;
+
+	public:
+		inline Sampler(Device& device, const std::string& name, const vk::SamplerCreateInfo& createInfo)
+			: DeviceResource(device, name), _createInfo(createInfo) {
+			_sampler = _device->createSampler(_createInfo);
+		}
+		inline ~Sampler() {
+			_device->destroySampler(_sampler);
+		}
+
+		inline const vk::Sampler& operator*() const { return _sampler; }
+		inline const vk::Sampler* operator->() const { return &_sampler; }
+
+		inline const vk::SamplerCreateInfo& CreateInfo() const { return _createInfo; }
+	};
+
+	//pNext is left out, samplers with extension structs are not cached
+	inline size_t HashSamplerInfo(const vk::SamplerCreateInfo& info) {
+		return hash_combine(info.flags, info.magFilter, info.minFilter, info.mipmapMode,
+			info.addressModeU, info.addressModeV, info.addressModeW,
+			info.mipLodBias, info.anisotropyEnable, info.maxAnisotropy,
+			info.compareEnable, info.compareOp, info.minLod, info.maxLod,
+			info.borderColor, info.unnormalizedCoordinates);
+	}
+
+}
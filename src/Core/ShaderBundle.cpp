@@ -0,0 +1,351 @@
+#include "ShaderBundle.hpp"
+
+#include <filesystem>
+
+using namespace vrg;
+
+static constexpr uint32_t BundleMagic = 0x42475256; //"VRGB"
+
+//records only hold 32 and 64 bit fields and sit at aligned offsets, so they are read in place from the mapping.
+//strings are offsets into a table of null terminated strings at the end of the file
+struct BundleHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t stringTableSize;
+	uint64_t stringTableOffset;
+};
+
+struct BundleEntry {
+	uint32_t name;
+	uint32_t entryPoint;
+	uint32_t stage;
+	uint32_t spirvWordCount;
+	uint64_t spirvOffset;
+	uint64_t reflectionOffset;
+};
+
+//followed by the bindings, members, push constants, stage inputs, stage outputs and specialization constants in that order
+struct PackedReflection {
+	uint32_t bindingCount;
+	uint32_t memberCount;
+	uint32_t pushConstantCount;
+	uint32_t stageInputCount;
+	uint32_t stageOutputCount;
+	uint32_t specializationConstantCount;
+	uint32_t pushConstantSize;
+	uint32_t workgroupSize[3];
+	uint32_t workgroupSizeConstants[3];
+};
+
+struct PackedBinding {
+	uint32_t name;
+	uint32_t set;
+	uint32_t binding;
+	uint32_t descriptorCount;
+	uint32_t descriptorType;
+	uint32_t stageFlags;
+	uint32_t runtimeArray;
+	uint32_t blockSize;
+	uint32_t inputAttachmentIndex;
+	uint32_t memberCount; //members of consecutive bindings follow each other
+};
+
+struct PackedMember {
+	uint32_t name;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t arraySize;
+	uint32_t arrayStride;
+};
+
+struct PackedPushConstant {
+	uint32_t name;
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct PackedStageVariable {
+	uint32_t name;
+	uint32_t location;
+	uint32_t format;
+	uint32_t attributeType;
+	uint32_t attributeIndex;
+};
+
+struct PackedSpecializationConstant {
+	uint32_t name;
+	uint32_t constantId;
+	uint32_t size;
+};
+
+static constexpr size_t BundleAlignment = 8;
+
+class BundleWriter {
+public:
+	std::vector<std::byte> data;
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+
+	inline uint32_t String(const std::string& s) {
+		auto [it, inserted] = stringOffsets.emplace(s, (uint32_t)strings.size());
+		if (inserted) {
+			strings.append(s);
+			strings.push_back('\0');
+		}
+		return it->second;
+	}
+
+	template<typename T>
+	inline size_t Append(const T* values, size_t count) {
+		size_t offset = data.size();
+		data.resize(offset + sizeof(T) * count);
+		if (count) memcpy(data.data() + offset, values, sizeof(T) * count);
+		return offset;
+	}
+	template<typename T>
+	inline size_t Append(const T& value) { return Append(&value, 1); }
+	template<typename T>
+	inline size_t Append(const std::vector<T>& values) { return Append(values.data(), values.size()); }
+
+	inline void Align() { data.resize((data.size() + BundleAlignment - 1) / BundleAlignment * BundleAlignment); }
+};
+
+//every offset comes from the file, each one is checked before the mapping is touched
+class BundleReader {
+public:
+	std::span<const std::byte> bytes;
+	std::string path;
+
+	template<typename T>
+	inline std::span<const T> Array(uint64_t offset, uint64_t count) const {
+		if (offset % alignof(T) || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T)) {
+			throw std::runtime_error("Shader bundle " + path + " is corrupted");
+		}
+		return std::span<const T>(reinterpret_cast<const T*>(bytes.data() + offset), count);
+	}
+	// Reads count records at offset and moves offset past them
+	template<typename T>
+	inline std::span<const T> Next(uint64_t& offset, uint64_t count) const {
+		std::span<const T> array = Array<T>(offset, count);
+		offset += array.size_bytes();
+		return array;
+	}
+};
+
+static void writeReflection(BundleWriter& writer, const SpirvReflection& reflection) {
+	std::vector<PackedBinding> bindings;
+	std::vector<PackedMember> members;
+	for (const auto& [name, binding] : reflection.descriptorBindings) {
+		bindings.push_back({ writer.String(name), binding.set, binding.binding, binding.descriptorCount, (uint32_t)binding.descriptorType,
+			(uint32_t)binding.stageFlags, binding.runtimeArray, binding.blockSize, binding.inputAttachmentIndex, (uint32_t)binding.members.size() });
+		for (const BlockMember& member : binding.members) {
+			members.push_back({ writer.String(member.name), member.offset, member.size, member.arraySize, member.arrayStride });
+		}
+	}
+	std::vector<PackedPushConstant> pushConstants;
+	for (const auto& [name, range] : reflection.pushConstants) {
+		pushConstants.push_back({ writer.String(name), range.first, range.second });
+	}
+	auto packStageVariables = [&](const std::unordered_map<std::string, RasterStageVariable>& variables) {
+		std::vector<PackedStageVariable> packed;
+		for (const auto& [name, variable] : variables) {
+			packed.push_back({ writer.String(name), variable.location, (uint32_t)variable.format, (uint32_t)variable.attributeId.type, variable.attributeId.typeIndex });
+		}
+		return packed;
+	};
+	std::vector<PackedStageVariable> stageInputs = packStageVariables(reflection.stageInputs);
+	std::vector<PackedStageVariable> stageOutputs = packStageVariables(reflection.stageOutputs);
+	std::vector<PackedSpecializationConstant> specializationConstants;
+	for (const auto& [name, constant] : reflection.specializationConstants) {
+		specializationConstants.push_back({ writer.String(name), constant.constantId, constant.size });
+	}
+
+	PackedReflection header = {};
+	header.bindingCount = (uint32_t)bindings.size();
+	header.memberCount = (uint32_t)members.size();
+	header.pushConstantCount = (uint32_t)pushConstants.size();
+	header.stageInputCount = (uint32_t)stageInputs.size();
+	header.stageOutputCount = (uint32_t)stageOutputs.size();
+	header.specializationConstantCount = (uint32_t)specializationConstants.size();
+	header.pushConstantSize = reflection.pushConstantSize;
+	for (uint32_t i = 0; i < 3; i++) {
+		header.workgroupSize[i] = reflection.workgroupSize[i];
+		header.workgroupSizeConstants[i] = reflection.workgroupSizeConstants[i];
+	}
+
+	writer.Append(header);
+	writer.Append(bindings);
+	writer.Append(members);
+	writer.Append(pushConstants);
+	writer.Append(stageInputs);
+	writer.Append(stageOutputs);
+	writer.Append(specializationConstants);
+}
+
+void ShaderBundle::Write(const std::string& path, const std::vector<Entry>& entries) {
+	BundleWriter writer;
+
+	BundleHeader header = {};
+	header.magic = BundleMagic;
+	header.version = Version;
+	header.entryCount = (uint32_t)entries.size();
+	writer.Append(header);
+
+	//entry records are patched once the offsets of their data are known
+	size_t entriesOffset = writer.data.size();
+	std::vector<BundleEntry> records(entries.size());
+	writer.Append(records);
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& entry = entries[i];
+		if (entry.spirv.empty()) {
+			throw std::runtime_error("Shader bundle entry " + entry.name + " has no SPIR-V");
+		}
+		records[i].name = writer.String(entry.name);
+		records[i].entryPoint = writer.String(entry.entryPoint);
+		records[i].stage = (uint32_t)entry.stage;
+		records[i].spirvWordCount = (uint32_t)entry.spirv.size();
+
+		writer.Align();
+		records[i].spirvOffset = writer.Append(entry.spirv);
+		writer.Align();
+		records[i].reflectionOffset = writer.data.size();
+		writeReflection(writer, *SpirvReflection::Get(entry.spirv, entry.stage));
+	}
+	memcpy(writer.data.data() + entriesOffset, records.data(), records.size() * sizeof(BundleEntry));
+
+	writer.Align();
+	header.stringTableOffset = writer.data.size();
+	header.stringTableSize = (uint32_t)writer.strings.size();
+	writer.Append(writer.strings.data(), writer.strings.size());
+	memcpy(writer.data.data(), &header, sizeof(header));
+
+	//same as the SPIR-V cache, never leave a half written bundle behind under the real name
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size())) {
+			throw std::runtime_error("Failed to write shader bundle " + tmpPath);
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) {
+		throw std::runtime_error("Failed to write shader bundle " + path + ": " + error.message());
+	}
+}
+
+ShaderBundle::ShaderBundle(const std::string& path) {
+	_file = MappedFile::Open(path);
+	if (!_file) {
+		throw std::runtime_error("Failed to open shader bundle " + path);
+	}
+	BundleReader reader{ _file->Bytes(), path };
+
+	const BundleHeader& header = reader.Array<BundleHeader>(0, 1)[0];
+	if (header.magic != BundleMagic || header.version != Version) {
+		throw std::runtime_error("Shader bundle " + path + " was built for a different version");
+	}
+	std::span<const char> strings = reader.Array<char>(header.stringTableOffset, header.stringTableSize);
+	auto string = [&](uint32_t offset) {
+		if (offset >= strings.size()) throw std::runtime_error("Shader bundle " + path + " is corrupted");
+		const char* begin = strings.data() + offset;
+		const char* end = std::find(begin, strings.data() + strings.size(), '\0');
+		return std::string(begin, end);
+	};
+
+	for (const BundleEntry& record : reader.Array<BundleEntry>(sizeof(BundleHeader), header.entryCount)) {
+		LoadedEntry entry;
+		entry.stage = (vk::ShaderStageFlagBits)record.stage;
+		entry.entryPoint = string(record.entryPoint);
+		entry.spirv = reader.Array<uint32_t>(record.spirvOffset, record.spirvWordCount);
+
+		uint64_t offset = record.reflectionOffset;
+		const PackedReflection& packed = reader.Next<PackedReflection>(offset, 1)[0];
+		auto bindings = reader.Next<PackedBinding>(offset, packed.bindingCount);
+		auto members = reader.Next<PackedMember>(offset, packed.memberCount);
+		auto pushConstants = reader.Next<PackedPushConstant>(offset, packed.pushConstantCount);
+		auto stageInputs = reader.Next<PackedStageVariable>(offset, packed.stageInputCount);
+		auto stageOutputs = reader.Next<PackedStageVariable>(offset, packed.stageOutputCount);
+		auto specializationConstants = reader.Next<PackedSpecializationConstant>(offset, packed.specializationConstantCount);
+
+		std::shared_ptr<SpirvReflection> reflection(new SpirvReflection());
+		size_t member = 0;
+		for (const PackedBinding& b : bindings) {
+			DescriptorBinding binding;
+			binding.set = b.set;
+			binding.binding = b.binding;
+			binding.descriptorCount = b.descriptorCount;
+			binding.descriptorType = (vk::DescriptorType)b.descriptorType;
+			binding.stageFlags = (vk::ShaderStageFlags)b.stageFlags;
+			binding.runtimeArray = b.runtimeArray;
+			binding.blockSize = b.blockSize;
+			binding.inputAttachmentIndex = b.inputAttachmentIndex;
+			if (b.memberCount > members.size() - member) throw std::runtime_error("Shader bundle " + path + " is corrupted");
+			for (const PackedMember& m : members.subspan(member, b.memberCount)) {
+				binding.members.push_back({ string(m.name), m.offset, m.size, m.arraySize, m.arrayStride });
+			}
+			member += b.memberCount;
+			reflection->descriptorBindings.emplace(string(b.name), std::move(binding));
+		}
+		for (const PackedPushConstant& p : pushConstants) {
+			reflection->pushConstants.emplace(string(p.name), std::make_pair(p.offset, p.size));
+		}
+		auto unpackStageVariable = [](const PackedStageVariable& v) {
+			RasterStageVariable r;
+			r.location = v.location;
+			r.format = (vk::Format)v.format;
+			r.attributeId = { (VertexAttributeType)v.attributeType, v.attributeIndex };
+			return r;
+		};
+		for (const PackedStageVariable& v : stageInputs) {
+			reflection->stageInputs.emplace(string(v.name), unpackStageVariable(v));
+		}
+		for (const PackedStageVariable& v : stageOutputs) {
+			reflection->stageOutputs.emplace(string(v.name), unpackStageVariable(v));
+		}
+		for (const PackedSpecializationConstant& c : specializationConstants) {
+			reflection->specializationConstants.emplace(string(c.name), SpecializationConstant{ c.constantId, c.size });
+		}
+		reflection->pushConstantSize = packed.pushConstantSize;
+		for (uint32_t i = 0; i < 3; i++) {
+			reflection->workgroupSize[i] = packed.workgroupSize[i];
+			reflection->workgroupSizeConstants[i] = packed.workgroupSizeConstants[i];
+		}
+		entry.reflection = std::move(reflection);
+
+		_entries.emplace(string(record.name), std::move(entry));
+	}
+}
+
+std::string ShaderBundle::VariantName(const std::string& name, std::vector<std::pair<std::string, std::string>> defines) {
+	std::ranges::sort(defines);
+	std::string variant = name;
+	for (const auto& [define, value] : defines) {
+		variant += " " + define + "=" + value;
+	}
+	return variant;
+}
+
+std::vector<std::string> ShaderBundle::Names() const {
+	std::vector<std::string> names;
+	for (const auto& name : _entries | std::views::keys) {
+		names.push_back(name);
+	}
+	return names;
+}
+
+const ShaderBundle::LoadedEntry& ShaderBundle::Find(const std::string& name) const {
+	auto it = _entries.find(name);
+	if (it == _entries.end()) {
+		throw std::runtime_error("Shader bundle has no shader " + name);
+	}
+	return it->second;
+}
+
+std::shared_ptr<SpirvModule> ShaderBundle::Load(const vk::Device& device, const std::string& name) const {
+	const LoadedEntry& entry = Find(name);
+	//vkCreateShaderModule copies the code, the module doesn't keep the mapping alive
+	return std::make_shared<SpirvModule>(device, entry.stage, entry.spirv, entry.reflection, entry.entryPoint);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SpirvModule.hpp"
+#include "MappedFile.hpp"
+
+namespace vrg {
+
+	// Precompiled shaders with their reflection in one file, built offline by the ShaderBundler tool.
+	// The file is memory mapped, modules are created straight from the mapping without compiling or running spirv-cross
+	class ShaderBundle {
+	public:
+		// bump whenever the layout below or SpirvReflection changes
+		static constexpr uint32_t Version = 1;
+
+		struct Entry {
+			std::string name;
+			vk::ShaderStageFlagBits stage;
+			std::string entryPoint = "main";
+			std::vector<uint32_t> spirv;
+		};
+
+		// Reflects every entry and writes the bundle, throws if the file can't be written
+		static void Write(const std::string& path, const std::vector<Entry>& entries);
+
+		// Throws if the file is missing, truncated or from another version
+		ShaderBundle(const std::string& path);
+
+		// Name of the entry holding the shader compiled with defines, just name without any. The order of defines doesn't matter
+		static std::string VariantName(const std::string& name, std::vector<std::pair<std::string, std::string>> defines);
+
+		inline bool Contains(const std::string& name) const { return _entries.count(name); }
+		std::vector<std::string> Names() const;
+		// Throws if the bundle has no shader with that name
+		std::shared_ptr<SpirvModule> Load(const vk::Device& device, const std::string& name) const;
+
+		inline vk::ShaderStageFlagBits Stage(const std::string& name) const { return Find(name).stage; }
+		inline const std::string& EntryPoint(const std::string& name) const { return Find(name).entryPoint; }
+
+	private:
+		struct LoadedEntry {
+			vk::ShaderStageFlagBits stage;
+			std::string entryPoint;
+			std::span<const uint32_t> spirv;
+			std::shared_ptr<const SpirvReflection> reflection;
+		};
+
+		std::shared_ptr<const MappedFile> _file;
+		std::unordered_map<std::string, LoadedEntry> _entries;
+
+		const LoadedEntry& Find(const std::string& name) const;
+	};
+
+}
@@ -1,91 +1,283 @@
 #include "ShaderCompiler.hpp"
 #include "FileIncluder.hpp"
+#include <spirv-tools/optimizer.hpp>
 #include <iostream>
 
 using namespace vrg;
 
+struct SpirvCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t wordCount;
+	uint64_t checksum;
+	uint64_t instructionsBefore;
+	uint64_t bytesBefore;
+};
+static constexpr uint32_t SpirvCacheMagic = 0x53475256; //"VRGS"
 
-std::vector<uint32_t> ShaderCompiler::CompileToSpirv(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force) {
-	bool hashcompare = true;
+void ShaderCompiler::SetupOptions(shaderc::CompileOptions& compileoptions, const ShaderCompileOptions& options) const {
+	compileoptions.SetSourceLanguage(shaderc_source_language::shaderc_source_language_hlsl);
+	compileoptions.SetHlslFunctionality1(true);
+	compileoptions.SetTargetSpirv(shaderc_spirv_version::shaderc_spirv_version_1_5);
+	//compileoptions.SetHlslIoMapping(true);
+	compileoptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	//optimization runs as a separate stage, see Optimize
+	for (const auto& [macro, value] : options.defines) {
+		compileoptions.AddMacroDefinition(macro, value);
+	}
+}
+
+uint64_t ShaderCompiler::CacheKey(const std::string& preprocessed, const std::unordered_set<std::string>& includes, shaderc_shader_kind stage, const ShaderCompileOptions& options) const {
+	unsigned int spvVersion = 0, spvRevision = 0;
+	shaderc_get_spv_version(&spvVersion, &spvRevision);
+
+	//everything that SetupOptions sets has to show up here
+	std::string signature = std::to_string(CacheVersion) + ";" + std::to_string(spvVersion) + "." + std::to_string(spvRevision) +
+		";hlsl;functionality1;spv" + std::to_string(shaderc_spirv_version_1_5) + ";vulkan" + std::to_string(shaderc_env_version_vulkan_1_2) +
+		";stage" + std::to_string(stage) + ";" + options.name + ";entry" + options.entryPoint + ";opt" + std::to_string(options.optimization) +
+		";strip" + std::to_string(options.stripDebugInfo) + ";spirvtools" + spvSoftwareVersionString();
+	//defines are covered by the preprocessed source, specialization constants don't change the SPIR-V
+	uint64_t key = hash_fnv1a(signature);
+	key = hash_fnv1a(preprocessed, key);
+
+	//the preprocessed source already inlines the includes, hashing them again keeps the key honest if
+	//line directives or include guards ever hide a change. Sorted so the key doesn't depend on set order
+	std::vector<std::string> sortedIncludes(includes.begin(), includes.end());
+	std::ranges::sort(sortedIncludes);
+	for (const std::string& include : sortedIncludes) {
+		auto file = IncludeCache::Shared().Get(include);
+		key = hash_fnv1a(include, key);
+		key = hash_fnv1a(file ? std::string_view(file->contents) : std::string_view(), key);
+	}
+	return key;
+}
+
+//shaderc compilers are not thread safe but cheap to keep around, one per thread avoids reinitializing glslang for every shader
+static shaderc::Compiler& ThreadCompiler() {
+	static thread_local shaderc::Compiler compiler;
+	return compiler;
+}
+
+static std::string CacheFilename(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)key);
+	return name;
+}
+
+static uint64_t countInstructions(const std::vector<uint32_t>& spirv) {
+	//5 word header, then every instruction starts with its word count in the high half
+	uint64_t count = 0;
+	for (size_t i = 5; i < spirv.size(); count++) {
+		uint32_t words = spirv[i] >> 16;
+		if (words == 0) break;
+		i += words;
+	}
+	return count;
+}
+
+bool ShaderCompiler::Optimize(std::vector<uint32_t>& spirv, const ShaderCompileOptions& options) const {
+	if (options.optimization == shaderc_optimization_level_zero && !options.stripDebugInfo) return true;
+
+	spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_2);
+	optimizer.SetMessageConsumer([](spv_message_level_t level, const char*, const spv_position_t& position, const char* message) {
+		if (level <= SPV_MSG_ERROR) {
+			errf_color(ConsoleColor::Red, "spirv-opt: %s at word %zu\n", message, position.index);
+		}
+	});
+	if (options.optimization == shaderc_optimization_level_performance) {
+		optimizer.RegisterPerformancePasses();
+	}
+	else if (options.optimization == shaderc_optimization_level_size) {
+		optimizer.RegisterSizePasses();
+	}
+	if (options.optimization != shaderc_optimization_level_zero) {
+		//HLSL entry points list every global in their interface since SPIR-V 1.4, drop the ones the code no longer touches
+		optimizer.RegisterPass(spvtools::CreateRemoveUnusedInterfaceVariablesPass());
+		optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+		optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+		optimizer.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+	}
+	if (options.stripDebugInfo) {
+		//semantics live in decorations, not debug info, so vertex attribute matching keeps working
+		optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+	}
+
+	std::vector<uint32_t> optimized;
+	if (!optimizer.Run(spirv.data(), spirv.size(), &optimized)) {
+		return false;
+	}
+	spirv = std::move(optimized);
+	return true;
+}
+
+bool ShaderCompiler::ReadCache(uint64_t key, std::vector<uint32_t>& spirv, SpirvStatistics& statistics) const {
+	if (_cacheDirectory.empty()) return false;
+
+	std::ifstream file(_cacheDirectory / CacheFilename(key), std::ios::binary);
+	if (!file) return false;
+
+	SpirvCacheHeader header = {};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (header.magic != SpirvCacheMagic || header.version != CacheVersion || header.key != key || header.wordCount == 0 || header.wordCount > (1ull << 28)) {
+		return false;
+	}
+
+	spirv.resize(header.wordCount);
+	if (!file.read(reinterpret_cast<char*>(spirv.data()), spirv.size() * sizeof(uint32_t))) {
+		spirv.clear();
+		return false;
+	}
+	//catches files truncated or corrupted by a crash, the rename in WriteCache already keeps half written files out
+	std::string_view bytes(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+	if (hash_fnv1a(bytes) != header.checksum) {
+		spirv.clear();
+		return false;
+	}
+	statistics.instructionsBefore = header.instructionsBefore;
+	statistics.bytesBefore = header.bytesBefore;
+	statistics.instructionsAfter = countInstructions(spirv);
+	statistics.bytesAfter = spirv.size() * sizeof(uint32_t);
+	return true;
+}
+
+void ShaderCompiler::WriteCache(uint64_t key, const std::vector<uint32_t>& spirv, const SpirvStatistics& statistics) const {
+	if (_cacheDirectory.empty() || spirv.empty()) return;
+
+	std::error_code error;
+	std::filesystem::create_directories(_cacheDirectory, error);
+
+	SpirvCacheHeader header = {};
+	header.magic = SpirvCacheMagic;
+	header.version = CacheVersion;
+	header.key = key;
+	header.wordCount = spirv.size();
+	header.checksum = hash_fnv1a(std::string_view(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t)));
+	header.instructionsBefore = statistics.instructionsBefore;
+	header.bytesBefore = statistics.bytesBefore;
+
+	//write to a name no other process or thread uses, then rename into place so readers never see a partial file
+	std::filesystem::path path = _cacheDirectory / CacheFilename(key);
+	std::filesystem::path tmpPath = path;
+	tmpPath += "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			errf_color(ConsoleColor::Yellow, "Could not write shader cache file %s\n", tmpPath.string().c_str());
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+		if (!file) {
+			file.close();
+			std::filesystem::remove(tmpPath, error);
+			return;
+		}
+	}
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) {
+		//another process won the race with identical contents
+		std::filesystem::remove(tmpPath, error);
+	}
+}
+
+std::vector<uint32_t> ShaderCompiler::CompileToSpirv(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force, std::unordered_set<std::string>* dependencies, SpirvStatistics* statistics) {
 	//Get file contents
 	std::ifstream f(filename);
+	if (!f) {
+		errf_color(ConsoleColor::Red, "Could not open shader %s\n", filename.c_str());
+		return std::vector<uint32_t>();
+	}
 	std::stringstream buf;
 	buf << f.rdbuf();
 
-	if (!force) {
-		//Check file hash
-		size_t newhash = std::hash<std::string>{}(buf.str());
-		auto it = _filehashes.find(filename);
-		if (it != _filehashes.end()) {
-			hashcompare = it->second == newhash;
-		}
+	shaderc::Compiler& compiler = ThreadCompiler();
+
+	//preprocessing is cheap next to a full compile and resolves every include the key depends on
+	shaderc::CompileOptions preprocessOptions;
+	SetupOptions(preprocessOptions, options);
+	auto preprocessIncluder = std::make_unique<FileIncluder>(new FileFinder());
+	FileIncluder* includer = preprocessIncluder.get();
+	preprocessOptions.SetIncluder(std::move(preprocessIncluder));
+	shaderc::PreprocessedSourceCompilationResult preprocessed = compiler.PreprocessGlsl(buf.str(), stage, filename.c_str(), preprocessOptions);
+	if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+		errf_color(ConsoleColor::Red, preprocessed.GetErrorMessage().c_str());
+		return std::vector<uint32_t>();
 	}
+	std::string preprocessedSource(preprocessed.cbegin(), preprocessed.cend());
 
-	if (hashcompare) {
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions compileoptions;
-		compileoptions.SetSourceLanguage(shaderc_source_language::shaderc_source_language_hlsl);
-		compileoptions.SetHlslFunctionality1(true);
-		compileoptions.SetTargetSpirv(shaderc_spirv_version::shaderc_spirv_version_1_5);
-		compileoptions.SetIncluder(std::make_unique<FileIncluder>(new FileFinder()));
-		//compileoptions.SetHlslIoMapping(true);
-		compileoptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-		shaderc::SpvCompilationResult compiled;
-		try {
-			compiled = compiler.CompileGlslToSpv(buf.str(), stage, filename.c_str(), compileoptions);
-		}
-		catch (const std::exception& e) {
-			errf_color(ConsoleColor::Red, e.what());
-			return std::vector<uint32_t>();
-		}
+	if (dependencies) {
+		*dependencies = includer->filepathTrace();
+	}
 
-		if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
-			errf_color(ConsoleColor::Red, compiled.GetErrorMessage().c_str());
-			return std::vector<uint32_t>();
-		}
+	uint64_t key = CacheKey(preprocessedSource, includer->filepathTrace(), stage, options);
+	std::vector<uint32_t> spirv;
+	SpirvStatistics stats;
+	if (!force && ReadCache(key, spirv, stats)) {
+		if (statistics) *statistics = stats;
+		return spirv;
+	}
+
+	//the copy carries over the include callbacks of preprocessOptions, replace them with an includer of its own
+	shaderc::CompileOptions compileoptions(preprocessOptions);
+	compileoptions.SetIncluder(std::make_unique<FileIncluder>(new FileFinder()));
+	shaderc::SpvCompilationResult compiled;
+	try {
+		compiled = compiler.CompileGlslToSpv(buf.str(), stage, filename.c_str(), options.entryPoint.c_str(), compileoptions);
+	}
+	catch (const std::exception& e) {
+		errf_color(ConsoleColor::Red, e.what());
+		return std::vector<uint32_t>();
+	}
 
-		return { compiled.cbegin(), compiled.cend() };
+	if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
+		errf_color(ConsoleColor::Red, compiled.GetErrorMessage().c_str());
+		return std::vector<uint32_t>();
 	}
+
+	spirv.assign(compiled.cbegin(), compiled.cend());
+	stats.instructionsBefore = countInstructions(spirv);
+	stats.bytesBefore = spirv.size() * sizeof(uint32_t);
+	if (!Optimize(spirv, options)) {
+		//the unoptimized module is still valid, only skip the cache so the failure shows up again next run
+		errf_color(ConsoleColor::Yellow, "Optimizing %s failed, using unoptimized SPIR-V\n", filename.c_str());
+		spirv.assign(compiled.cbegin(), compiled.cend());
+		stats.instructionsAfter = stats.instructionsBefore;
+		stats.bytesAfter = stats.bytesBefore;
+		if (statistics) *statistics = stats;
+		return spirv;
+	}
+	stats.instructionsAfter = countInstructions(spirv);
+	stats.bytesAfter = spirv.size() * sizeof(uint32_t);
+	if (statistics) *statistics = stats;
+
+	WriteCache(key, spirv, stats);
+	return spirv;
 }
 
 std::string ShaderCompiler::CompileToSpirvText(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force) {
-	bool hashcompare = true;
 	//Get file contents
 	std::ifstream f(filename);
 	std::stringstream buf;
 	buf << f.rdbuf();
 
-	if (!force) {
-		//Check file hash
-		size_t newhash = std::hash<std::string>{}(buf.str());
-		auto it = _filehashes.find(filename);
-		if (it != _filehashes.end()) {
-			hashcompare = it->second == newhash;
-		}
+	shaderc::Compiler& compiler = ThreadCompiler();
+	shaderc::CompileOptions compileoptions;
+	SetupOptions(compileoptions, options);
+	compileoptions.SetIncluder(std::make_unique<FileIncluder>(new FileFinder()));
+	shaderc::AssemblyCompilationResult compiled;
+	try {
+		compiled = compiler.CompileGlslToSpvAssembly(buf.str(), stage, filename.c_str(), options.entryPoint.c_str(), compileoptions);
+	}
+	catch (const std::exception& e) {
+		errf_color(ConsoleColor::Red, e.what());
+		return "";
 	}
 
-	if (hashcompare) {
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions compileoptions;
-		compileoptions.SetSourceLanguage(shaderc_source_language::shaderc_source_language_hlsl);
-		compileoptions.SetHlslFunctionality1(true);
-		compileoptions.SetTargetSpirv(shaderc_spirv_version::shaderc_spirv_version_1_5);
-		compileoptions.SetIncluder(std::make_unique<FileIncluder>(new FileFinder()));
-		compileoptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-		shaderc::AssemblyCompilationResult compiled;
-		try {
-			compiled = compiler.CompileGlslToSpvAssembly(buf.str(), stage, filename.c_str(), compileoptions);
-		}
-		catch (const std::exception& e) {
-			errf_color(ConsoleColor::Red, e.what());
-			return "";
-		}
-
-		if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
-			errf_color(ConsoleColor::Red, compiled.GetErrorMessage().c_str());
-			return "";
-		}
-
-		return { compiled.cbegin(), compiled.cend() };
+	if (compiled.GetCompilationStatus() != shaderc_compilation_status_success) {
+		errf_color(ConsoleColor::Red, compiled.GetErrorMessage().c_str());
+		return "";
 	}
-}
\ No newline at end of file
+
+	return { compiled.cbegin(), compiled.cend() };
+}
@@ -1,25 +1,78 @@
 #pragma once
 #include <shaderc/shaderc.hpp>
 #include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <map>
+#include <bit>
 
 namespace vrg {
+	// Identifies one variant of a shader. Everything in here takes part in the hash, two requests with equal options share a module
 	struct ShaderCompileOptions {
 		std::string name;
-		bool operator==(const ShaderCompileOptions& rhs) const {
-			return name == rhs.name;
-		};
+		// passed to the preprocessor as #define first second
+		std::vector<std::pair<std::string, std::string>> defines;
+		std::string entryPoint = "main";
+		// spirv-opt recipe run after compiling, zero skips the optimizer
+		shaderc_optimization_level optimization = shaderc_optimization_level_zero;
+		// drops names and other debug instructions. Reflection then names bindings "set.binding" and push constants by offset
+		bool stripDebugInfo = false;
+		// specialization constant id -> value, applied when pipelines are created rather than compiled into the SPIR-V.
+		// 32 bit constants use the low half
+		std::map<uint32_t, uint64_t> specializationConstants;
+
+		inline ShaderCompileOptions& Define(const std::string& macro, const std::string& value = "1") {
+			defines.emplace_back(macro, value);
+			return *this;
+		}
+		template<typename T> requires(sizeof(T) == 4 || sizeof(T) == 8)
+		inline ShaderCompileOptions& Specialize(uint32_t constantId, const T& value) {
+			if constexpr (sizeof(T) == 4) specializationConstants[constantId] = std::bit_cast<uint32_t>(value);
+			else specializationConstants[constantId] = std::bit_cast<uint64_t>(value);
+			return *this;
+		}
+		// bool specialization constants are 32 bit in Vulkan
+		inline ShaderCompileOptions& Specialize(uint32_t constantId, bool value) {
+			specializationConstants[constantId] = value ? 1 : 0;
+			return *this;
+		}
+
+		bool operator==(const ShaderCompileOptions& rhs) const = default;
+	};
+
+	// Module size straight out of glslang and after the optimizer stage
+	struct SpirvStatistics {
+		uint64_t instructionsBefore = 0;
+		uint64_t instructionsAfter = 0;
+		uint64_t bytesBefore = 0;
+		uint64_t bytesAfter = 0;
 	};
 
 	class ShaderCompiler {
 	private:
-		std::unordered_map<std::string, size_t> _filehashes;
+		// bump when the cache file layout or anything else that affects the output but isn't part of the key changes
+		static constexpr uint32_t CacheVersion = 2;
+
+		std::filesystem::path _cacheDirectory = "shadercache";
+
+		void SetupOptions(shaderc::CompileOptions& compileoptions, const ShaderCompileOptions& options) const;
+		uint64_t CacheKey(const std::string& preprocessed, const std::unordered_set<std::string>& includes, shaderc_shader_kind stage, const ShaderCompileOptions& options) const;
+		bool ReadCache(uint64_t key, std::vector<uint32_t>& spirv, SpirvStatistics& statistics) const;
+		void WriteCache(uint64_t key, const std::vector<uint32_t>& spirv, const SpirvStatistics& statistics) const;
+		bool Optimize(std::vector<uint32_t>& spirv, const ShaderCompileOptions& options) const;
+
 	public:
+		// Compiled SPIR-V is cached on disk, keyed by the preprocessed source, the contents of every included file,
+		// the compile options and the compiler version. An empty path disables the cache
+		inline void SetCacheDirectory(const std::filesystem::path& directory) { _cacheDirectory = directory; }
+		inline const std::filesystem::path& CacheDirectory() const { return _cacheDirectory; }
 
 		// Compile to spirv
-		// Returns filepath of spirv file
-		// If force is false, check stored filename hash to see if file has been changed since last compile
-		std::vector<uint32_t> CompileToSpirv(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force = false);
+		// Returns empty vector on error
+		// If force is true, the disk cache is not read, the result is still written to it
+		// dependencies receives every file the shader included and statistics the effect of the optimizer, also on cache hits
+		std::vector<uint32_t> CompileToSpirv(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force = false,
+			std::unordered_set<std::string>* dependencies = nullptr, SpirvStatistics* statistics = nullptr);
 		std::string CompileToSpirvText(const std::string& filename, shaderc_shader_kind stage, ShaderCompileOptions options, bool force = false);
 	};
 }
-
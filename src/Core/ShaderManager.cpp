@@ -1,30 +1,8 @@
 #include "ShaderManager.hpp"
-#include "spirv_cross/spirv_cross.hpp"
+#include "FileIncluder.hpp"
 
 using namespace vrg;
 
-static const std::unordered_map<spirv_cross::SPIRType::BaseType, std::vector<vk::Format>> formatMap{
-	{ spirv_cross::SPIRType::BaseType::SByte, 	{ vk::Format::eR8Snorm, 	vk::Format::eR8G8Snorm, 	vk::Format::eR8G8B8Snorm, 			vk::Format::eR8G8B8A8Snorm } },
-	{ spirv_cross::SPIRType::BaseType::UByte, 	{ vk::Format::eR8Unorm, 	vk::Format::eR8G8Unorm, 	vk::Format::eR8G8B8Unorm, 			vk::Format::eR8G8B8A8Unorm } },
-	{ spirv_cross::SPIRType::BaseType::Short, 	{ vk::Format::eR16Sint, 	vk::Format::eR16G16Sint, 	vk::Format::eR16G16B16Sint, 		vk::Format::eR16G16B16A16Sint } },
-	{ spirv_cross::SPIRType::BaseType::UShort, 	{ vk::Format::eR16Uint, 	vk::Format::eR16G16Uint, 	vk::Format::eR16G16B16Uint, 		vk::Format::eR16G16B16A16Uint } },
-	{ spirv_cross::SPIRType::BaseType::Int, 	{ vk::Format::eR32Sint, 	vk::Format::eR32G32Sint, 	vk::Format::eR32G32B32Sint, 		vk::Format::eR32G32B32A32Sint } },
-	{ spirv_cross::SPIRType::BaseType::UInt, 	{ vk::Format::eR32Uint, 	vk::Format::eR32G32Uint, 	vk::Format::eR32G32B32Uint, 		vk::Format::eR32G32B32A32Uint } },
-	{ spirv_cross::SPIRType::BaseType::Int64, 	{ vk::Format::eR64Sint, 	vk::Format::eR64G64Sint, 	vk::Format::eR64G64B64Sint, 		vk::Format::eR64G64B64A64Sint } },
-	{ spirv_cross::SPIRType::BaseType::UInt64, 	{ vk::Format::eR32Uint, 	vk::Format::eR32G32Uint, 	vk::Format::eR32G32B32Uint, 		vk::Format::eR32G32B32A32Uint } },
-	{ spirv_cross::SPIRType::BaseType::Half, 	{ vk::Format::eR16Sfloat,	vk::Format::eR16G16Sfloat,	vk::Format::eR16G16B16Sfloat,		vk::Format::eR16G16B16A16Sfloat } },
-	{ spirv_cross::SPIRType::BaseType::Float, 	{ vk::Format::eR32Sfloat,	vk::Format::eR32G32Sfloat,	vk::Format::eR32G32B32Sfloat,		vk::Format::eR32G32B32A32Sfloat } },
-	{ spirv_cross::SPIRType::BaseType::Double, 	{ vk::Format::eR64Sfloat,	vk::Format::eR64G64Sfloat,	vk::Format::eR64G64B64Sfloat,		vk::Format::eR64G64B64A64Sfloat } }
-
-};
-
-static const std::unordered_map<std::string, VertexAttributeType> semanticMap = {
-	{ "position", VertexAttributeType::Position },
-	{ "sv_position", VertexAttributeType::Position },
-	{ "normal", VertexAttributeType::Normal },
-	{ "color", VertexAttributeType::Color }
-};
-
 static const std::unordered_map<vk::ShaderStageFlagBits, shaderc_shader_kind> stageMap{
 	{vk::ShaderStageFlagBits::eVertex, shaderc_vertex_shader},
 	{vk::ShaderStageFlagBits::eFragment, shaderc_fragment_shader},
@@ -35,118 +13,266 @@ static const std::unordered_map<vk::ShaderStageFlagBits, shaderc_shader_kind> st
 };
 
 
-VertexAttributeId semanticToAttribute(const std::string& semantic) {
-	printf("%s", semantic.c_str());
-	VertexAttributeId id;
-	size_t indexPos = semantic.find_first_of("0123456789");
-	if (indexPos != std::string::npos) {
-		id.typeIndex = std::atoi(semantic.c_str() + indexPos);
-	}
-	else {
-		id.typeIndex = 0;
-		indexPos = semantic.length();
-	}
+std::shared_ptr<SpirvModule> ShaderManager::FetchFile(const std::string& filename, vk::ShaderStageFlagBits stage, ShaderCompileOptions options) {
+	return FetchFiles({ FileRequest{ filename, stage, options } })[0].get();
+}
 
-	if (indexPos > 0 && semantic[indexPos - 1] == '_') {
-		--indexPos;
+ShaderManager::CompileResult ShaderManager::Compile(const FileRequest& request) {
+	CompileResult result;
+	const ShaderCompileOptions& options = request.options;
+	std::string bundled = _bundle ? ShaderBundle::VariantName(options.name, options.defines) : std::string();
+	if (_bundle && _bundle->Contains(bundled) && _bundle->Stage(bundled) == request.stage && _bundle->EntryPoint(bundled) == options.entryPoint) {
+		result.module = _bundle->Load(_device, bundled);
+		result.module->_specializationConstants = options.specializationConstants;
+		return result;
 	}
-	std::string semanticType(semantic, 0, indexPos); //Isolate semantic type from index - EG POSITION from POSITION0 or POSITION_0
-	std::transform(semanticType.begin(), semanticType.end(), semanticType.begin(), [](auto c) { return std::tolower(c); });
-	auto it = semanticMap.find(semanticType);
-	if (it != semanticMap.end()) {
-		id.type = it->second;
+
+	std::unordered_set<std::string> includes;
+	auto spirv = _compiler.CompileToSpirv(request.filename, stageMap.at(request.stage), request.options, false, &includes, &result.statistics);
+	if (spirv.empty()) {
+		throw std::runtime_error("Failed to compile shader " + request.filename);
 	}
-	else {
-		if (semanticType.starts_with("sv_")) {
-			id.type = VertexAttributeType::SystemValue;
-		}
-		else {
-			id.type = VertexAttributeType::TexCoord;
-		}
+
+	result.module = Fetch(spirv, request.stage, request.options.entryPoint);
+	result.module->_specializationConstants = request.options.specializationConstants;
+	result.dependencies.push_back(request.filename);
+	result.dependencies.insert(result.dependencies.end(), includes.begin(), includes.end());
+	for (std::string& dependency : result.dependencies) {
+		std::error_code error;
+		auto canonical = std::filesystem::weakly_canonical(dependency, error);
+		if (!error) dependency = canonical.string();
 	}
-	return id;
+	return result;
 }
 
-std::shared_ptr<SpirvModule> ShaderManager::FetchFile(const std::string& filename, vk::ShaderStageFlagBits stage, ShaderCompileOptions options) {
-	auto it = _shaders.find(options);
-	if (it != _shaders.end()) {
-		errf_color(ConsoleColor::Yellow, "Shader %s already exists with options {}. Returning existing copy");
-		return it->second;
+void ShaderManager::RegisterDependencies(const FileRequest& request, const std::vector<std::string>& dependencies) {
+	//expects _shadersMutex to be held
+	for (const std::string& old : _dependencies[request.options]) {
+		_dependents[old].erase(request.options);
 	}
-	else {
-		auto spirv = _compiler.CompileToSpirv(filename, stageMap.at(stage), options, false);
-		auto shader = Fetch(spirv, stage);
-		_shaders.emplace(options, shader);
-		return shader;
+	_dependencies[request.options] = dependencies;
+	_requests.insert_or_assign(request.options, request);
+	for (const std::string& dependency : dependencies) {
+		_dependents[dependency].insert(request.options);
+		if (_watcher) _watcher->Watch(dependency);
 	}
 }
 
-std::shared_ptr<SpirvModule> ShaderManager::Fetch(const std::vector<uint32_t>& source, vk::ShaderStageFlagBits stage) {
+std::shared_ptr<SpirvModule> ShaderManager::CompileAndRegister(const FileRequest& request) {
+	CompileResult result = Compile(request);
 
-	auto spvmod = std::make_shared<SpirvModule>(_device, stage, source);
+	std::scoped_lock lock(_shadersMutex);
+	_shaders.emplace(request.options, result.module);
+	_lastUse[request.options] = ++_useCounter;
+	_statistics[request.options] = result.statistics;
+	RegisterDependencies(request, result.dependencies);
+	_pending.erase(request.options);
+	EvictVariants();
+	return result.module;
+}
 
-	spirv_cross::Compiler shadersource(source);
+void ShaderManager::EvictVariants() {
+	//expects _shadersMutex to be held
+	if (_shaders.size() <= _maxVariants) return;
 
-	spirv_cross::ShaderResources resources = shadersource.get_shader_resources();
+	std::vector<std::pair<uint64_t, ShaderCompileOptions>> unused;
+	for (const auto& [options, module] : _shaders) {
+		if (module.use_count() == 1) {
+			unused.emplace_back(_lastUse[options], options);
+		}
+	}
+	std::ranges::sort(unused, {}, &std::pair<uint64_t, ShaderCompileOptions>::first);
 
-	for (auto& resource : resources.stage_inputs) {
-		RasterStageVariable r;
-		r.location = shadersource.get_decoration(resource.id, spv::DecorationLocation);
-		auto type = shadersource.get_type(resource.type_id);
-		r.format = formatMap.at(type.basetype)[type.vecsize - 1];
-		r.attributeId = semanticToAttribute(shadersource.get_decoration_string(resource.id, spv::DecorationHlslSemanticGOOGLE));
+	for (const auto& [lastUse, options] : unused) {
+		if (_shaders.size() <= _maxVariants) break;
+		_shaders.erase(options);
+		_lastUse.erase(options);
+		_statistics.erase(options);
+		_requests.erase(options);
+		for (const std::string& dependency : _dependencies[options]) {
+			_dependents[dependency].erase(options);
+		}
+		_dependencies.erase(options);
+	}
+}
 
-		auto lastdot = resource.name.find_last_of('.');
-		auto cleanname = resource.name.substr(lastdot + 1);
+void ShaderManager::LoadBundle(const std::string& path) {
+	_bundle = std::make_unique<ShaderBundle>(path);
+}
+
+void ShaderManager::SetMaxResidentVariants(size_t count) {
+	std::scoped_lock lock(_shadersMutex);
+	_maxVariants = std::max<size_t>(count, 1);
+	EvictVariants();
+}
 
-		spvmod->_stageInputs.emplace(cleanname, r);
-		printf("Found input \"%s\" at location %d\n", cleanname.c_str(), r.location);
+void ShaderManager::EnableHotReload() {
+	std::scoped_lock lock(_shadersMutex);
+	if (_watcher) return;
+	_watcher = std::make_unique<FileWatcher>();
+	for (const auto& [file, dependents] : _dependents) {
+		_watcher->Watch(file);
 	}
+}
 
-	for (auto& resource : resources.stage_outputs) {
-		RasterStageVariable r;
-		r.location = shadersource.get_decoration(resource.id, spv::DecorationLocation);
-		auto type = shadersource.get_type(resource.type_id);
-		r.format = formatMap.at(type.basetype)[type.vecsize - 1];
-		r.attributeId = semanticToAttribute(shadersource.get_decoration_string(resource.id, spv::DecorationHlslSemanticGOOGLE));
+void ShaderManager::TrackPipeline(const std::shared_ptr<Pipeline>& pipeline) {
+	std::erase_if(_trackedPipelines, [](const auto& p) { return p.expired(); });
+	_trackedPipelines.emplace_back(pipeline);
+}
 
-		auto lastdot = resource.name.find_last_of('.');
-		auto cleanname = resource.name.substr(lastdot + 1);
+void ShaderManager::Update() {
+	if (!_watcher) return;
+	for (const auto& file : _watcher->PollChanges()) {
+		_changedFiles.insert(file.string());
+	}
 
-		spvmod->_stageOutputs.emplace(cleanname, r);
-		printf("Found output \"%s\" at location %d\n", cleanname.c_str(), r.location);
+	auto ready = [](const auto& future) { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+
+	if (_reload && !_reload->shaders.empty()) {
+		if (!std::ranges::all_of(_reload->shaders, [&](const auto& s) { return ready(s.second); })) return;
+		FinishShaderReload();
+	}
+	if (_reload) {
+		if (!std::ranges::all_of(_reload->pipelines, [&](const auto& p) { return ready(p.second); })) return;
+		FinishPipelineReload();
 	}
+	//changes made while a reload was running wait for the next one
+	if (!_changedFiles.empty()) {
+		StartReload();
+	}
+}
 
-	for (auto& resource : resources.uniform_buffers) {
-		unsigned set = shadersource.get_decoration(resource.id, spv::DecorationDescriptorSet);
-		unsigned binding = shadersource.get_decoration(resource.id, spv::DecorationBinding);
+void ShaderManager::StartReload() {
+	std::unordered_set<ShaderCompileOptions> affected;
+	{
+		std::scoped_lock lock(_shadersMutex);
+		for (const std::string& file : _changedFiles) {
+			auto it = _dependents.find(file);
+			if (it != _dependents.end()) {
+				affected.insert(it->second.begin(), it->second.end());
+			}
+		}
+	}
+	_changedFiles.clear();
+	if (affected.empty()) return;
+	//an edit may add an include of a header created after it was last looked for
+	IncludeCache::Shared().ClearMissing();
 
-		vrg::DescriptorBinding db;
-		db.set = set;
-		db.binding = binding;
-		db.descriptorType = vk::DescriptorType::eUniformBuffer;
-		db.stageFlags = stage;
-		db.descriptorCount = 1;
+	_reload.emplace();
+	for (const ShaderCompileOptions& options : affected) {
+		FileRequest request;
+		{
+			std::scoped_lock lock(_shadersMutex);
+			auto it = _requests.find(options);
+			if (it == _requests.end()) continue;
+			request = it->second;
+		}
+		printf("Reloading shader %s\n", request.filename.c_str());
+		_reload->shaders.emplace_back(request, _pool.Submit([this, request]() { return Compile(request); }));
+	}
+}
 
-		spvmod->_descriptorBindings.emplace(resource.name.c_str(), db);
-		printf("Found UBO \"%s\" at set:binding %d:%d\n", resource.name.c_str(), set, binding);
+void ShaderManager::FinishShaderReload() {
+	std::unordered_map<std::shared_ptr<SpirvModule>, std::shared_ptr<SpirvModule>> replaced;
+	for (auto& [request, future] : _reload->shaders) {
+		try {
+			CompileResult result = future.get();
+			std::scoped_lock lock(_shadersMutex);
+			auto shader = _shaders.find(request.options);
+			//evicted while it was recompiling
+			if (shader == _shaders.end()) continue;
+			replaced.emplace(shader->second, result.module);
+			shader->second = result.module;
+			_statistics[request.options] = result.statistics;
+			RegisterDependencies(request, result.dependencies);
+		}
+		catch (const std::exception& e) {
+			//keep running with the old module until the file is fixed
+			errf_color(ConsoleColor::Red, "Reload of %s failed: %s\n", request.filename.c_str(), e.what());
+		}
 	}
+	_reload->shaders.clear();
 
-	for (auto& resource : resources.storage_buffers) {
-		auto name = shadersource.get_name(resource.id);
-		printf("Found storage buffer \"%s\"", resource.name.c_str());
+	std::erase_if(_trackedPipelines, [](const auto& p) { return p.expired(); });
+	for (const auto& weakPipeline : _trackedPipelines) {
+		std::shared_ptr<Pipeline> pipeline = weakPipeline.lock();
+		if (!pipeline) continue;
+		std::vector<std::shared_ptr<SpirvModule>> modules = pipeline->SpirvModules();
+		bool changed = false;
+		for (auto& module : modules) {
+			auto it = replaced.find(module);
+			if (it != replaced.end()) {
+				module = it->second;
+				changed = true;
+			}
+		}
+		if (changed) {
+			_reload->pipelines.emplace_back(pipeline, _pool.Submit([pipeline, modules]() { return pipeline->Rebuild(modules); }));
+		}
 	}
+}
+
+void ShaderManager::FinishPipelineReload() {
+	for (auto& [pipeline, future] : _reload->pipelines) {
+		try {
+			std::shared_ptr<Pipeline> rebuilt = future.get();
+			//the old handles move into rebuilt, which stays alive until command buffers recorded with them are done
+			pipeline->Swap(*rebuilt);
+			rebuilt->_device.DeferDestroy(rebuilt);
+			printf("Reloaded pipeline %s\n", pipeline->Name().c_str());
+		}
+		catch (const std::exception& e) {
+			errf_color(ConsoleColor::Red, "Rebuilding pipeline %s failed: %s\n", pipeline->Name().c_str(), e.what());
+		}
+	}
+	_reload.reset();
+}
 
-	for (auto& resource : resources.subpass_inputs) {
-		auto name = shadersource.get_name(resource.id);
-		printf("Found subpass input \"%s\"", resource.name.c_str());
+std::vector<std::shared_future<std::shared_ptr<SpirvModule>>> ShaderManager::FetchFiles(const std::vector<FileRequest>& requests) {
+	std::vector<std::shared_future<std::shared_ptr<SpirvModule>>> futures;
+	futures.reserve(requests.size());
+
+	std::scoped_lock lock(_shadersMutex);
+	for (const FileRequest& request : requests) {
+		if (auto it = _shaders.find(request.options); it != _shaders.end()) {
+			_lastUse[request.options] = ++_useCounter;
+			std::promise<std::shared_ptr<SpirvModule>> ready;
+			ready.set_value(it->second);
+			futures.push_back(ready.get_future().share());
+			continue;
+		}
+		if (auto it = _pending.find(request.options); it != _pending.end()) {
+			futures.push_back(it->second);
+			continue;
+		}
+
+		std::shared_future<std::shared_ptr<SpirvModule>> future = _pool.Submit([this, request]() {
+			try {
+				return CompileAndRegister(request);
+			}
+			catch (...) {
+				std::scoped_lock lock(_shadersMutex);
+				_pending.erase(request.options);
+				throw;
+			}
+		}).share();
+		_pending.emplace(request.options, future);
+		futures.push_back(future);
 	}
+	return futures;
+}
 
-	for (auto& resource : resources.push_constant_buffers) {
-		auto name = shadersource.get_name(resource.id);
-		printf("Found push constant buffer \"%s\"", resource.name.c_str());
+std::optional<ShaderManager::FileRequest> ShaderManager::Request(const std::shared_ptr<SpirvModule>& module) {
+	std::scoped_lock lock(_shadersMutex);
+	for (const auto& [options, shader] : _shaders) {
+		if (shader != module) continue;
+		auto it = _requests.find(options);
+		if (it != _requests.end()) return it->second;
 	}
+	return std::nullopt;
+}
 
-	return spvmod;
-	//return "";
+std::shared_ptr<SpirvModule> ShaderManager::Fetch(const std::vector<uint32_t>& source, vk::ShaderStageFlagBits stage, const std::string& entryPoint) {
+	//the module reflects itself, shaders compiled to identical SPIR-V share one reflection
+	return std::make_shared<SpirvModule>(_device, stage, source, entryPoint);
 }
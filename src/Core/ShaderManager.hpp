@@ -1,13 +1,21 @@
 #pragma once
 #include "SpirvModule.hpp"
 #include "ShaderCompiler.hpp"
+#include "ThreadPool.hpp"
+#include "FileWatcher.hpp"
+#include "Pipeline.hpp"
+#include "ShaderBundle.hpp"
 
 //This is dumb but it works
 
 
 template<> struct std::hash<vrg::ShaderCompileOptions> {
 	inline size_t operator()(const vrg::ShaderCompileOptions& o) const {
-		return vrg::hash_combine(o.name);
+		size_t h = vrg::hash_combine(o.name, o.defines, o.entryPoint, o.optimization);
+		for (const auto& [id, value] : o.specializationConstants) {
+			h = vrg::hash_combine(h, id, value);
+		}
+		return h;
 	}
 };
 
@@ -15,17 +23,81 @@ static_assert(vrg::Hashable<vrg::ShaderCompileOptions>);
 
 namespace vrg {
 	class ShaderManager {
+	public:
+		struct FileRequest {
+			std::string filename;
+			vk::ShaderStageFlagBits stage;
+			ShaderCompileOptions options;
+		};
+
 	private:
 		vk::Device _device;
+		std::mutex _shadersMutex;
 		std::unordered_map<ShaderCompileOptions, std::shared_ptr<SpirvModule>> _shaders;
+		//shaders being compiled, so a second request for the same options waits on the first instead of compiling again
+		std::unordered_map<ShaderCompileOptions, std::shared_future<std::shared_ptr<SpirvModule>>> _pending;
+
+		//what each shader was compiled from, and the reverse include graph: file -> shaders that include it
+		std::unordered_map<ShaderCompileOptions, FileRequest> _requests;
+		std::unordered_map<ShaderCompileOptions, std::vector<std::string>> _dependencies;
+		std::unordered_map<std::string, std::unordered_set<ShaderCompileOptions>> _dependents;
+
+		//least recently used variants that nothing else holds are dropped once there are more than _maxVariants
+		size_t _maxVariants = std::numeric_limits<size_t>::max();
+		uint64_t _useCounter = 0;
+		std::unordered_map<ShaderCompileOptions, uint64_t> _lastUse;
+
+		std::unordered_map<ShaderCompileOptions, SpirvStatistics> _statistics;
+
+		struct CompileResult {
+			std::shared_ptr<SpirvModule> module;
+			std::vector<std::string> dependencies;
+			SpirvStatistics statistics;
+		};
+		// A hot reload in progress. Shaders compile first, then the pipelines using them are rebuilt, both on the pool.
+		// Update advances it without blocking and swaps the results in once everything finished
+		struct Reload {
+			std::vector<std::pair<FileRequest, std::future<CompileResult>>> shaders;
+			std::vector<std::pair<std::shared_ptr<Pipeline>, std::future<std::shared_ptr<Pipeline>>>> pipelines;
+		};
+		std::unique_ptr<ShaderBundle> _bundle;
+		std::unique_ptr<FileWatcher> _watcher;
+		std::unordered_set<std::string> _changedFiles;
+		std::optional<Reload> _reload;
+		std::vector<std::weak_ptr<Pipeline>> _trackedPipelines;
+
+		CompileResult Compile(const FileRequest& request);
+		std::shared_ptr<SpirvModule> CompileAndRegister(const FileRequest& request);
+		void RegisterDependencies(const FileRequest& request, const std::vector<std::string>& dependencies);
+		void EvictVariants();
+		void StartReload();
+		void FinishShaderReload();
+		void FinishPipelineReload();
+
 	public:
-		//File must be in SPIRV format
+		//File must be HLSL source. Each distinct options value is its own variant, compiled on first use
 		std::shared_ptr<SpirvModule> FetchFile(const std::string& filename, vk::ShaderStageFlagBits stage, ShaderCompileOptions options);
-		std::shared_ptr<SpirvModule> Fetch(const std::vector<uint32_t>& source, vk::ShaderStageFlagBits stage);
+		//Compiles and reflects every request on the worker pool. Shaders that already exist resolve immediately
+		std::vector<std::shared_future<std::shared_ptr<SpirvModule>>> FetchFiles(const std::vector<FileRequest>& requests);
+		std::shared_ptr<SpirvModule> Fetch(const std::vector<uint32_t>& source, vk::ShaderStageFlagBits stage, const std::string& entryPoint = "main");
+		// What a resident module was fetched from. Empty for modules made from SPIR-V and for evicted variants
+		std::optional<FileRequest> Request(const std::shared_ptr<SpirvModule>& module);
+		// Instruction counts and sizes before and after the optimizer for every resident variant
+		inline std::unordered_map<ShaderCompileOptions, SpirvStatistics> Statistics() {
+			std::scoped_lock lock(_shadersMutex);
+			return _statistics;
+		}
+		// Requests whose name, defines, stage and entry point match a bundled shader load it from the bundle
+		// instead of compiling. Bundled shaders have no source files, so they are never hot reloaded. Call before fetching anything
+		void LoadBundle(const std::string& path);
+		// Caps how many variants stay resident. Variants still referenced outside the manager are never dropped, so the count can exceed the cap
+		void SetMaxResidentVariants(size_t count);
 
 		inline std::shared_ptr<SpirvModule> Get(ShaderCompileOptions options) {
+			std::scoped_lock lock(_shadersMutex);
 			auto it = _shaders.find(options);
 			if (it != _shaders.end()) {
+				_lastUse[options] = ++_useCounter;
 				return it->second;
 			}
 			else {
@@ -34,8 +106,21 @@ namespace vrg {
 		}
 		ShaderCompiler _compiler;
 
-		inline ShaderManager(const vk::Device& device)
-			: _device(device) {}
+		// Watches every shader source and include file, changes are picked up by Update
+		void EnableHotReload();
+		// Pipelines that get rebuilt when one of their shaders is reloaded. Held weakly
+		void TrackPipeline(const std::shared_ptr<Pipeline>& pipeline);
+		// Call once per frame on the thread that records command buffers. Starts recompiles for changed files
+		// and swaps finished shaders and pipelines in. Replaced pipeline handles are destroyed once in-flight work is done
+		void Update();
+
+	private:
+		//last member so the workers are joined before anything they use is destroyed
+		ThreadPool _pool;
+
+	public:
+		inline ShaderManager(const vk::Device& device, uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency()))
+			: _device(device), _pool(threadCount) {}
 
 		inline ~ShaderManager() {
 			_shaders.clear();
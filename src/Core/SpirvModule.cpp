@@ -1,7 +1,244 @@
 #include "SpirvModule.hpp"
+#include "spirv_cross/spirv_cross.hpp"
 
 using namespace vrg;
 
+static const std::unordered_map<spirv_cross::SPIRType::BaseType, std::vector<vk::Format>> formatMap{
+	{ spirv_cross::SPIRType::BaseType::SByte, 	{ vk::Format::eR8Snorm, 	vk::Format::eR8G8Snorm, 	vk::Format::eR8G8B8Snorm, 			vk::Format::eR8G8B8A8Snorm } },
+	{ spirv_cross::SPIRType::BaseType::UByte, 	{ vk::Format::eR8Unorm, 	vk::Format::eR8G8Unorm, 	vk::Format::eR8G8B8Unorm, 			vk::Format::eR8G8B8A8Unorm } },
+	{ spirv_cross::SPIRType::BaseType::Short, 	{ vk::Format::eR16Sint, 	vk::Format::eR16G16Sint, 	vk::Format::eR16G16B16Sint, 		vk::Format::eR16G16B16A16Sint } },
+	{ spirv_cross::SPIRType::BaseType::UShort, 	{ vk::Format::eR16Uint, 	vk::Format::eR16G16Uint, 	vk::Format::eR16G16B16Uint, 		vk::Format::eR16G16B16A16Uint } },
+	{ spirv_cross::SPIRType::BaseType::Int, 	{ vk::Format::eR32Sint, 	vk::Format::eR32G32Sint, 	vk::Format::eR32G32B32Sint, 		vk::Format::eR32G32B32A32Sint } },
+	{ spirv_cross::SPIRType::BaseType::UInt, 	{ vk::Format::eR32Uint, 	vk::Format::eR32G32Uint, 	vk::Format::eR32G32B32Uint, 		vk::Format::eR32G32B32A32Uint } },
+	{ spirv_cross::SPIRType::BaseType::Int64, 	{ vk::Format::eR64Sint, 	vk::Format::eR64G64Sint, 	vk::Format::eR64G64B64Sint, 		vk::Format::eR64G64B64A64Sint } },
+	{ spirv_cross::SPIRType::BaseType::UInt64, 	{ vk::Format::eR32Uint, 	vk::Format::eR32G32Uint, 	vk::Format::eR32G32B32Uint, 		vk::Format::eR32G32B32A32Uint } },
+	{ spirv_cross::SPIRType::BaseType::Half, 	{ vk::Format::eR16Sfloat,	vk::Format::eR16G16Sfloat,	vk::Format::eR16G16B16Sfloat,		vk::Format::eR16G16B16A16Sfloat } },
+	{ spirv_cross::SPIRType::BaseType::Float, 	{ vk::Format::eR32Sfloat,	vk::Format::eR32G32Sfloat,	vk::Format::eR32G32B32Sfloat,		vk::Format::eR32G32B32A32Sfloat } },
+	{ spirv_cross::SPIRType::BaseType::Double, 	{ vk::Format::eR64Sfloat,	vk::Format::eR64G64Sfloat,	vk::Format::eR64G64B64Sfloat,		vk::Format::eR64G64B64A64Sfloat } }
+
+};
+
+static const std::unordered_map<std::string, VertexAttributeType> semanticMap = {
+	{ "position", VertexAttributeType::Position },
+	{ "sv_position", VertexAttributeType::Position },
+	{ "normal", VertexAttributeType::Normal },
+	{ "tangent", VertexAttributeType::Tangent },
+	{ "color", VertexAttributeType::Color }
+};
+
+static VertexAttributeId semanticToAttribute(const std::string& semantic) {
+	VertexAttributeId id;
+	size_t indexPos = semantic.find_first_of("0123456789");
+	if (indexPos != std::string::npos) {
+		id.typeIndex = std::atoi(semantic.c_str() + indexPos);
+	}
+	else {
+		id.typeIndex = 0;
+		indexPos = semantic.length();
+	}
+
+	if (indexPos > 0 && semantic[indexPos - 1] == '_') {
+		--indexPos;
+	}
+	std::string semanticType(semantic, 0, indexPos); //Isolate semantic type from index - EG POSITION from POSITION0 or POSITION_0
+	std::transform(semanticType.begin(), semanticType.end(), semanticType.begin(), [](auto c) { return std::tolower(c); });
+	auto it = semanticMap.find(semanticType);
+	if (it != semanticMap.end()) {
+		id.type = it->second;
+	}
+	else {
+		if (semanticType.starts_with("sv_")) {
+			id.type = VertexAttributeType::SystemValue;
+		}
+		else {
+			id.type = VertexAttributeType::TexCoord;
+		}
+	}
+	return id;
+}
+
+//HLSL names stage variables in.var.POSITION and out.var.COLOR
+static std::string cleanName(const std::string& name) {
+	return name.substr(name.find_last_of('.') + 1);
+}
+
+static std::vector<BlockMember> reflectMembers(const spirv_cross::Compiler& compiler, const spirv_cross::SPIRType& type, uint32_t typeId) {
+	std::vector<BlockMember> members;
+	for (uint32_t i = 0; i < type.member_types.size(); i++) {
+		const spirv_cross::SPIRType& memberType = compiler.get_type(type.member_types[i]);
+		BlockMember member;
+		member.name = compiler.get_member_name(typeId, i);
+		member.offset = compiler.type_struct_member_offset(type, i);
+		member.size = (uint32_t)compiler.get_declared_struct_member_size(type, i);
+		if (!memberType.array.empty()) {
+			member.arraySize = memberType.array_size_literal.back() ? memberType.array.back() : 0;
+			member.arrayStride = compiler.type_struct_member_array_stride(type, i);
+		}
+		members.push_back(std::move(member));
+	}
+	return members;
+}
+
+std::shared_ptr<const SpirvReflection> SpirvReflection::Get(std::span<const uint32_t> spirv, vk::ShaderStageFlagBits stage) {
+	static std::mutex cacheMutex;
+	//weak so reflections go away with the last module using them, hot reloading would grow the cache forever otherwise
+	static std::unordered_map<uint64_t, std::weak_ptr<const SpirvReflection>> cache;
+
+	uint64_t key = hash_combine(hash_fnv1a(std::string_view(reinterpret_cast<const char*>(spirv.data()), spirv.size_bytes())), stage);
+	{
+		std::scoped_lock lock(cacheMutex);
+		if (auto it = cache.find(key); it != cache.end()) {
+			if (auto reflection = it->second.lock()) return reflection;
+		}
+	}
+
+	//parse outside the lock, two threads racing on the same binary produce identical results
+	std::shared_ptr<const SpirvReflection> reflection(new SpirvReflection(spirv, stage));
+
+	std::scoped_lock lock(cacheMutex);
+	std::erase_if(cache, [](const auto& entry) { return entry.second.expired(); });
+	cache[key] = reflection;
+	return reflection;
+}
+
+SpirvReflection::SpirvReflection(std::span<const uint32_t> spirv, vk::ShaderStageFlagBits stage) {
+	spirv_cross::Compiler compiler(spirv.data(), spirv.size());
+	spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+	auto reflectStageVariable = [&](const spirv_cross::Resource& resource) {
+		RasterStageVariable r;
+		r.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
+		auto type = compiler.get_type(resource.type_id);
+		r.format = formatMap.at(type.basetype)[type.vecsize - 1];
+		r.attributeId = semanticToAttribute(compiler.get_decoration_string(resource.id, spv::DecorationHlslSemanticGOOGLE));
+		return r;
+	};
+
+	//stripped modules have no names left, fall back to something unique
+	auto stageVariableName = [&](const spirv_cross::Resource& resource, const RasterStageVariable& r) {
+		return resource.name.empty() ? "location" + std::to_string(r.location) : cleanName(resource.name);
+	};
+
+	for (auto& resource : resources.stage_inputs) {
+		RasterStageVariable r = reflectStageVariable(resource);
+		stageInputs.emplace(stageVariableName(resource, r), r);
+	}
+
+	for (auto& resource : resources.stage_outputs) {
+		RasterStageVariable r = reflectStageVariable(resource);
+		stageOutputs.emplace(stageVariableName(resource, r), r);
+	}
+
+	auto reflectBinding = [&](const spirv_cross::Resource& resource, vk::DescriptorType descriptorType) -> DescriptorBinding& {
+		const spirv_cross::SPIRType& type = compiler.get_type(resource.type_id);
+
+		DescriptorBinding db;
+		db.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+		db.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+		db.descriptorType = descriptorType;
+		db.stageFlags = stage;
+		db.descriptorCount = 1;
+		//arrays of arrays are flattened into one binding
+		for (size_t i = 0; i < type.array.size(); i++) {
+			if (type.array[i] == 0) {
+				db.runtimeArray = true;
+			}
+			else if (type.array_size_literal[i]) {
+				db.descriptorCount *= type.array[i];
+			}
+		}
+
+		std::string name = compiler.get_name(resource.id);
+		if (name.empty()) name = resource.name;
+		if (name.empty()) name = std::to_string(db.set) + "." + std::to_string(db.binding);
+		return descriptorBindings[name] = db;
+	};
+	auto reflectBlock = [&](const spirv_cross::Resource& resource, vk::DescriptorType descriptorType) {
+		DescriptorBinding& db = reflectBinding(resource, descriptorType);
+		const spirv_cross::SPIRType& type = compiler.get_type(resource.base_type_id);
+		db.blockSize = (uint32_t)compiler.get_declared_struct_size(type);
+		db.members = reflectMembers(compiler, type, resource.base_type_id);
+	};
+	//HLSL Buffer<> and RWBuffer<> are reflected as images with a buffer dimension
+	auto isTexelBuffer = [&](const spirv_cross::Resource& resource) {
+		return compiler.get_type(resource.type_id).image.dim == spv::DimBuffer;
+	};
+
+	for (auto& resource : resources.uniform_buffers) {
+		reflectBlock(resource, vk::DescriptorType::eUniformBuffer);
+	}
+
+	for (auto& resource : resources.storage_buffers) {
+		reflectBlock(resource, vk::DescriptorType::eStorageBuffer);
+	}
+
+	for (auto& resource : resources.storage_images) {
+		reflectBinding(resource, isTexelBuffer(resource) ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eStorageImage);
+	}
+
+	for (auto& resource : resources.sampled_images) {
+		reflectBinding(resource, vk::DescriptorType::eCombinedImageSampler);
+	}
+
+	for (auto& resource : resources.separate_images) {
+		reflectBinding(resource, isTexelBuffer(resource) ? vk::DescriptorType::eUniformTexelBuffer : vk::DescriptorType::eSampledImage);
+	}
+
+	for (auto& resource : resources.separate_samplers) {
+		reflectBinding(resource, vk::DescriptorType::eSampler);
+	}
+
+	for (auto& resource : resources.subpass_inputs) {
+		reflectBinding(resource, vk::DescriptorType::eInputAttachment).inputAttachmentIndex =
+			compiler.get_decoration(resource.id, spv::DecorationInputAttachmentIndex);
+	}
+
+	for (auto& resource : resources.acceleration_structures) {
+		reflectBinding(resource, vk::DescriptorType::eAccelerationStructureKHR);
+	}
+
+	for (auto& resource : resources.push_constant_buffers) {
+		const spirv_cross::SPIRType& type = compiler.get_type(resource.base_type_id);
+		pushConstantSize = std::max(pushConstantSize, (uint32_t)compiler.get_declared_struct_size(type));
+		for (const auto& range : compiler.get_active_buffer_ranges(resource.id)) {
+			std::string name = compiler.get_member_name(resource.base_type_id, range.index);
+			if (name.empty()) name = "offset" + std::to_string(range.offset);
+			pushConstants.emplace(name, std::make_pair((uint32_t)range.offset, (uint32_t)range.range));
+		}
+	}
+
+	for (const spirv_cross::SpecializationConstant& constant : compiler.get_specialization_constants()) {
+		const spirv_cross::SPIRType& type = compiler.get_type(compiler.get_constant(constant.id).constant_type);
+		SpecializationConstant sc;
+		sc.constantId = constant.constant_id;
+		//booleans are passed as VkBool32
+		sc.size = type.basetype == spirv_cross::SPIRType::Boolean ? sizeof(vk::Bool32) : type.width / 8;
+		std::string name = compiler.get_name(constant.id);
+		if (name.empty()) name = "constant" + std::to_string(constant.constant_id);
+		specializationConstants.emplace(name, sc);
+	}
+
+	if (stage == vk::ShaderStageFlagBits::eCompute) {
+		for (uint32_t i = 0; i < 3; i++) {
+			workgroupSize[i] = compiler.get_execution_mode_argument(spv::ExecutionModeLocalSize, i);
+		}
+		spirv_cross::SpecializationConstant x, y, z;
+		compiler.get_work_group_size_specialization_constants(x, y, z);
+		const spirv_cross::SpecializationConstant* constants[] = { &x, &y, &z };
+		for (uint32_t i = 0; i < 3; i++) {
+			if (constants[i]->id) {
+				workgroupSizeConstants[i] = constants[i]->constant_id;
+				workgroupSize[i] = compiler.get_constant(constants[i]->id).scalar();
+			}
+		}
+	}
+}
+
+//pipelines are shared by content, modules made from the same binary have to hash the same
+static size_t hashModule(std::span<const uint32_t> spirv, vk::ShaderStageFlagBits stage, const std::string& entryPoint) {
+	return hash_combine(hash_fnv1a(std::string_view(reinterpret_cast<const char*>(spirv.data()), spirv.size_bytes())), stage, entryPoint);
+}
+
 SpirvModule::SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits stage, const std::string filename, const std::string entryPoint)
 : _stage(stage), _device(device), _entryPoint(entryPoint) {
 	//printf("Reading Spirv file...");
@@ -13,6 +250,9 @@ SpirvModule::SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits
 	}
 
 	size_t fileSize = (size_t)filep.tellg();
+	if (fileSize == 0 || fileSize % sizeof(uint32_t)) {
+		throw std::runtime_error("Invalid SPIR-V file " + filename);
+	}
 	_spirv.resize(fileSize);
 	filep.seekg(0);
 	filep.read(_spirv.data(), fileSize);
@@ -27,31 +267,8 @@ SpirvModule::SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits
 		throw std::runtime_error("Failed to create shader module " + filename);
 	}
 
-	//HARDCODED FOR TESTING, REMOVE
-	if (_stage == vk::ShaderStageFlagBits::eVertex) {
-		RasterStageVariable r;
-		r.attributeId.type = VertexAttributeType::Position;
-		r.attributeId.typeIndex = 0;
-		r.format = vk::Format::eR32G32B32Sfloat;
-		r.location = 0;
-		_stageInputs.emplace("inPosition", r);
-
-		RasterStageVariable r2;
-		r2.attributeId.type = VertexAttributeType::Normal;
-		r2.attributeId.typeIndex = 0;
-		r2.format = vk::Format::eR32G32B32Sfloat;
-		r2.location = 1;
-		_stageInputs.emplace("inColor", r2);
-
-		vrg::DescriptorBinding binding;
-		binding.set = 0;
-		binding.binding = 0;
-		binding.descriptorType = vk::DescriptorType::eUniformBuffer;
-		binding.stageFlags = _stage;
-		binding.descriptorCount = 1;
-
-		_descriptorBindings.emplace("ubo", binding);
-	}
+	_reflection = SpirvReflection::Get(std::span(moduleInfo.pCode, _spirv.size() / sizeof(uint32_t)), _stage);
+	_hash = hashModule(std::span(moduleInfo.pCode, _spirv.size() / sizeof(uint32_t)), _stage, _entryPoint);
 
 	//PrintSuccessMessage();
 }
@@ -69,4 +286,19 @@ SpirvModule::SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits
 		throw std::runtime_error("Failed to create shader module");
 	}
 
-}
\ No newline at end of file
+	_reflection = SpirvReflection::Get(source, _stage);
+	_hash = hashModule(source, _stage, _entryPoint);
+}
+
+SpirvModule::SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits stage, std::span<const uint32_t> source, std::shared_ptr<const SpirvReflection> reflection, const std::string entryPoint)
+	: _stage(stage), _device(device), _entryPoint(entryPoint), _reflection(std::move(reflection)) {
+
+	vk::ShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.codeSize = source.size_bytes();
+	moduleInfo.pCode = source.data();
+
+	if (_device.createShaderModule(&moduleInfo, nullptr, &_module) != vk::Result::eSuccess) {
+		throw std::runtime_error("Failed to create shader module");
+	}
+	_hash = hashModule(source, _stage, _entryPoint);
+}
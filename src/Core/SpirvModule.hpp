@@ -10,15 +10,36 @@ namespace vrg {
 		Normal = VAT_NORMAL,
 		Color = VAT_COLOR,
 		TexCoord = VAT_TEXCOORD,
+		Tangent = VAT_TANGENT,
 		SystemValue = VAT_SYSTEMVALUE
 	};
 
+	// Layout of one member of a uniform, storage or push constant block
+	struct BlockMember {
+		std::string name;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		uint32_t arraySize = 0; //0 if the member isn't an array, runtime sized arrays also report 0 with a nonzero stride
+		uint32_t arrayStride = 0;
+	};
+
 	struct DescriptorBinding {
 		uint32_t set = 0;
 		uint32_t binding = 0;
 		uint32_t descriptorCount = 0;
 		vk::DescriptorType descriptorType = vk::DescriptorType::eSampler;
 		vk::ShaderStageFlags stageFlags = {};
+		// unsized descriptor array, descriptorCount is 1 and has to be raised by whoever builds the layout
+		bool runtimeArray = false;
+		// declared size of buffer blocks, without the trailing runtime array of storage buffers
+		uint32_t blockSize = 0;
+		std::vector<BlockMember> members;
+		uint32_t inputAttachmentIndex = ~0u;
+	};
+
+	struct SpecializationConstant {
+		uint32_t constantId = 0;
+		uint32_t size = 0;
 	};
 
 	struct VertexAttributeId {
@@ -34,6 +55,28 @@ namespace vrg {
 	};
 
 
+	// Everything pipelines and descriptor layouts need to know about a shader, parsed once per distinct SPIR-V binary
+	struct SpirvReflection {
+		std::unordered_map<std::string, DescriptorBinding> descriptorBindings;
+		std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> pushConstants;
+		uint32_t pushConstantSize = 0;
+		std::unordered_map<std::string, RasterStageVariable> stageInputs;
+		std::unordered_map<std::string, RasterStageVariable> stageOutputs;
+		std::unordered_map<std::string, SpecializationConstant> specializationConstants;
+		// LocalSize of compute shaders. workgroupSizeConstants holds the specialization constant ID of a dimension that comes
+		// from one, ~0u where the dimension is the literal in workgroupSize
+		std::array<uint32_t, 3> workgroupSize = { 1, 1, 1 };
+		std::array<uint32_t, 3> workgroupSizeConstants = { ~0u, ~0u, ~0u };
+
+		// Results are cached by the hash of the binary, the same shader loaded twice is only parsed once
+		static std::shared_ptr<const SpirvReflection> Get(std::span<const uint32_t> spirv, vk::ShaderStageFlagBits stage);
+
+	private:
+		friend class ShaderBundle;
+		SpirvReflection() = default;
+		SpirvReflection(std::span<const uint32_t> spirv, vk::ShaderStageFlagBits stage);
+	};
+
 	class SpirvModule {
 	public:
 		vk::ShaderModule _module;
@@ -42,15 +85,24 @@ namespace vrg {
 		vk::ShaderStageFlagBits _stage;
 		std::vector<char> _spirv;
 		std::string _entryPoint;
+		// of the SPIR-V, stage and entry point. Modules made from the same binary hash the same, pipelines are shared by it
+		size_t _hash = 0;
+
+		std::shared_ptr<const SpirvReflection> _reflection;
+		// constant id -> value, filled into VkSpecializationInfo by pipelines using this module
+		std::map<uint32_t, uint64_t> _specializationConstants;
 
-		std::unordered_map<std::string, DescriptorBinding> _descriptorBindings;
-		std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> _pushConstants;
-		std::unordered_map<std::string, RasterStageVariable> _stageInputs;
-		std::unordered_map<std::string, RasterStageVariable> _stageOutputs;
+		inline const SpirvReflection& Reflection() const { return *_reflection; }
+		inline const auto& DescriptorBindings() const { return _reflection->descriptorBindings; }
+		inline const auto& PushConstants() const { return _reflection->pushConstants; }
+		inline const auto& StageInputs() const { return _reflection->stageInputs; }
+		inline const auto& StageOutputs() const { return _reflection->stageOutputs; }
 
 
 		SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits stage, const std::string filename, const std::string entryPoint = "main");
 		SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits stage, const std::vector<uint32_t>& source, const std::string entryPoint = "main");
+		// Skips reflection, for modules whose reflection was stored next to their SPIR-V
+		SpirvModule(const vk::Device& device, const vk::ShaderStageFlagBits stage, std::span<const uint32_t> source, std::shared_ptr<const SpirvReflection> reflection, const std::string entryPoint = "main");
 
 		inline ~SpirvModule() {
 			_device.destroyShaderModule(_module);
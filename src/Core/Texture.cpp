@@ -1,5 +1,6 @@
 #include "Texture.hpp"
 #include "CommandBuffer.hpp"
+#include "Downsampler.hpp"
 
 using namespace vrg;
 
@@ -34,6 +35,10 @@ void Texture::Create() {
 	imageInfo.flags = _createFlags;
 	_image = _device->createImage(imageInfo);
 
+	InitAspect();
+}
+
+void Texture::InitAspect() {
 	switch (_format) {
 	default:
 		_aspectFlags = vk::ImageAspectFlagBits::eColor;
@@ -52,6 +57,8 @@ void Texture::Create() {
 		_aspectFlags = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
 		break;
 	}
+
+	_trackedStates.assign((size_t)std::popcount((VkImageAspectFlags)_aspectFlags) * _arrayLayers * _mipLevels, SubresourceState{});
 }
 
 Texture::Texture(Device& device, const std::string& name, const vk::Extent3D& extent, vk::Format format, ImageType type, uint32_t arrayLayers, uint32_t mipLevels, vk::SampleCountFlagBits sampleCount, vk::ImageUsageFlags usage, vk::ImageCreateFlags createFlags, vk::MemoryPropertyFlags memoryProperties, vk::ImageTiling tiling)
@@ -66,56 +73,172 @@ Texture::Texture(Device& device, const std::string& name, const vk::Extent3D& ex
 Texture::Texture(vk::Image image, Device& device, const std::string& name, const vk::Extent3D& extent, vk::Format format, uint32_t arrayLayers, uint32_t mipLevels, vk::SampleCountFlagBits sampleCount, vk::ImageUsageFlags usage, vk::ImageCreateFlags createFlags, vk::ImageTiling tiling)
 	: DeviceResource(device, name), _image(image), _extent(extent), _format(format), _arrayLayers(arrayLayers),
 	_mipLevels(mipLevels ? mipLevels : (sampleCount > vk::SampleCountFlagBits::e1) ? 1 : MaxMips(extent)), _sampleCount(sampleCount), _usage(usage), _createFlags(createFlags), _tiling(tiling), _type(vrg::Texture::ImageType::Auto){
-	switch (_format) {
-	default:
-		_aspectFlags = vk::ImageAspectFlagBits::eColor;
-		break;
-	case vk::Format::eD16Unorm:
-	case vk::Format::eD32Sfloat:
-		_aspectFlags = vk::ImageAspectFlagBits::eDepth;
-		break;
-	case vk::Format::eS8Uint:
-		_aspectFlags = vk::ImageAspectFlagBits::eStencil;
-		break;
-	case vk::Format::eD16UnormS8Uint:
-	case vk::Format::eD24UnormS8Uint:
-	case vk::Format::eD32SfloatS8Uint:
-	case vk::Format::eX8D24UnormPack32:
-		_aspectFlags = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
-		break;
-	}
+	InitAspect();
 }
 
-void Texture::TransitionBarrier(CommandBuffer& commandBuffer, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
-	if (oldLayout == newLayout) return;
+void Texture::TransitionBarrier(CommandBuffer& commandBuffer, const vk::ImageSubresourceRange& range, vk::ImageLayout newLayout, vk::PipelineStageFlags2KHR dstStage, vk::AccessFlags2KHR dstAccess, bool discardContents) {
+	struct Region {
+		vk::ImageAspectFlags aspect;
+		uint32_t baseMip;
+		uint32_t mipCount;
+		uint32_t baseLayer;
+		uint32_t layerCount;
+		SubresourceState state;
+	};
+
+	const uint32_t mipCount = range.levelCount == VK_REMAINING_MIP_LEVELS ? _mipLevels - range.baseMipLevel : range.levelCount;
+	const uint32_t layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? _arrayLayers - range.baseArrayLayer : range.layerCount;
+	//depth and stencil layouts can't be transitioned separately without separateDepthStencilLayouts
+	vk::ImageAspectFlags aspects = range.aspectMask & _aspectFlags;
+	if (aspects & (vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil)) {
+		aspects = _aspectFlags;
+	}
+
 	if (newLayout == vk::ImageLayout::eUndefined) {
-		_trackedLayout = newLayout;
-		_trackedStages = dstStage;
-		_trackedAccessFlags = {};
+		SetTrackedState(vk::ImageSubresourceRange(aspects, range.baseMipLevel, mipCount, range.baseArrayLayer, layerCount), SubresourceState{ newLayout, dstStage, {} });
 		return;
 	}
 
-	vk::ImageMemoryBarrier barrier = {};
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = _image;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = MipLevels();
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = ArrayLayers();
-	barrier.srcAccessMask = _trackedAccessFlags;
-	barrier.dstAccessMask = GuessAccessMask(newLayout);
-	barrier.subresourceRange.aspectMask = _aspectFlags;
-	commandBuffer.Barrier(srcStage, dstStage, barrier);
-	_trackedLayout = newLayout;
-	_trackedStages = dstStage;
-	_trackedAccessFlags = barrier.dstAccessMask;
+	std::vector<Region> regions;
+	for (vk::ImageAspectFlagBits aspect : { vk::ImageAspectFlagBits::eColor, vk::ImageAspectFlagBits::eDepth, vk::ImageAspectFlagBits::eStencil }) {
+		if (!(aspects & aspect)) continue;
+		//regions of this aspect still open to being extended by the next layer
+		const size_t aspectBegin = regions.size();
+
+		for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; ++layer) {
+			uint32_t mip = range.baseMipLevel;
+			while (mip < range.baseMipLevel + mipCount) {
+				SubresourceState& state = _trackedStates[TrackedStateIndex(mip, layer, aspect)];
+
+				//read after read in the same layout only has to be remembered, so a later write waits on this read too
+				bool needsBarrier = state.layout != newLayout || HasWriteAccess(state.access) || HasWriteAccess(dstAccess);
+				if (!needsBarrier) {
+					state.stages |= dstStage;
+					state.access |= dstAccess;
+					++mip;
+					continue;
+				}
+
+				//coalesce consecutive mips with identical state
+				const SubresourceState oldState = state;
+				uint32_t runEnd = mip + 1;
+				while (runEnd < range.baseMipLevel + mipCount && _trackedStates[TrackedStateIndex(runEnd, layer, aspect)] == oldState) ++runEnd;
+
+				//then extend a region from the previous layer covering the same mips with the same state
+				auto it = std::find_if(regions.begin() + aspectBegin, regions.end(), [&](const Region& r) {
+					return r.baseMip == mip && r.mipCount == runEnd - mip && r.baseLayer + r.layerCount == layer && r.state == oldState;
+				});
+				if (it != regions.end()) {
+					++it->layerCount;
+				}
+				else {
+					regions.push_back(Region{ aspect, mip, runEnd - mip, layer, 1, oldState });
+				}
+
+				for (uint32_t i = mip; i < runEnd; ++i) {
+					_trackedStates[TrackedStateIndex(i, layer, aspect)] = SubresourceState{ newLayout, dstStage, dstAccess };
+				}
+				mip = runEnd;
+			}
+		}
+	}
+
+	//merge aspects that share mips, layers and state
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		for (auto other = it + 1; other != regions.end();) {
+			if (other->baseMip == it->baseMip && other->mipCount == it->mipCount && other->baseLayer == it->baseLayer && other->layerCount == it->layerCount && other->state == it->state) {
+				it->aspect |= other->aspect;
+				other = regions.erase(other);
+			}
+			else {
+				++other;
+			}
+		}
+	}
+
+	for (const Region& region : regions) {
+		vk::ImageMemoryBarrier2KHR barrier = {};
+		barrier.srcStageMask = region.state.stages;
+		//only writes have to be made available, reads just need the execution dependency
+		barrier.srcAccessMask = WriteAccess(region.state.access);
+		barrier.dstStageMask = dstStage;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = discardContents ? vk::ImageLayout::eUndefined : region.state.layout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = _image;
+		barrier.subresourceRange = vk::ImageSubresourceRange(region.aspect, region.baseMip, region.mipCount, region.baseLayer, region.layerCount);
+		commandBuffer.Barrier(barrier);
+	}
+}
+
+void Texture::SetTrackedState(const vk::ImageSubresourceRange& range, const SubresourceState& state) {
+	const uint32_t mipCount = range.levelCount == VK_REMAINING_MIP_LEVELS ? _mipLevels - range.baseMipLevel : range.levelCount;
+	const uint32_t layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? _arrayLayers - range.baseArrayLayer : range.layerCount;
+	for (vk::ImageAspectFlagBits aspect : { vk::ImageAspectFlagBits::eColor, vk::ImageAspectFlagBits::eDepth, vk::ImageAspectFlagBits::eStencil }) {
+		if (!(range.aspectMask & _aspectFlags & aspect)) continue;
+		for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; ++layer) {
+			for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + mipCount; ++mip) {
+				_trackedStates[TrackedStateIndex(mip, layer, aspect)] = state;
+			}
+		}
+	}
+}
+
+bool Texture::SupportsBlitMipMaps() const {
+	vk::FormatFeatureFlags features = _device.FormatFeatures(_format, _tiling);
+	return (features & vk::FormatFeatureFlagBits::eBlitSrc) && (features & vk::FormatFeatureFlagBits::eBlitDst) &&
+		(_usage & vk::ImageUsageFlagBits::eTransferSrc) && (_usage & vk::ImageUsageFlagBits::eTransferDst);
 }
 
-void Texture::GenerateMipMaps(CommandBuffer& commandBuffer) {
-	// TODO
+bool Texture::GenerateMipMaps(CommandBuffer& commandBuffer, Downsampler* downsampler, vk::ImageLayout finalLayout) {
+	if (_mipLevels <= 1) {
+		TransitionBarrier(commandBuffer, finalLayout);
+		return true;
+	}
+
+	if (downsampler && downsampler->Supports(*this)) {
+		downsampler->Generate(commandBuffer, shared_from_this());
+	}
+	else if (SupportsBlitMipMaps()) {
+		BlitMipMaps(commandBuffer);
+	}
+	else {
+		errf_color(ConsoleColor::Yellow, "Cannot generate mips for %s: format supports neither blit nor storage\n", Name().c_str());
+		return false;
+	}
+
+	TransitionBarrier(commandBuffer, finalLayout);
+	return true;
+}
+
+void Texture::BlitMipMaps(CommandBuffer& commandBuffer) {
+	//linear filtering is optional per format, depth/stencil must always be blit with nearest
+	vk::Filter filter = vk::Filter::eNearest;
+	if ((_aspectFlags & vk::ImageAspectFlagBits::eColor) && (_device.FormatFeatures(_format, _tiling) & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
+		filter = vk::Filter::eLinear;
+	}
+
+	//mip 0 becomes the first source, the rest are overwritten so their contents can be discarded
+	TransitionBarrier(commandBuffer, vk::ImageSubresourceRange(_aspectFlags, 0, 1, 0, _arrayLayers), vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2KHR::eBlit, vk::AccessFlagBits2KHR::eTransferRead);
+	TransitionBarrier(commandBuffer, vk::ImageSubresourceRange(_aspectFlags, 1, _mipLevels - 1, 0, _arrayLayers), vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits2KHR::eBlit, vk::AccessFlagBits2KHR::eTransferWrite, true);
+
+	vk::Offset3D srcExtent((int32_t)_extent.width, (int32_t)_extent.height, (int32_t)_extent.depth);
+	for (uint32_t i = 1; i < _mipLevels; ++i) {
+		vk::Offset3D dstExtent(std::max(1, srcExtent.x / 2), std::max(1, srcExtent.y / 2), std::max(1, srcExtent.z / 2));
+
+		vk::ImageBlit blit = {};
+		blit.srcSubresource = vk::ImageSubresourceLayers(_aspectFlags, i - 1, 0, _arrayLayers);
+		blit.srcOffsets[1] = srcExtent;
+		blit.dstSubresource = vk::ImageSubresourceLayers(_aspectFlags, i, 0, _arrayLayers);
+		blit.dstOffsets[1] = dstExtent;
+		commandBuffer.BlitImage(*this, *this, blit, filter);
+
+		//mip i is the source of the next blit
+		TransitionBarrier(commandBuffer, vk::ImageSubresourceRange(_aspectFlags, i, 1, 0, _arrayLayers), vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2KHR::eBlit, vk::AccessFlagBits2KHR::eTransferRead);
+		srcExtent = dstExtent;
+	}
 }
 
 Texture::View::View(std::shared_ptr<vrg::Texture> texture, uint32_t baseMip, uint32_t mipCount, uint32_t baseLayer, uint32_t layerCount, vk::ImageAspectFlags aspect, vk::ComponentMapping components)
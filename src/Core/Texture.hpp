@@ -4,72 +4,86 @@
 
 namespace vrg {
 
-	inline vk::AccessFlags GuessAccessMask(vk::ImageLayout layout) {
+	class Downsampler;
+
+	// Default access and stages for a layout, used when the caller doesn't state the exact consumer
+	inline vk::AccessFlags2KHR GuessAccessMask(vk::ImageLayout layout) {
 		switch (layout) {
 		case vk::ImageLayout::eUndefined:
 		case vk::ImageLayout::ePresentSrcKHR:
+			return vk::AccessFlagBits2KHR::eNone;
+
 		case vk::ImageLayout::eColorAttachmentOptimal:
-			return {};
+			return vk::AccessFlagBits2KHR::eColorAttachmentRead | vk::AccessFlagBits2KHR::eColorAttachmentWrite;
 
 		case vk::ImageLayout::eGeneral:
-			return vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+			return vk::AccessFlagBits2KHR::eShaderStorageRead | vk::AccessFlagBits2KHR::eShaderStorageWrite;
 
 		case vk::ImageLayout::eDepthAttachmentOptimal:
 		case vk::ImageLayout::eStencilAttachmentOptimal:
 		case vk::ImageLayout::eDepthReadOnlyStencilAttachmentOptimal:
 		case vk::ImageLayout::eDepthAttachmentStencilReadOnlyOptimal:
 		case vk::ImageLayout::eDepthStencilAttachmentOptimal:
-			return vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+			return vk::AccessFlagBits2KHR::eDepthStencilAttachmentRead | vk::AccessFlagBits2KHR::eDepthStencilAttachmentWrite;
 
 		case vk::ImageLayout::eDepthReadOnlyOptimal:
 		case vk::ImageLayout::eStencilReadOnlyOptimal:
 		case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
-			return vk::AccessFlagBits::eDepthStencilAttachmentRead;
+			return vk::AccessFlagBits2KHR::eDepthStencilAttachmentRead;
 
 		case vk::ImageLayout::eShaderReadOnlyOptimal:
-			return vk::AccessFlagBits::eShaderRead;
+			return vk::AccessFlagBits2KHR::eShaderSampledRead;
 		case vk::ImageLayout::eTransferSrcOptimal:
-			return vk::AccessFlagBits::eTransferRead;
+			return vk::AccessFlagBits2KHR::eTransferRead;
 		case vk::ImageLayout::eTransferDstOptimal:
-			return vk::AccessFlagBits::eTransferWrite;
+			return vk::AccessFlagBits2KHR::eTransferWrite;
 		}
-		return vk::AccessFlagBits::eShaderRead;
+		return vk::AccessFlagBits2KHR::eShaderRead;
+	}
+	inline vk::AccessFlags2KHR WriteAccess(vk::AccessFlags2KHR access) {
+		return access & (vk::AccessFlagBits2KHR::eShaderWrite | vk::AccessFlagBits2KHR::eShaderStorageWrite | vk::AccessFlagBits2KHR::eColorAttachmentWrite |
+			vk::AccessFlagBits2KHR::eDepthStencilAttachmentWrite | vk::AccessFlagBits2KHR::eTransferWrite | vk::AccessFlagBits2KHR::eHostWrite | vk::AccessFlagBits2KHR::eMemoryWrite);
+	}
+	inline bool HasWriteAccess(vk::AccessFlags2KHR access) {
+		return (bool)WriteAccess(access);
 	}
-	inline vk::PipelineStageFlags GuessStage(vk::ImageLayout layout) {
+	inline vk::PipelineStageFlags2KHR GuessStage(vk::ImageLayout layout) {
 		switch (layout) {
 		case vk::ImageLayout::eGeneral:
-			return vk::PipelineStageFlagBits::eComputeShader;
+			return vk::PipelineStageFlagBits2KHR::eComputeShader;
 
 		case vk::ImageLayout::eColorAttachmentOptimal:
-			return vk::PipelineStageFlagBits::eColorAttachmentOutput;
+			return vk::PipelineStageFlagBits2KHR::eColorAttachmentOutput;
 
 		case vk::ImageLayout::eShaderReadOnlyOptimal:
 		case vk::ImageLayout::eDepthReadOnlyOptimal:
 		case vk::ImageLayout::eStencilReadOnlyOptimal:
 		case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
-			return vk::PipelineStageFlagBits::eFragmentShader;
+			return vk::PipelineStageFlagBits2KHR::eFragmentShader;
 
 		case vk::ImageLayout::eTransferSrcOptimal:
 		case vk::ImageLayout::eTransferDstOptimal:
-			return vk::PipelineStageFlagBits::eTransfer;
+			return vk::PipelineStageFlagBits2KHR::eAllTransfer;
 
 		case vk::ImageLayout::eDepthAttachmentStencilReadOnlyOptimal:
 		case vk::ImageLayout::eDepthStencilAttachmentOptimal:
 		case vk::ImageLayout::eStencilAttachmentOptimal:
 		case vk::ImageLayout::eDepthAttachmentOptimal:
 		case vk::ImageLayout::eDepthReadOnlyStencilAttachmentOptimal:
-			return vk::PipelineStageFlagBits::eLateFragmentTests;
+			return vk::PipelineStageFlagBits2KHR::eEarlyFragmentTests | vk::PipelineStageFlagBits2KHR::eLateFragmentTests;
 
+		//nothing on the device touches these, ordering comes from semaphores
 		case vk::ImageLayout::ePresentSrcKHR:
 		case vk::ImageLayout::eSharedPresentKHR:
-			return vk::PipelineStageFlagBits::eBottomOfPipe;
+		case vk::ImageLayout::eUndefined:
+			return vk::PipelineStageFlagBits2KHR::eNone;
 
 		default:
-			return vk::PipelineStageFlagBits::eTopOfPipe;
+			return vk::PipelineStageFlagBits2KHR::eAllCommands;
 		}
 	}
 
-	class Texture : public DeviceResource {
+	class Texture : public DeviceResource, public std::enable_shared_from_this<Texture> {
 	public:
 		static constexpr uint32_t MaxMips(const vk::Extent3D& extent) {
 			return 32 - (uint32_t)std::countl_zero(std::max(std::max(extent.width, extent.height), extent.depth));
@@ -77,6 +91,14 @@ namespace vrg {
 
 		class View;
 
+		// Last known state of one (mip, layer, aspect) subresource
+		struct SubresourceState {
+			vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+			vk::PipelineStageFlags2KHR stages = vk::PipelineStageFlagBits2KHR::eNone;
+			vk::AccessFlags2KHR access = vk::AccessFlagBits2KHR::eNone;
+			bool operator==(const SubresourceState&) const = default;
+		};
+
 		enum ImageType {
 			Auto = 3,
 			Three = vk::ImageType::e3D,
@@ -120,12 +142,32 @@ namespace vrg {
 		inline uint32_t ArrayLayers() const { return _arrayLayers; }
 		inline vk::ImageAspectFlags AspectFlags() const { return _aspectFlags; }
 		inline vk::ImageCreateFlags CreateFlags() const { return _createFlags; }
-
-		void GenerateMipMaps(vrg::CommandBuffer& commandBuffer);
-
-		void TransitionBarrier(vrg::CommandBuffer& commandBuffer, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+		inline vk::ImageTiling Tiling() const { return _tiling; }
+
+		// Fills mips 1..n from mip 0 and leaves the whole image in finalLayout.
+		// Uses the single dispatch compute downsampler when one is given and it supports this texture, otherwise a blit chain.
+		// The compute path does not need a graphics queue, so it can be recorded on a compute queue command buffer off the frame's critical path.
+		// Returns false if the format supports neither path
+		bool GenerateMipMaps(vrg::CommandBuffer& commandBuffer, vrg::Downsampler* downsampler = nullptr, vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+		bool SupportsBlitMipMaps() const;
+
+		inline vk::ImageSubresourceRange FullRange() const { return vk::ImageSubresourceRange(_aspectFlags, 0, _mipLevels, 0, _arrayLayers); }
+
+		// Moves every subresource in range to newLayout, recording barriers only for subresources whose state requires one.
+		// Subresources sharing the same previous state are coalesced into as few barriers as possible.
+		// If discardContents is set, the previous contents are not preserved across the layout change
+		void TransitionBarrier(vrg::CommandBuffer& commandBuffer, const vk::ImageSubresourceRange& range, vk::ImageLayout newLayout, vk::PipelineStageFlags2KHR dstStage, vk::AccessFlags2KHR dstAccess, bool discardContents = false);
+		inline void TransitionBarrier(vrg::CommandBuffer& commandBuffer, const vk::ImageSubresourceRange& range, vk::ImageLayout newLayout) {
+			TransitionBarrier(commandBuffer, range, newLayout, GuessStage(newLayout), GuessAccessMask(newLayout));
+		}
 		inline void TransitionBarrier(vrg::CommandBuffer& commandBuffer, vk::ImageLayout newLayout) {
-			TransitionBarrier(commandBuffer, _trackedStages, GuessStage(newLayout), _trackedLayout, newLayout);
+			TransitionBarrier(commandBuffer, FullRange(), newLayout);
+		}
+
+		// Records state changes made outside of TransitionBarrier, such as render pass final layouts
+		void SetTrackedState(const vk::ImageSubresourceRange& range, const SubresourceState& state);
+		inline const SubresourceState& TrackedState(uint32_t mip, uint32_t layer, vk::ImageAspectFlagBits aspect = vk::ImageAspectFlagBits::eColor) const {
+			return _trackedStates[TrackedStateIndex(mip, layer, aspect)];
 		}
 
 		class View {
@@ -151,6 +193,7 @@ namespace vrg {
 
 			inline const vk::ImageView& operator*() const { return _view; }
 			inline const vk::ImageView* operator->() const { return &_view; }
+			inline vk::ImageSubresourceRange SubresourceRange() const { return vk::ImageSubresourceRange(_aspect, _baseMip, _mipCount, _baseLayer, _layerCount); }
 			inline std::shared_ptr<Texture> TexturePtr() const { return _texture; }
 			inline Texture& Texture() const { return *_texture; }
 		};
@@ -176,11 +219,19 @@ namespace vrg {
 
 		std::unordered_map<size_t, vk::ImageView> _views;
 
-		vk::ImageLayout _trackedLayout = vk::ImageLayout::eUndefined;
-		vk::PipelineStageFlags _trackedStages = vk::PipelineStageFlagBits::eTopOfPipe;
-		vk::AccessFlags _trackedAccessFlags = {};
+		// indexed by TrackedStateIndex, mips vary fastest so mip ranges of a layer are contiguous
+		std::vector<SubresourceState> _trackedStates;
+
+		inline uint32_t AspectIndex(vk::ImageAspectFlagBits aspect) const {
+			return (uint32_t)std::popcount((VkImageAspectFlags)_aspectFlags & ((VkImageAspectFlags)aspect - 1));
+		}
+		inline size_t TrackedStateIndex(uint32_t mip, uint32_t layer, vk::ImageAspectFlagBits aspect) const {
+			return ((size_t)AspectIndex(aspect) * _arrayLayers + layer) * _mipLevels + mip;
+		}
 
 		void Create();
+		void InitAspect();
+		void BlitMipMaps(vrg::CommandBuffer& commandBuffer);
 
 	};
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Util.hpp"
+
+#include <condition_variable>
+#include <future>
+
+namespace vrg {
+
+	// Fixed set of worker threads pulling tasks from one queue
+	class ThreadPool {
+	private:
+		std::vector<std::thread> _workers;
+		std::deque<std::function<void()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _stop = false;
+
+		inline void WorkerLoop() {
+			while (true) {
+				std::function<void()> task;
+				{
+					std::unique_lock lock(_mutex);
+					_condition.wait(lock, [&]() { return _stop || !_tasks.empty(); });
+					if (_tasks.empty()) return;
+					task = std::move(_tasks.front());
+					_tasks.pop_front();
+				}
+				task();
+			}
+		}
+
+	public:
+		inline ThreadPool(uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+			_workers.reserve(threadCount);
+			for (uint32_t i = 0; i < threadCount; i++) {
+				_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+			}
+		}
+		// Runs every queued task before joining
+		inline ~ThreadPool() {
+			{
+				std::scoped_lock lock(_mutex);
+				_stop = true;
+			}
+			_condition.notify_all();
+			for (std::thread& worker : _workers) {
+				worker.join();
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		inline size_t ThreadCount() const { return _workers.size(); }
+
+		// Exceptions thrown by the task are rethrown by the returned future
+		template<typename F, typename R = std::invoke_result_t<std::decay_t<F>>>
+		inline std::future<R> Submit(F&& f) {
+			//std::function needs a copyable target, packaged_task is move only
+			auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+			std::future<R> future = task->get_future();
+			{
+				std::scoped_lock lock(_mutex);
+				if (_stop) throw std::runtime_error("Submitting to a stopped ThreadPool");
+				_tasks.emplace_back([task]() { (*task)(); });
+			}
+			_condition.notify_one();
+			return future;
+		}
+
+		// Runs f(i) for every i in [begin, end) split into chunks across the pool, blocks until all are done.
+		// The first exception thrown by f is rethrown once every chunk finished
+		template<typename F>
+		inline void ParallelFor(size_t begin, size_t end, F&& f, size_t minChunk = 1) {
+			if (end <= begin) return;
+			size_t count = end - begin;
+			size_t chunk = std::max(minChunk, (count + ThreadCount() - 1) / ThreadCount());
+			std::vector<std::future<void>> futures;
+			for (size_t start = begin; start < end; start += chunk) {
+				size_t stop = std::min(end, start + chunk);
+				futures.push_back(Submit([&f, start, stop]() {
+					for (size_t i = start; i < stop; i++) f(i);
+				}));
+			}
+			//chunks reference f and whatever it captured, none may still be running when this returns or throws
+			std::exception_ptr exception;
+			for (auto& future : futures) {
+				try {
+					future.get();
+				}
+				catch (...) {
+					if (!exception) exception = std::current_exception();
+				}
+			}
+			if (exception) std::rethrow_exception(exception);
+		}
+	};
+
+}
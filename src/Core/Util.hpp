@@ -118,6 +118,74 @@ inline constexpr vk::IndexType stride_to_index_type(vk::DeviceSize stride) {
 	}
 }
 
+//size in bytes of one texel of an uncompressed format, 0 for formats without a fixed texel size
+inline constexpr vk::DeviceSize texel_size(vk::Format format) {
+	switch (format) {
+	case vk::Format::eR8Unorm:
+	case vk::Format::eR8Snorm:
+	case vk::Format::eR8Uint:
+	case vk::Format::eR8Sint:
+	case vk::Format::eR8Srgb:
+	case vk::Format::eS8Uint:
+		return 1;
+	case vk::Format::eR8G8Unorm:
+	case vk::Format::eR8G8Snorm:
+	case vk::Format::eR8G8Uint:
+	case vk::Format::eR8G8Sint:
+	case vk::Format::eR8G8Srgb:
+	case vk::Format::eR16Unorm:
+	case vk::Format::eR16Snorm:
+	case vk::Format::eR16Uint:
+	case vk::Format::eR16Sint:
+	case vk::Format::eR16Sfloat:
+	case vk::Format::eD16Unorm:
+		return 2;
+	case vk::Format::eR8G8B8Unorm:
+	case vk::Format::eR8G8B8Srgb:
+	case vk::Format::eB8G8R8Unorm:
+	case vk::Format::eB8G8R8Srgb:
+		return 3;
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Snorm:
+	case vk::Format::eR8G8B8A8Uint:
+	case vk::Format::eR8G8B8A8Sint:
+	case vk::Format::eR8G8B8A8Srgb:
+	case vk::Format::eB8G8R8A8Unorm:
+	case vk::Format::eB8G8R8A8Srgb:
+	case vk::Format::eA2B10G10R10UnormPack32:
+	case vk::Format::eA2R10G10B10UnormPack32:
+	case vk::Format::eB10G11R11UfloatPack32:
+	case vk::Format::eE5B9G9R9UfloatPack32:
+	case vk::Format::eR16G16Unorm:
+	case vk::Format::eR16G16Snorm:
+	case vk::Format::eR16G16Sfloat:
+	case vk::Format::eR32Uint:
+	case vk::Format::eR32Sint:
+	case vk::Format::eR32Sfloat:
+	case vk::Format::eD32Sfloat:
+	case vk::Format::eX8D24UnormPack32:
+		return 4;
+	case vk::Format::eR16G16B16A16Unorm:
+	case vk::Format::eR16G16B16A16Snorm:
+	case vk::Format::eR16G16B16A16Uint:
+	case vk::Format::eR16G16B16A16Sfloat:
+	case vk::Format::eR32G32Uint:
+	case vk::Format::eR32G32Sint:
+	case vk::Format::eR32G32Sfloat:
+		return 8;
+	case vk::Format::eR32G32B32Uint:
+	case vk::Format::eR32G32B32Sint:
+	case vk::Format::eR32G32B32Sfloat:
+		return 12;
+	case vk::Format::eR32G32B32A32Uint:
+	case vk::Format::eR32G32B32A32Sint:
+	case vk::Format::eR32G32B32A32Sfloat:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
 inline uint64_t to_set_binding(uint32_t binding, uint32_t index) {
 	return (uint64_t(binding) << 32 | index);
 }
@@ -44,6 +44,10 @@ void Window::AcquireNextImage(CommandBuffer& commandBuffer) {
 		result = (*_swapchainDevice)->acquireNextImageKHR(_swapchain, UINT64_MAX, **_imageAvailableSemaphores[_imageAvailableSemaphoreIndex], {});
 	}
 	_backbufferIndex = result.value;
+
+	//the acquire semaphore is waited on at color attachment output, so the layout transition out of present has to start from that stage to chain with it
+	Texture::View& backBuffer = _swapchainImages[_backbufferIndex];
+	backBuffer.Texture().SetTrackedState(backBuffer.SubresourceRange(), { vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits2KHR::eColorAttachmentOutput, vk::AccessFlagBits2KHR::eNone });
 }
 
 void Window::Present(const std::vector<vk::Semaphore>& waitSemaphores) {
@@ -119,6 +123,10 @@ void Window::CreateSwapchain(CommandBuffer& commandBuffer) {
 	swapchainInfo.imageExtent = _extent;
 	swapchainInfo.imageArrayLayers = 1;
 	swapchainInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+	//lets frames be read back for capture
+	if (supportDetails.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc) {
+		swapchainInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+	}
 	swapchainInfo.imageSharingMode = vk::SharingMode::eExclusive;
 	swapchainInfo.preTransform = supportDetails.capabilities.currentTransform;
 	swapchainInfo.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
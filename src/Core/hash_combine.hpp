@@ -9,6 +9,7 @@
 #include <optional>
 #include <bit>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <deque>
 #include <forward_list>
@@ -68,6 +69,15 @@ namespace vrg {
 		return hash_tuple(t, std::make_index_sequence<tuple_size_v<_Tuple>-1>());
 	}
 
+	// 64 bit FNV-1a, unlike std::hash the result is the same across runs and platforms so it can name files on disk
+	constexpr uint64_t hash_fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ull) {
+		for (char c : data) {
+			hash ^= (uint8_t)c;
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
 	// accepts string literals
 	template<typename T, size_t N>
 	constexpr size_t hash_array(const T(&arr)[N], size_t n = N - 1) {
@@ -5,3 +5,4 @@
 #define VAT_NORMAL 2
 #define VAT_COLOR 3
 #define VAT_TEXCOORD 4
+#define VAT_TANGENT 5
@@ -0,0 +1,32 @@
+#ifndef VERTEX_DECODE_H
+#define VERTEX_DECODE_H
+
+// Decodes vertex attributes MeshQuantizer stored in compact formats. Normalized and half formats already arrive as float,
+// only octahedral directions need work. Compile with Geometry::DecodeDefines() so the variant matches the mesh
+
+float3 OctahedralDecode(float2 e) {
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    //folded lower hemisphere
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+float3 DecodeNormal(float3 normal) {
+#if VRG_NORMAL_OCTAHEDRAL
+    return OctahedralDecode(normal.xy);
+#else
+    return normal;
+#endif
+}
+
+float4 DecodeTangent(float4 tangent) {
+#if VRG_TANGENT_OCTAHEDRAL
+    return float4(OctahedralDecode(tangent.xy), tangent.w < 0.0 ? -1.0 : 1.0);
+#else
+    return tangent;
+#endif
+}
+
+#endif
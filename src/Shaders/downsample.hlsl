@@ -0,0 +1,97 @@
+#pragma shader_stage(compute)
+
+// Single pass downsampler
+// Every workgroup reduces a 64x64 tile of mip 0 into mips 1-6 through groupshared memory.
+// The last workgroup to finish (found with a global atomic counter) then reduces mip 6 into the remaining mips.
+
+#define MAX_MIPS 13
+
+struct PushConstants {
+    uint mipCount;          // number of mips to generate, not counting mip 0
+    uint workGroupCount;
+};
+
+[[vk::push_constant]] PushConstants pc;
+
+[[vk::binding(0, 0)]] globallycoherent RWTexture2D<float4> Mips[MAX_MIPS];
+[[vk::binding(1, 0)]] globallycoherent RWStructuredBuffer<uint> Counter;
+
+groupshared float4 Tile[32][32];
+groupshared uint IsLastGroup;
+
+float4 LoadMip(uint mip, int2 coord) {
+    uint w, h;
+    Mips[mip].GetDimensions(w, h);
+    return Mips[mip][min(coord, int2(w, h) - 1)];
+}
+
+void StoreMip(uint mip, int2 coord, float4 value) {
+    uint w, h;
+    Mips[mip].GetDimensions(w, h);
+    if (coord.x < int(w) && coord.y < int(h)) {
+        Mips[mip][coord] = value;
+    }
+}
+
+// Reduces the 64x64 block of mip 'base' at 'tile' into mips base+1 .. base+6, stopping after pc.mipCount
+void ReduceTile(uint base, uint2 tile, uint localIndex) {
+    // base+1 is 32x32, four texels per thread
+    [unroll]
+    for (uint i = 0; i < 4; i++) {
+        uint index = localIndex + i * 256;
+        uint2 p = uint2(index % 32, index / 32);
+        int2 src = int2(tile * 64 + p * 2);
+        float4 v = 0.25 * (LoadMip(base, src) + LoadMip(base, src + int2(1, 0)) + LoadMip(base, src + int2(0, 1)) + LoadMip(base, src + int2(1, 1)));
+        StoreMip(base + 1, int2(tile * 32 + p), v);
+        Tile[p.y][p.x] = v;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint size = 32;
+    [unroll]
+    for (uint level = 2; level <= 6; level++) {
+        size /= 2;
+        if (base + level > pc.mipCount) {
+            return;
+        }
+
+        uint2 p = uint2(localIndex % size, localIndex / size);
+        float4 v = 0;
+        if (localIndex < size * size) {
+            v = 0.25 * (Tile[p.y * 2][p.x * 2] + Tile[p.y * 2][p.x * 2 + 1] + Tile[p.y * 2 + 1][p.x * 2] + Tile[p.y * 2 + 1][p.x * 2 + 1]);
+            StoreMip(base + level, int2(tile * size + p), v);
+        }
+        GroupMemoryBarrierWithGroupSync();
+        if (localIndex < size * size) {
+            Tile[p.y][p.x] = v;
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint localIndex : SV_GroupIndex) {
+    ReduceTile(0, groupId.xy, localIndex);
+    if (pc.mipCount <= 6) {
+        return;
+    }
+
+    // make this group's mip 6 texel visible to the other groups before counting it as finished
+    DeviceMemoryBarrierWithGroupSync();
+    if (localIndex == 0) {
+        uint previous;
+        InterlockedAdd(Counter[0], 1, previous);
+        IsLastGroup = (previous == pc.workGroupCount - 1) ? 1 : 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+    if (IsLastGroup == 0) {
+        return;
+    }
+
+    ReduceTile(6, uint2(0, 0), localIndex);
+
+    // leave the counter ready for the next dispatch
+    if (localIndex == 0) {
+        Counter[0] = 0;
+    }
+}
@@ -1,6 +1,7 @@
 #pragma shader_stage(vertex)
 
 #include "ShaderDefines.h"
+#include "VertexDecode.h"
 
 struct VSInput {
     [[vk::location(VAT_POSITION)]] float3 Position : POSITION;
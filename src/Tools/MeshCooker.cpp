@@ -0,0 +1,90 @@
+#include "Core/MeshBundle.hpp"
+#include "Core/GltfLoader.hpp"
+#include "Core/MeshOptimizer.hpp"
+#include "Core/MeshQuantizer.hpp"
+
+using namespace vrg;
+
+//imports a glTF file and writes its meshes as a mesh bundle, laid out exactly as the runtime uploads them
+
+//packs every attribute of a mesh into one binding, one vertex fetch reads all of them from the same cache lines
+static std::vector<std::byte> interleave(std::vector<Mesh::Layout>& layouts, const std::vector<std::byte>& data) {
+	std::vector<std::byte> out;
+	auto align = [&]() { out.resize((out.size() + 15) & ~size_t(15)); };
+	for (Mesh::Layout& layout : layouts) {
+		std::vector<Mesh::Layout::Attribute> attributes = layout.attributes;
+		uint32_t stride = 0;
+		for (Mesh::Layout::Attribute& attribute : attributes) {
+			vk::DeviceSize size = texel_size(attribute.format);
+			if (!size) throw std::runtime_error("Can't interleave " + vk::to_string(attribute.format) + " attributes of " + layout.name);
+			attribute.binding = 0;
+			attribute.offset = stride;
+			//vertex attributes have to start 4 byte aligned
+			stride += (uint32_t)((size + 3) & ~3ull);
+		}
+
+		align();
+		Mesh::Layout::Binding binding = { out.size(), stride };
+		out.resize(out.size() + (size_t)layout.vertexCount * stride);
+		for (size_t a = 0; a < attributes.size(); a++) {
+			const Mesh::Layout::Attribute& source = layout.attributes[a];
+			const Mesh::Layout::Binding& sourceBinding = layout.bindings[source.binding];
+			size_t size = texel_size(source.format);
+			for (uint32_t v = 0; v < layout.vertexCount; v++) {
+				memcpy(out.data() + binding.offset + (size_t)v * stride + attributes[a].offset, data.data() + sourceBinding.offset + (size_t)v * sourceBinding.stride + source.offset, size);
+			}
+		}
+		layout.bindings = stride ? std::vector<Mesh::Layout::Binding>{ binding } : std::vector<Mesh::Layout::Binding>{};
+		layout.attributes = attributes;
+
+		if (layout.indexStride) {
+			align();
+			size_t offset = out.size();
+			auto indices = data.begin() + layout.indexOffset;
+			out.insert(out.end(), indices, indices + (size_t)layout.indexCount * layout.indexStride);
+			layout.indexOffset = offset;
+		}
+	}
+	return out;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		errf_color(ConsoleColor::Red, "Usage: MeshCooker <input .gltf or .glb> <output file> [--interleave] [--no-optimize] [--quantize]\n");
+		return 1;
+	}
+
+	bool interleaved = false;
+	bool optimize = true;
+	bool quantize = false;
+	for (int i = 3; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--interleave") interleaved = true;
+		else if (arg == "--no-optimize") optimize = false;
+		else if (arg == "--quantize") quantize = true;
+		else errf_color(ConsoleColor::Yellow, "Unknown argument %s\n", arg.c_str());
+	}
+
+	try {
+		auto start = std::chrono::high_resolution_clock::now();
+		GltfLoader loader(argv[1]);
+		std::vector<Mesh::Layout> layouts = loader.Layouts();
+		std::vector<std::byte> data(loader.DataSize());
+		ThreadPool pool;
+		loader.Decode(data.data(), &pool);
+		if (optimize) MeshOptimizer::PrintStatistics(MeshOptimizer().Optimize(layouts, data, &pool));
+		//after optimizing, overdraw sorting reads float positions
+		if (quantize) MeshQuantizer::PrintStatistics(MeshQuantizer().Quantize(layouts, data, &pool));
+		if (interleaved) data = interleave(layouts, data);
+
+		MeshBundle::Write(argv[2], layouts, data);
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("Wrote %zu meshes, %zu bytes of vertex and index data to %s in %.1fms\n", layouts.size(), data.size(), argv[2],
+			std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	catch (const std::exception& e) {
+		errf_color(ConsoleColor::Red, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
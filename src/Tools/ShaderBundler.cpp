@@ -0,0 +1,128 @@
+#include "Core/ShaderBundle.hpp"
+#include "Core/ShaderCompiler.hpp"
+
+#include <filesystem>
+
+using namespace vrg;
+
+//compiles every HLSL file in a directory into one shader bundle, shaders are named after their file without extension
+
+struct StageInfo {
+	vk::ShaderStageFlagBits stage;
+	shaderc_shader_kind kind;
+};
+
+static const std::unordered_map<std::string, StageInfo> pragmaStages = {
+	{ "vertex", { vk::ShaderStageFlagBits::eVertex, shaderc_vertex_shader } },
+	{ "fragment", { vk::ShaderStageFlagBits::eFragment, shaderc_fragment_shader } },
+	{ "compute", { vk::ShaderStageFlagBits::eCompute, shaderc_compute_shader } },
+	{ "geometry", { vk::ShaderStageFlagBits::eGeometry, shaderc_geometry_shader } },
+	{ "tesscontrol", { vk::ShaderStageFlagBits::eTessellationControl, shaderc_tess_control_shader } },
+	{ "tesseval", { vk::ShaderStageFlagBits::eTessellationEvaluation, shaderc_tess_evaluation_shader } }
+};
+
+//the stage comes from the same #pragma shader_stage(...) line the shaders already carry for glslc
+static std::optional<StageInfo> findStage(const std::filesystem::path& path) {
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t pragma = line.find("#pragma shader_stage(");
+		if (pragma == std::string::npos) continue;
+		size_t begin = pragma + strlen("#pragma shader_stage(");
+		size_t end = line.find(')', begin);
+		if (end == std::string::npos) return std::nullopt;
+		auto it = pragmaStages.find(line.substr(begin, end - begin));
+		if (it == pragmaStages.end()) return std::nullopt;
+		return it->second;
+	}
+	return std::nullopt;
+}
+
+//vertex shaders including Shaders/VertexDecode.h are bundled in every variant Geometry::DecodeDefines can ask for
+static const std::vector<std::string> decodeDefines = { "VRG_NORMAL_OCTAHEDRAL", "VRG_TANGENT_OCTAHEDRAL" };
+
+static bool includesVertexDecode(const std::filesystem::path& path) {
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.find("#include") != std::string::npos && line.find("VertexDecode.h") != std::string::npos) return true;
+	}
+	return false;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		errf_color(ConsoleColor::Red, "Usage: ShaderBundler <shader directory> <output file> [--size | --no-optimize] [--strip]\n");
+		return 1;
+	}
+
+	ShaderCompileOptions baseOptions;
+	baseOptions.optimization = shaderc_optimization_level_performance;
+	for (int i = 3; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--size") baseOptions.optimization = shaderc_optimization_level_size;
+		else if (arg == "--no-optimize") baseOptions.optimization = shaderc_optimization_level_zero;
+		else if (arg == "--strip") baseOptions.stripDebugInfo = true;
+		else errf_color(ConsoleColor::Yellow, "Unknown argument %s\n", arg.c_str());
+	}
+
+	ShaderCompiler compiler;
+	//bundles are built from scratch, a stale disk cache must not leak into a release build
+	compiler.SetCacheDirectory("");
+
+	std::vector<std::filesystem::path> sources;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[1])) {
+		if (entry.is_regular_file() && entry.path().extension() == ".hlsl") {
+			sources.push_back(entry.path());
+		}
+	}
+	//stable order so identical sources produce an identical bundle
+	std::ranges::sort(sources);
+
+	std::vector<ShaderBundle::Entry> entries;
+	bool failed = false;
+	for (const auto& source : sources) {
+		std::optional<StageInfo> stage = findStage(source);
+		if (!stage) {
+			errf_color(ConsoleColor::Yellow, "Skipping %s, it has no #pragma shader_stage\n", source.string().c_str());
+			continue;
+		}
+
+		ShaderCompileOptions options = baseOptions;
+		options.name = source.stem().string();
+		if (std::ranges::any_of(entries, [&](const auto& e) { return e.name == options.name; })) {
+			errf_color(ConsoleColor::Red, "Two shaders are named %s\n", options.name.c_str());
+			failed = true;
+			continue;
+		}
+
+		uint32_t variantCount = includesVertexDecode(source) ? 1u << decodeDefines.size() : 1u;
+		for (uint32_t variant = 0; variant < variantCount; variant++) {
+			options.defines.clear();
+			for (uint32_t i = 0; i < decodeDefines.size(); i++) {
+				if (variant & (1u << i)) options.defines.emplace_back(decodeDefines[i], "1");
+			}
+			std::string name = ShaderBundle::VariantName(options.name, options.defines);
+
+			SpirvStatistics statistics;
+			std::vector<uint32_t> spirv = compiler.CompileToSpirv(source.string(), stage->kind, options, true, nullptr, &statistics);
+			if (spirv.empty()) {
+				failed = true;
+				continue;
+			}
+			printf("%s: %llu -> %llu instructions\n", name.c_str(), (unsigned long long)statistics.instructionsBefore, (unsigned long long)statistics.instructionsAfter);
+			entries.push_back({ name, stage->stage, options.entryPoint, std::move(spirv) });
+		}
+	}
+	if (failed) return 1;
+
+	try {
+		ShaderBundle::Write(argv[2], entries);
+	}
+	catch (const std::exception& e) {
+		errf_color(ConsoleColor::Red, "%s\n", e.what());
+		return 1;
+	}
+	printf("Wrote %zu shaders to %s\n", entries.size(), argv[2]);
+	return 0;
+}